@@ -54,6 +54,7 @@ def add_model_to_fields(s):
 def process(in_lines,structname):
     get_lines = []
     set_lines = []
+    field_lines = []
 
     for line in in_lines:
         md = scalar_re.match(line)
@@ -61,6 +62,7 @@ def process(in_lines,structname):
             dtype,name = md.group(1),md.group(2)
             get_lines.append('    out["%(name)s"] = %(structname)s->%(name)s;'%dict(structname=structname,dtype=dtype,name=name))
             set_lines.append('    _csdihk(d, "%(name)s", %(structname)s->%(name)s);'%dict(structname=structname,name=name))
+            field_lines.append('    if (name == "%(name)s") return bp::object(%(structname)s->%(name)s);'%dict(structname=structname,name=name))
             continue
         md = ptr_re.match(line)
         if md:
@@ -72,27 +74,32 @@ def process(in_lines,structname):
             size1 = add_model_to_fields(size1)
             get_lines.append('    out["%(name)s"] = toNdarray2<%(dtype)s>(%(structname)s->%(name)s, %(size0)s, %(size1)s);'%dict(structname=structname,name=name,dtype=dtype,size0=size0,size1=size1))
             set_lines.append('    _cadihk(d, "%(name)s", %(structname)s->%(name)s);'%dict(structname=structname,name=name))
+            field_lines.append('    if (name == "%(name)s") return dataField2<%(dtype)s>(%(structname)s->%(name)s, %(size0)s, %(size1)s, owner);'%dict(structname=structname,name=name,dtype=dtype,size0=size0,size1=size1))
             continue
         md = arr_re.match(line)
         if md:
             dtype,name,size = md.group(1),md.group(2),md.group(3)
             get_lines.append('    out["%(name)s"] = toNdarray1<%(dtype)s>(%(structname)s->%(name)s, %(size)s);'%dict(structname=structname,name=name,dtype=dtype,size=size))
             set_lines.append('    _cadihk(d, "%(name)s", %(structname)s->%(name)s);'%dict(structname=structname,name=name))
+            field_lines.append('    if (name == "%(name)s") return dataField1<%(dtype)s>(%(structname)s->%(name)s, %(size)s, owner);'%dict(structname=structname,name=name,dtype=dtype,size=size))
             continue
         print "ignore line:",line,
-    return get_lines,set_lines
+    return get_lines,set_lines,field_lines
 
 
 
 # with open("mjcpy2_getmodel_autogen.i","w") as outfile:
-#     get_lines, set_lines = process(find_lines_between(all_lines, "_mjModel","}"),"m_model")
+#     get_lines, set_lines, field_lines = process(find_lines_between(all_lines, "_mjModel","}"),"m_model")
 #     outfile.write("\n".join(get_lines))
 # with open("mjcpy2_setmodel_autogen.i","w") as outfile:
-#     get_lines, set_lines = process(find_lines_between(all_lines, "_mjModel","}"),"m_model")
+#     get_lines, set_lines, field_lines = process(find_lines_between(all_lines, "_mjModel","}"),"m_model")
 #     outfile.write("\n".join(set_lines))
 with open("mjcpy2_getdata_autogen.i","w") as outfile:
-    get_lines, set_lines = process(find_lines_between(all_lines, "_mjData","}"),"m_data")
+    get_lines, set_lines, field_lines = process(find_lines_between(all_lines, "_mjData","}"),"m_data")
     outfile.write("\n".join(get_lines))
 with open("mjcpy2_setdata_autogen.i","w") as outfile:
-    get_lines, set_lines = process(find_lines_between(all_lines, "_mjData","}"),"m_data")
+    get_lines, set_lines, field_lines = process(find_lines_between(all_lines, "_mjData","}"),"m_data")
     outfile.write("\n".join(set_lines))
+with open("mjcpy2_datafield_autogen.i","w") as outfile:
+    get_lines, set_lines, field_lines = process(find_lines_between(all_lines, "_mjData","}"),"m_data")
+    outfile.write("\n".join(field_lines))
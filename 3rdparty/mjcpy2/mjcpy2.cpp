@@ -1,12 +1,16 @@
 #include <boost/numpy.hpp>
 #include <cmath>
+#include <cstring>
 #include "macros.h"
 #include <iostream>
+#include <vector>
 #include <boost/python/slice.hpp>
 #define BOOST_NO_CXX11_SCOPED_ENUMS
 #include <boost/filesystem.hpp>
 #undef BOOST_NO_CXX11_SCOPED_ENUMS
 #include <boost/tuple/tuple.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
 #include "mujoco_osg_viewer.hpp"
 
 namespace bp = boost::python;
@@ -54,6 +58,26 @@ bp::object main_namespace;
     }
 
 
+    // Field of a live struct: a view that keeps owner alive, or a copy if owner is NULL.
+    template<typename T>
+    bp::object dataField1(T* data, long dim0, const bp::object* owner) {
+      if (!owner) return toNdarray1<T>(data, dim0);
+      std::vector<Py_intptr_t> shape(1, dim0), strides(1, sizeof(T));
+      return bn::from_data(data, bn::dtype::get_builtin<T>(), shape, strides, *owner);
+    }
+
+    template<typename T>
+    bp::object dataField2(T* data, long dim0, long dim1, const bp::object* owner) {
+      if (!owner) return toNdarray2<T>(data, dim0, dim1);
+      std::vector<Py_intptr_t> shape(2), strides(2);
+      shape[0] = dim0;
+      shape[1] = dim1;
+      strides[0] = dim1*sizeof(T);
+      strides[1] = sizeof(T);
+      return bn::from_data(data, bn::dtype::get_builtin<T>(), shape, strides, *owner);
+    }
+
+
     bool endswith(const std::string& fullString, const std::string& ending){
     	return (fullString.length() >= ending.length()) &&
     		(0 == fullString.compare(fullString.length() - ending.length(), ending.length(), ending));
@@ -68,21 +92,37 @@ bp::object main_namespace;
     public:
 
         PyMJCWorld2(const std::string& loadfile);
-        bp::object Step(const bn::ndarray& x, const bn::ndarray& u);
+        bp::object Step(const bn::ndarray& x, const bn::ndarray& u, bool substep_sites);
+        void StepInto(const bn::ndarray& x, const bn::ndarray& u, const bn::ndarray& x_out, const bn::ndarray& site_out,
+                      bool in_place);
+        bp::object Rollout(const bn::ndarray& x0, const bn::ndarray& U, int substeps);
+        bp::object RolloutLinGauss(const bn::ndarray& x0, const bn::ndarray& K, const bn::ndarray& k,
+                                   const bn::ndarray& chol_pol_covar, const bn::ndarray& noise, int substeps, double dt);
+        bp::object Linearize(const bn::ndarray& X, const bn::ndarray& U, double eps, int substeps, int nthreads);
+        bp::object RolloutBatch(const bn::ndarray& X0, const bn::ndarray& U, int substeps, int nthreads);
+        bp::object RolloutLinGaussBatch(const bn::ndarray& X0, const bn::ndarray& K, const bn::ndarray& k,
+                                        const bn::ndarray& chol_pol_covar, const bn::ndarray& noise,
+                                        int substeps, double dt, int nthreads);
         void Plot(const bn::ndarray& x);
         void InitCam(float cx,float cy,float cz,float px,float py,float pz);
         void InitViewer(int width, int height, float cx,float cy,float cz,float px,float py,float pz);
         void Idle(const bn::ndarray& x);
         bn::ndarray GetCOMMulti(const bn::ndarray& x);
         bn::ndarray GetJacSite(int site);
+        bn::ndarray GetJacSites(const bp::object& sites);
+        bn::ndarray GetJacSitesTraj(const bn::ndarray& X, const bp::object& sites);
+        bp::dict KinematicsBatch(const bn::ndarray& X, bool com, bool site_xpos, bool xpos,
+                                 const bp::object& jac_sites, int nthreads);
         void Kinematics();
         bp::dict GetModel();
         void SetModel(bp::dict d);
         bp::dict GetData();
         void SetData(bp::dict d);
+        bp::dict GetFields(bp::list names);
+        bp::object DataField(const std::string& name, const bp::object* owner);
         bp::dict GetImage();
         bp::dict GetImageScaled(int width, int height);
-        void SetNumSteps(int n) {m_numSteps=n;}
+        void SetNumSteps(int n) {FAIL_IF_FALSE(n >= 1); m_numSteps=n;}
         void SetCamera(float x, float y, float z, float px, float py, float pz);
 
         ~PyMJCWorld2();
@@ -91,12 +131,21 @@ bp::object main_namespace;
         void _PlotInit();
         void _PlotInit(float x, float y, float z, float px, float py, float pz);
         void _PlotInit(int width, int height, float x, float y, float z, float px, float py, float pz);
+        bp::dict _RenderImage(int width, int height);
+        std::vector<mjData*> _GetWorkers(int nthreads);
 
         mjModel* m_model;
         mjData* m_data;
         MujocoOSGViewer* m_viewer;
         int m_numSteps;
         int m_featmask;
+        // One mjData per batch worker thread, all sharing m_model.
+        std::vector<mjData*> m_workerData;
+        // Scratch space of the batch workers, kept across calls.
+        std::vector<mjtNum> m_workerScratch;
+        // Guards m_data, m_model and the viewer, which other threads may be
+        // using without the GIL.
+        boost::mutex m_mutex;
 
     };
 
@@ -129,12 +178,15 @@ PyMJCWorld2::~PyMJCWorld2() {
 	if (m_viewer) {
 		delete m_viewer;
 	}
+	for (size_t i=0; i < m_workerData.size(); ++i) {
+		mj_deleteData(m_workerData[i]);
+	}
 	mj_deleteData(m_data);
 	mj_deleteModel(m_model);
 }
 
 
-int StateSize(mjModel* m) {
+int StateSize(const mjModel* m) {
     return m->nq + m->nv;
 }
 void GetState(mjtNum* ptr, const mjModel* m, const mjData* d) {
@@ -147,33 +199,537 @@ void SetState(const mjtNum* ptr, const mjModel* m, mjData* d) {
     ptr += m->nq;
     mju_copy(d->qvel, ptr, m->nv);
 }
+// Whether d already holds the state ptr bit for bit (so SetState would change nothing).
+bool HasState(const mjtNum* ptr, const mjModel* m, const mjData* d) {
+    return memcmp(d->qpos, ptr, m->nq*sizeof(mjtNum)) == 0 &&
+           memcmp(d->qvel, ptr + m->nq, m->nv*sizeof(mjtNum)) == 0;
+}
 inline void SetCtrl(const mjtNum* ptr, const mjModel* m, mjData* d) {
     mju_copy(d->ctrl, ptr, m->nu);
 }
 
 #define MJTNUM_DTYPE bn::dtype::get_builtin<mjtNum>()
 
-bp::object PyMJCWorld2::Step(const bn::ndarray& x, const bn::ndarray& u) {
-    FAIL_IF_FALSE(x.get_dtype() == MJTNUM_DTYPE && x.get_nd() == 1 && x.get_flags() & bn::ndarray::C_CONTIGUOUS && x.shape(0) == m_model->nq+m_model->nv);
-    FAIL_IF_FALSE(u.get_dtype() == MJTNUM_DTYPE && u.get_nd() == 1 && u.get_flags() & bn::ndarray::C_CONTIGUOUS && u.shape(0) == m_model->nu);
+bool IsContiguousMjtNum(const bn::ndarray& a, int nd) {
+    return a.get_dtype() == MJTNUM_DTYPE && a.get_nd() == nd && (a.get_flags() & bn::ndarray::C_CONTIGUOUS);
+}
+
+// Releases the GIL for the lifetime of the object. Only native code may run
+// in its scope, and only on arrays that the caller keeps referenced (the
+// arguments of the call, and outputs allocated before the release).
+// Methods that touch m_data take m_mutex inside this scope, never the other
+// way around, so a thread waiting for the mutex never holds up the GIL owner.
+class ScopedGILRelease {
+public:
+    ScopedGILRelease() { m_state = PyEval_SaveThread(); }
+    ~ScopedGILRelease() { PyEval_RestoreThread(m_state); }
+private:
+    PyThreadState* m_state;
+};
+
+// Locks a mutex for the lifetime of the object, waiting for it with the GIL
+// released, for methods that convert between m_data and Python objects under
+// the lock. The GIL is taken back once the mutex is held; that cannot
+// deadlock, since no thread waits for the mutex while holding the GIL.
+class ScopedLockWithoutGIL {
+public:
+    explicit ScopedLockWithoutGIL(boost::mutex& mutex) : m_lock(mutex, boost::defer_lock) {
+        ScopedGILRelease nogil;
+        m_lock.lock();
+    }
+private:
+    boost::mutex::scoped_lock m_lock;
+};
+
+// Step the dynamics substeps times with the control held constant, recording
+// the site positions of every substep into substep_site_xpos[substeps,nsite,3]
+// unless it is NULL.
+void StepSubsteps(const mjModel* m, mjData* d, const mjtNum* u, int substeps, mjtNum* substep_site_xpos=NULL) {
+    for (int i=0; i < substeps; ++i) {
+        mj_step1(m,d);
+        SetCtrl(u, m, d);
+        mj_step2(m,d);
+        if (substep_site_xpos) {
+            mju_copy(substep_site_xpos + i*3*m->nsite, d->site_xpos, 3*m->nsite);
+        }
+    }
+}
+
+// Roll out the controls U[T,nu] from x0, filling X[T,nq+nv] and site_xpos[T,nsite,3].
+// Row t+1 holds the state after applying U[t] for substeps steps (the last
+// control is unused), and the site positions left by the last substep, as
+// returned by Step.
+void RolloutOpenLoop(const mjModel* m, mjData* d, const mjtNum* x0, const mjtNum* U, int T, int substeps,
+                     mjtNum* X, mjtNum* site_xpos) {
+    int dX = StateSize(m), nsite3 = 3*m->nsite;
+    SetState(x0, m, d);
+    mj_kinematics(m, d);
+    mju_copy(X, x0, dX);
+    mju_copy(site_xpos, d->site_xpos, nsite3);
+    for (int t=0; t+1 < T; ++t) {
+        StepSubsteps(m, d, U + t*m->nu, substeps);
+        GetState(X + (t+1)*dX, m, d);
+        mju_copy(site_xpos + (t+1)*nsite3, d->site_xpos, nsite3);
+    }
+}
 
-    SetState(reinterpret_cast<const mjtNum*>(x.get_data()), m_model, m_data);
+// Roll out the linear-Gaussian policy u_t = K_t x_t + k_t + chol_t^T noise_t from x0.
+// The policy state x_t is [qpos, qvel] (dX = nq+nv) or, for policies that also
+// see the end effector, [qpos, qvel, site_xpos, site velocities] (dX = nq+nv+6*nsite),
+// with the velocities taken as finite differences over dt as in the agent.
+// Fills X[T,dX], U[T,nu], site_xpos[T,nsite,3] and jac_site[T,3*nsite,nv];
+// like RolloutOpenLoop, the last control is computed but not applied.
+void RolloutLinearGaussian(const mjModel* m, mjData* d, const mjtNum* x0, const mjtNum* K, const mjtNum* k,
+                           const mjtNum* chol, const mjtNum* noise, int T, int dX, int substeps, mjtNum dt,
+                           mjtNum* X, mjtNum* U, mjtNum* site_xpos, mjtNum* jac_site) {
+    int dS = StateSize(m), nu = m->nu, nv = m->nv, nsite3 = 3*m->nsite;
+    bool with_sites = dX > dS;
+    std::vector<mjtNum> scaled_noise(nu+1);
+    SetState(x0, m, d);
+    mj_kinematics(m, d);
+    mj_comPos(m, d);
+    for (int t=0; t < T; ++t) {
+        mjtNum* x = X + t*dX;
+        mjtNum* sites = site_xpos + t*nsite3;
+        GetState(x, m, d);
+        mju_copy(sites, d->site_xpos, nsite3);
+        for (int i=0; i < m->nsite; ++i) {
+            mj_jacSite(m, d, jac_site + (t*nsite3 + 3*i)*nv, 0, i);
+        }
+        if (with_sites) {
+            mju_copy(x + dS, sites, nsite3);
+            if (t == 0) {
+                mju_zero(x + dS + nsite3, nsite3);
+            }
+            else {
+                mju_sub(x + dS + nsite3, sites, sites - nsite3, nsite3);
+                mju_scl(x + dS + nsite3, x + dS + nsite3, 1.0/dt, nsite3);
+            }
+        }
+
+        mjtNum* u = U + t*nu;
+        mju_mulMatVec(u, K + t*nu*dX, x, nu, dX);
+        mju_addTo(u, k + t*nu, nu);
+        mju_mulMatTVec(&scaled_noise[0], chol + t*nu*nu, noise + t*nu, nu, nu);
+        mju_addTo(u, &scaled_noise[0], nu);
+        if (t+1 < T) {
+            StepSubsteps(m, d, u, substeps);
+        }
+    }
+}
 
-    mj_step1(m_model,m_data);
-    SetCtrl(reinterpret_cast<const mjtNum*>(u.get_data()), m_model, m_data);
-    mj_step2(m_model,m_data);
+// Step from x for m_numSteps substeps with the control u held constant, and
+// return the final state with the site positions of the last substep, or of
+// every substep ([m_numSteps,nsite,3]) with substep_sites.
+bp::object PyMJCWorld2::Step(const bn::ndarray& x, const bn::ndarray& u, bool substep_sites) {
+    FAIL_IF_FALSE(x.get_dtype() == MJTNUM_DTYPE && x.get_nd() == 1 && x.get_flags() & bn::ndarray::C_CONTIGUOUS && x.shape(0) == m_model->nq+m_model->nv);
+    FAIL_IF_FALSE(u.get_dtype() == MJTNUM_DTYPE && u.get_nd() == 1 && u.get_flags() & bn::ndarray::C_CONTIGUOUS && u.shape(0) == m_model->nu);
 
     long xdims[1] = {StateSize(m_model)};
-    long site_dims[2] = {m_model->nsite, 3};
+    long site_dims[3] = {m_numSteps, m_model->nsite, 3};
     bn::ndarray xout = bn::empty(1, xdims, bn::dtype::get_builtin<mjtNum>());
-    bn::ndarray site_out = bn::empty(2, site_dims, bn::dtype::get_builtin<mjtNum>());
+    bn::ndarray site_out = substep_sites ? bn::empty(3, site_dims, bn::dtype::get_builtin<mjtNum>())
+                                         : bn::empty(2, site_dims + 1, bn::dtype::get_builtin<mjtNum>());
 
-    GetState((mjtNum*)xout.get_data(), m_model, m_data);
-    mju_copy((mjtNum*)site_out.get_data(), m_data->site_xpos, 3*m_model->nsite);
+    {
+        ScopedGILRelease nogil;
+        boost::mutex::scoped_lock lock(m_mutex);
+        SetState(reinterpret_cast<const mjtNum*>(x.get_data()), m_model, m_data);
+
+        StepSubsteps(m_model, m_data, reinterpret_cast<const mjtNum*>(u.get_data()), m_numSteps,
+                     substep_sites ? (mjtNum*)site_out.get_data() : NULL);
+
+        GetState((mjtNum*)xout.get_data(), m_model, m_data);
+        if (!substep_sites) {
+            mju_copy((mjtNum*)site_out.get_data(), m_data->site_xpos, 3*m_model->nsite);
+        }
+    }
 
 	return bp::make_tuple(xout, site_out);
 }
 
+// Step like Step, writing the state and site positions into the preallocated
+// x_out and site_out (x_out may be x). With in_place, x is only copied into
+// the world when it differs from the world's current state, so passing back
+// the x_out of the previous step_into continues from the internal state.
+void PyMJCWorld2::StepInto(const bn::ndarray& x, const bn::ndarray& u, const bn::ndarray& x_out, const bn::ndarray& site_out,
+                           bool in_place) {
+    int dS = StateSize(m_model);
+    FAIL_IF_FALSE(IsContiguousMjtNum(x, 1) && x.shape(0) == dS);
+    FAIL_IF_FALSE(IsContiguousMjtNum(u, 1) && u.shape(0) == m_model->nu);
+    FAIL_IF_FALSE(IsContiguousMjtNum(x_out, 1) && x_out.shape(0) == dS && (x_out.get_flags() & bn::ndarray::WRITEABLE));
+    FAIL_IF_FALSE(IsContiguousMjtNum(site_out, 2) && site_out.shape(0) == m_model->nsite && site_out.shape(1) == 3 &&
+                  (site_out.get_flags() & bn::ndarray::WRITEABLE));
+
+    ScopedGILRelease nogil;
+    boost::mutex::scoped_lock lock(m_mutex);
+    if (!in_place || !HasState(reinterpret_cast<const mjtNum*>(x.get_data()), m_model, m_data)) {
+        SetState(reinterpret_cast<const mjtNum*>(x.get_data()), m_model, m_data);
+    }
+
+    StepSubsteps(m_model, m_data, reinterpret_cast<const mjtNum*>(u.get_data()), m_numSteps);
+
+    GetState((mjtNum*)x_out.get_data(), m_model, m_data);
+    mju_copy((mjtNum*)site_out.get_data(), m_data->site_xpos, 3*m_model->nsite);
+}
+
+bp::object PyMJCWorld2::Rollout(const bn::ndarray& x0, const bn::ndarray& U, int substeps) {
+    FAIL_IF_FALSE(IsContiguousMjtNum(x0, 1) && x0.shape(0) == StateSize(m_model));
+    FAIL_IF_FALSE(IsContiguousMjtNum(U, 2) && U.shape(1) == m_model->nu);
+    FAIL_IF_FALSE(substeps >= 1);
+    long T = U.shape(0);
+
+    long xdims[2] = {T, StateSize(m_model)};
+    long site_dims[3] = {T, m_model->nsite, 3};
+    bn::ndarray X = bn::empty(2, xdims, MJTNUM_DTYPE);
+    bn::ndarray site_xpos = bn::empty(3, site_dims, MJTNUM_DTYPE);
+    if (T > 0) {
+        ScopedGILRelease nogil;
+        boost::mutex::scoped_lock lock(m_mutex);
+        RolloutOpenLoop(m_model, m_data, reinterpret_cast<const mjtNum*>(x0.get_data()),
+                        reinterpret_cast<const mjtNum*>(U.get_data()), T, substeps,
+                        (mjtNum*)X.get_data(), (mjtNum*)site_xpos.get_data());
+    }
+    return bp::make_tuple(X, site_xpos);
+}
+
+bp::object PyMJCWorld2::RolloutLinGauss(const bn::ndarray& x0, const bn::ndarray& K, const bn::ndarray& k,
+                                        const bn::ndarray& chol_pol_covar, const bn::ndarray& noise, int substeps, double dt) {
+    int dS = StateSize(m_model), nu = m_model->nu, nsite = m_model->nsite;
+    FAIL_IF_FALSE(IsContiguousMjtNum(x0, 1) && x0.shape(0) == dS);
+    FAIL_IF_FALSE(IsContiguousMjtNum(K, 3) && K.shape(1) == nu);
+    long T = K.shape(0), dX = K.shape(2);
+    FAIL_IF_FALSE(dX == dS || dX == dS + 6*nsite);
+    FAIL_IF_FALSE(IsContiguousMjtNum(k, 2) && k.shape(0) == T && k.shape(1) == nu);
+    FAIL_IF_FALSE(IsContiguousMjtNum(chol_pol_covar, 3) && chol_pol_covar.shape(0) == T &&
+                  chol_pol_covar.shape(1) == nu && chol_pol_covar.shape(2) == nu);
+    FAIL_IF_FALSE(IsContiguousMjtNum(noise, 2) && noise.shape(0) == T && noise.shape(1) == nu);
+    FAIL_IF_FALSE(substeps >= 1 && dt > 0);
+
+    long xdims[2] = {T, dX};
+    long udims[2] = {T, nu};
+    long site_dims[3] = {T, nsite, 3};
+    long jac_dims[3] = {T, 3*nsite, m_model->nv};
+    bn::ndarray X = bn::empty(2, xdims, MJTNUM_DTYPE);
+    bn::ndarray U = bn::empty(2, udims, MJTNUM_DTYPE);
+    bn::ndarray site_xpos = bn::empty(3, site_dims, MJTNUM_DTYPE);
+    bn::ndarray jac_site = bn::empty(3, jac_dims, MJTNUM_DTYPE);
+    if (T > 0) {
+        ScopedGILRelease nogil;
+        boost::mutex::scoped_lock lock(m_mutex);
+        RolloutLinearGaussian(m_model, m_data, reinterpret_cast<const mjtNum*>(x0.get_data()),
+                              reinterpret_cast<const mjtNum*>(K.get_data()), reinterpret_cast<const mjtNum*>(k.get_data()),
+                              reinterpret_cast<const mjtNum*>(chol_pol_covar.get_data()),
+                              reinterpret_cast<const mjtNum*>(noise.get_data()), T, dX, substeps, dt,
+                              (mjtNum*)X.get_data(), (mjtNum*)U.get_data(),
+                              (mjtNum*)site_xpos.get_data(), (mjtNum*)jac_site.get_data());
+    }
+    return bp::make_tuple(X, U, site_xpos, jac_site);
+}
+
+
+// Per-rollout stride of a batch argument that is either shared by all
+// rollouts (nd == shared_nd) or given per rollout (nd == shared_nd+1).
+long BatchStride(const bn::ndarray& a, int shared_nd) {
+    if (a.get_nd() == shared_nd) return 0;
+    long size = 1;
+    for (int i=1; i < a.get_nd(); ++i) size *= a.shape(i);
+    return size;
+}
+
+// Open-loop rollout n of a batch.
+struct OpenLoopJob {
+    const mjModel* m;
+    const mjtNum* X0;
+    const mjtNum* U;
+    int T, substeps;
+    mjtNum* X;
+    mjtNum* site_xpos;
+    void operator()(mjData* d, int, int n) const {
+        int dS = StateSize(m), nsite3 = 3*m->nsite;
+        RolloutOpenLoop(m, d, X0 + n*dS, U + n*T*m->nu, T, substeps, X + n*T*dS, site_xpos + n*T*nsite3);
+    }
+};
+
+// Linear-Gaussian rollout n of a batch.
+struct LinGaussJob {
+    const mjModel* m;
+    const mjtNum* X0;
+    const mjtNum *K, *k, *chol;
+    long K_stride, k_stride, chol_stride;
+    const mjtNum* noise;
+    int T, dX, substeps;
+    mjtNum dt;
+    mjtNum *X, *U, *site_xpos, *jac_site;
+    void operator()(mjData* d, int, int n) const {
+        int nu = m->nu, nsite3 = 3*m->nsite;
+        RolloutLinearGaussian(m, d, X0 + n*StateSize(m), K + n*K_stride, k + n*k_stride, chol + n*chol_stride,
+                              noise + n*T*nu, T, dX, substeps, dt, X + n*T*dX, U + n*T*nu,
+                              site_xpos + n*T*nsite3, jac_site + n*T*nsite3*m->nv);
+    }
+};
+
+// Run the jobs w, w+stride, ... on worker w with data d, each starting from a
+// copy of src (or, without copy_each, all from one copy, for jobs that reset
+// what they change). Jobs are called as job(d, w, n), so that they can use
+// per-worker scratch space.
+template <typename Job>
+void RunBatchWorker(const mjModel* m, const mjData* src, mjData* d, int w, int stride, int N, const Job* job,
+                    bool copy_each) {
+    if (!copy_each) mj_copyData(d, m, src);
+    for (int n=w; n < N; n += stride) {
+        if (copy_each) mj_copyData(d, m, src);
+        (*job)(d, w, n);
+    }
+}
+
+// Run jobs 0..N-1 on one thread per worker mjData. src (the world's own
+// mjData) is only read, so every rollout starts from the same data and the
+// world is left as it was.
+template <typename Job>
+void RunBatch(const mjModel* m, const mjData* src, const std::vector<mjData*>& workers, int N, const Job& job,
+              bool copy_each=true) {
+    int nworkers = std::min<int>(workers.size(), N);
+    if (nworkers <= 1) {
+        RunBatchWorker(m, src, workers[0], 0, 1, N, &job, copy_each);
+        return;
+    }
+    boost::thread_group threads;
+    for (int w=0; w < nworkers; ++w) {
+        threads.create_thread(boost::bind(&RunBatchWorker<Job>, m, src, workers[w], w, nworkers, N, &job, copy_each));
+    }
+    threads.join_all();
+}
+
+// Step of a linearization: the state after substeps steps from x with u,
+// warm-starting the constraint solver from the accelerations qacc. Only
+// resets what stepping changes, so d must start as a copy of src. The warm
+// start is set on every call, so the result does not depend on what the
+// worker stepped before: MuJoCo 1.31 warm-starts from d->qacc as left by the
+// previous step, later versions from d->qacc_warmstart.
+void StepFrom(const mjModel* m, mjData* d, const mjData* src, const mjtNum* x, const mjtNum* u,
+              const mjtNum* qacc, int substeps, mjtNum* x_next) {
+    d->time = src->time;
+    mju_copy(d->act, src->act, m->na);
+    SetState(x, m, d);
+    mju_copy(d->qacc, qacc, m->nv);
+#if mjVERSION_HEADER >= 150
+    mju_copy(d->qacc_warmstart, qacc, m->nv);
+#endif
+    StepSubsteps(m, d, u, substeps);
+    GetState(x_next, m, d);
+}
+
+// Nominal step t of a linearization: the warm start (the accelerations of the
+// nominal state) shared by all its perturbations, and the next state.
+struct NominalStepJob {
+    const mjModel* m;
+    const mjData* src;
+    const mjtNum *X, *U;
+    int substeps;
+    mjtNum *warmstart, *X_next;
+    void operator()(mjData* d, int, int t) const {
+        int dS = StateSize(m), nu = m->nu, nv = m->nv;
+        d->time = src->time;
+        mju_copy(d->act, src->act, m->na);
+        SetState(X + t*dS, m, d);
+        SetCtrl(U + t*nu, m, d);
+        // The forward pass is warm-started from the source data, like a
+        // rollout from it would be.
+        mju_copy(d->qacc, src->qacc, nv);
+#if mjVERSION_HEADER >= 150
+        mju_copy(d->qacc_warmstart, src->qacc_warmstart, nv);
+#endif
+        mj_forward(m, d);
+        mju_copy(warmstart + t*nv, d->qacc, nv);
+        StepFrom(m, d, src, X + t*dS, U + t*nu, warmstart + t*nv, substeps, X_next + t*dS);
+    }
+};
+
+// Column j of Fm[t] by centered differences, for job n = t*(dS+nu) + j.
+// Worker w works in scratch + w*ScratchSize(m).
+struct PerturbedStepJob {
+    const mjModel* m;
+    const mjData* src;
+    const mjtNum *X, *U, *warmstart;
+    int substeps;
+    mjtNum eps;
+    mjtNum* Fm;
+    mjtNum* scratch;
+    static int ScratchSize(const mjModel* m) { return 3*StateSize(m) + m->nu; }
+    void operator()(mjData* d, int w, int n) const {
+        int dS = StateSize(m), nu = m->nu, ncol = dS + nu;
+        int t = n / ncol, j = n % ncol;
+        mjtNum* z = scratch + w*ScratchSize(m);
+        mjtNum* x_plus = z + ncol;
+        mjtNum* x_minus = x_plus + dS;
+        mju_copy(z, X + t*dS, dS);
+        mju_copy(z + dS, U + t*nu, nu);
+        mjtNum z_j = z[j];
+        z[j] = z_j + eps;
+        StepFrom(m, d, src, z, z + dS, warmstart + t*m->nv, substeps, x_plus);
+        z[j] = z_j - eps;
+        StepFrom(m, d, src, z, z + dS, warmstart + t*m->nv, substeps, x_minus);
+        mjtNum* F = Fm + t*dS*ncol;
+        for (int i=0; i < dS; ++i) {
+            F[i*ncol + j] = (x_plus[i] - x_minus[i]) / (2*eps);
+        }
+    }
+};
+
+// Worker data for nthreads threads (one per core if nthreads <= 0), created on first use.
+std::vector<mjData*> PyMJCWorld2::_GetWorkers(int nthreads) {
+    if (nthreads <= 0) nthreads = std::max(1u, boost::thread::hardware_concurrency());
+    while ((int)m_workerData.size() < nthreads) {
+        mjData* d = mj_makeData(m_model);
+        FAIL_IF_FALSE(!!d);
+        m_workerData.push_back(d);
+    }
+    return std::vector<mjData*>(m_workerData.begin(), m_workerData.begin() + nthreads);
+}
+
+bp::object PyMJCWorld2::RolloutBatch(const bn::ndarray& X0, const bn::ndarray& U, int substeps, int nthreads) {
+    int dS = StateSize(m_model);
+    FAIL_IF_FALSE(IsContiguousMjtNum(X0, 2) && X0.shape(1) == dS);
+    FAIL_IF_FALSE(IsContiguousMjtNum(U, 3) && U.shape(0) == X0.shape(0) && U.shape(2) == m_model->nu);
+    FAIL_IF_FALSE(substeps >= 1);
+    long N = X0.shape(0), T = U.shape(1);
+
+    long xdims[3] = {N, T, dS};
+    long site_dims[4] = {N, T, m_model->nsite, 3};
+    bn::ndarray X = bn::empty(3, xdims, MJTNUM_DTYPE);
+    bn::ndarray site_xpos = bn::empty(4, site_dims, MJTNUM_DTYPE);
+    if (N > 0 && T > 0) {
+        std::vector<mjData*> workers = _GetWorkers(nthreads);
+        OpenLoopJob job;
+        job.m = m_model;
+        job.X0 = reinterpret_cast<const mjtNum*>(X0.get_data());
+        job.U = reinterpret_cast<const mjtNum*>(U.get_data());
+        job.T = T;
+        job.substeps = substeps;
+        job.X = (mjtNum*)X.get_data();
+        job.site_xpos = (mjtNum*)site_xpos.get_data();
+        ScopedGILRelease nogil;
+        boost::mutex::scoped_lock lock(m_mutex);
+        RunBatch(m_model, m_data, workers, N, job);
+    }
+    return bp::make_tuple(X, site_xpos);
+}
+
+bp::object PyMJCWorld2::RolloutLinGaussBatch(const bn::ndarray& X0, const bn::ndarray& K, const bn::ndarray& k,
+                                             const bn::ndarray& chol_pol_covar, const bn::ndarray& noise,
+                                             int substeps, double dt, int nthreads) {
+    int dS = StateSize(m_model), nu = m_model->nu, nsite = m_model->nsite;
+    FAIL_IF_FALSE(IsContiguousMjtNum(X0, 2) && X0.shape(1) == dS);
+    long N = X0.shape(0);
+    FAIL_IF_FALSE(IsContiguousMjtNum(noise, 3) && noise.shape(0) == N && noise.shape(2) == nu);
+    long T = noise.shape(1);
+    // K, k and chol_pol_covar are shared by all rollouts or given per rollout.
+    int Kn = K.get_nd() - 3;
+    FAIL_IF_FALSE((IsContiguousMjtNum(K, 3) || (IsContiguousMjtNum(K, 4) && K.shape(0) == N)) &&
+                  K.shape(Kn) == T && K.shape(Kn+1) == nu);
+    long dX = K.shape(Kn+2);
+    FAIL_IF_FALSE(dX == dS || dX == dS + 6*nsite);
+    int kn = k.get_nd() - 2;
+    FAIL_IF_FALSE((IsContiguousMjtNum(k, 2) || (IsContiguousMjtNum(k, 3) && k.shape(0) == N)) &&
+                  k.shape(kn) == T && k.shape(kn+1) == nu);
+    int cn = chol_pol_covar.get_nd() - 3;
+    FAIL_IF_FALSE((IsContiguousMjtNum(chol_pol_covar, 3) || (IsContiguousMjtNum(chol_pol_covar, 4) && chol_pol_covar.shape(0) == N)) &&
+                  chol_pol_covar.shape(cn) == T && chol_pol_covar.shape(cn+1) == nu && chol_pol_covar.shape(cn+2) == nu);
+    FAIL_IF_FALSE(substeps >= 1 && dt > 0);
+
+    long xdims[3] = {N, T, dX};
+    long udims[3] = {N, T, nu};
+    long site_dims[4] = {N, T, nsite, 3};
+    long jac_dims[4] = {N, T, 3*nsite, m_model->nv};
+    bn::ndarray X = bn::empty(3, xdims, MJTNUM_DTYPE);
+    bn::ndarray U = bn::empty(3, udims, MJTNUM_DTYPE);
+    bn::ndarray site_xpos = bn::empty(4, site_dims, MJTNUM_DTYPE);
+    bn::ndarray jac_site = bn::empty(4, jac_dims, MJTNUM_DTYPE);
+    if (N > 0 && T > 0) {
+        std::vector<mjData*> workers = _GetWorkers(nthreads);
+        LinGaussJob job;
+        job.m = m_model;
+        job.X0 = reinterpret_cast<const mjtNum*>(X0.get_data());
+        job.K = reinterpret_cast<const mjtNum*>(K.get_data());
+        job.k = reinterpret_cast<const mjtNum*>(k.get_data());
+        job.chol = reinterpret_cast<const mjtNum*>(chol_pol_covar.get_data());
+        job.K_stride = BatchStride(K, 3);
+        job.k_stride = BatchStride(k, 2);
+        job.chol_stride = BatchStride(chol_pol_covar, 3);
+        job.noise = reinterpret_cast<const mjtNum*>(noise.get_data());
+        job.T = T;
+        job.dX = dX;
+        job.substeps = substeps;
+        job.dt = dt;
+        job.X = (mjtNum*)X.get_data();
+        job.U = (mjtNum*)U.get_data();
+        job.site_xpos = (mjtNum*)site_xpos.get_data();
+        job.jac_site = (mjtNum*)jac_site.get_data();
+        ScopedGILRelease nogil;
+        boost::mutex::scoped_lock lock(m_mutex);
+        RunBatch(m_model, m_data, workers, N, job);
+    }
+    return bp::make_tuple(X, U, site_xpos, jac_site);
+}
+// Linearize the dynamics x_{t+1} = Fm[t] [x_t; u_t] + fv[t] around the trajectory
+// X[T,nq+nv], U[T,nu] by centered finite differences of substeps steps,
+// returning Fm[T,dX,dX+nu] and fv[T,dX]. All perturbations of a time step
+// are warm-started from its nominal state; time steps and columns run in
+// parallel on worker copies of the world's data, which is left unchanged.
+bp::object PyMJCWorld2::Linearize(const bn::ndarray& X, const bn::ndarray& U, double eps, int substeps, int nthreads) {
+    int dS = StateSize(m_model), nu = m_model->nu, ncol = dS + nu;
+    FAIL_IF_FALSE(IsContiguousMjtNum(X, 2) && X.shape(1) == dS);
+    FAIL_IF_FALSE(IsContiguousMjtNum(U, 2) && U.shape(0) == X.shape(0) && U.shape(1) == nu);
+    FAIL_IF_FALSE(eps > 0 && substeps >= 1);
+    long T = X.shape(0);
+
+    long Fm_dims[3] = {T, dS, ncol};
+    long fv_dims[2] = {T, dS};
+    bn::ndarray Fm = bn::empty(3, Fm_dims, MJTNUM_DTYPE);
+    bn::ndarray fv = bn::empty(2, fv_dims, MJTNUM_DTYPE);
+    if (T > 0) {
+        std::vector<mjData*> workers = _GetWorkers(nthreads);
+        ScopedGILRelease nogil;
+        boost::mutex::scoped_lock lock(m_mutex);
+        std::vector<mjtNum> warmstart(T*m_model->nv + 1), X_next(T*dS);
+
+        NominalStepJob nominal;
+        nominal.m = m_model;
+        nominal.src = m_data;
+        nominal.X = reinterpret_cast<const mjtNum*>(X.get_data());
+        nominal.U = reinterpret_cast<const mjtNum*>(U.get_data());
+        nominal.substeps = substeps;
+        nominal.warmstart = &warmstart[0];
+        nominal.X_next = &X_next[0];
+        RunBatch(m_model, m_data, workers, T, nominal, false);
+
+        PerturbedStepJob perturbed;
+        perturbed.m = m_model;
+        perturbed.src = m_data;
+        perturbed.X = nominal.X;
+        perturbed.U = nominal.U;
+        perturbed.warmstart = &warmstart[0];
+        perturbed.substeps = substeps;
+        perturbed.eps = eps;
+        perturbed.Fm = (mjtNum*)Fm.get_data();
+        int scratch_size = workers.size()*PerturbedStepJob::ScratchSize(m_model);
+        if ((int)m_workerScratch.size() < scratch_size) m_workerScratch.resize(scratch_size);
+        perturbed.scratch = &m_workerScratch[0];
+        RunBatch(m_model, m_data, workers, T*ncol, perturbed, false);
+
+        // fv[t] = x_{t+1} - Fm[t] [x_t; u_t].
+        std::vector<mjtNum> z(ncol);
+        for (int t=0; t < T; ++t) {
+            mjtNum* f = (mjtNum*)fv.get_data() + t*dS;
+            mju_copy(&z[0], nominal.X + t*dS, dS);
+            mju_copy(&z[dS], nominal.U + t*nu, nu);
+            mju_mulMatVec(f, perturbed.Fm + t*dS*ncol, &z[0], dS, ncol);
+            mju_sub(f, &X_next[t*dS], f, dS);
+        }
+    }
+    return bp::make_tuple(Fm, fv);
+}
 
 void GetCOM(const mjModel* m, const mjData* d, mjtNum* com) {
     // see mj_com in engine_core.c
@@ -191,18 +747,59 @@ void GetCOM(const mjModel* m, const mjData* d, mjtNum* com) {
     com[2] /= tot;
 }
 
+// Convert a python sequence of site ids, checking that each one exists.
+std::vector<int> ToSiteList(const bp::object& sites, const mjModel* m) {
+    int nsite = bp::len(sites);
+    std::vector<int> out(nsite);
+    for (int i=0; i < nsite; ++i) {
+        out[i] = bp::extract<int>(sites[i]);
+        FAIL_IF_FALSE(out[i] >= 0 && out[i] < m->nsite);
+    }
+    return out;
+}
+
+// Stack the translational Jacobians of sites into jac[3*len(sites),nv].
+// Needs the kinematics and comPos stages of d to be current.
+void JacSites(const mjModel* m, const mjData* d, const std::vector<int>& sites, mjtNum* jac) {
+    for (size_t i=0; i < sites.size(); ++i) {
+        mj_jacSite(m, d, jac + 3*i*m->nv, 0, sites[i]);
+    }
+}
+
+// Kinematic quantities of state n of a batch X[N,nq+nv]: com[N,3],
+// site_xpos[N,nsite,3], xpos[N,nbody,3] and the Jacobians of sites,
+// jac[N,3*len(sites),nv]. Outputs that are NULL are skipped.
+struct KinematicsJob {
+    const mjModel* m;
+    const mjtNum* X;
+    const std::vector<int>* sites;
+    mjtNum *com, *site_xpos, *xpos, *jac;
+    void operator()(mjData* d, int, int n) const {
+        SetState(X + n*StateSize(m), m, d);
+        mj_kinematics(m, d);
+        if (com) GetCOM(m, d, com + 3*n);
+        if (site_xpos) mju_copy(site_xpos + n*3*m->nsite, d->site_xpos, 3*m->nsite);
+        if (xpos) mju_copy(xpos + n*3*m->nbody, d->xpos, 3*m->nbody);
+        if (jac) {
+            mj_comPos(m, d);
+            JacSites(m, d, *sites, jac + n*3*sites->size()*m->nv);
+        }
+    }
+};
+
 bn::ndarray PyMJCWorld2::GetCOMMulti(const bn::ndarray& x) {
     int state_size = StateSize(m_model);
     FAIL_IF_FALSE(x.get_dtype() == MJTNUM_DTYPE && x.get_nd() == 2 && x.get_flags() & bn::ndarray::C_CONTIGUOUS && x.shape(1) == state_size);
     int N = x.shape(0);
     long outdims[2] = {N,3};
     bn::ndarray out = bn::empty(2, outdims, bn::dtype::get_builtin<mjtNum>());
-    mjtNum* ptr = (mjtNum*)out.get_data();
-    for (int n=0; n < N; ++n) {
-        SetState(reinterpret_cast<const mjtNum*>(x.get_data()), m_model, m_data);
-        mj_kinematics(m_model, m_data);
-        GetCOM(m_model, m_data, ptr);
-        ptr += 3;
+    if (N > 0) {
+        std::vector<mjData*> workers = _GetWorkers(0);
+        KinematicsJob job = {m_model, reinterpret_cast<const mjtNum*>(x.get_data()), NULL,
+                             (mjtNum*)out.get_data(), NULL, NULL, NULL};
+        ScopedGILRelease nogil;
+        boost::mutex::scoped_lock lock(m_mutex);
+        RunBatch(m_model, m_data, workers, N, job, false);
     }
     return out;
 }
@@ -210,11 +807,91 @@ bn::ndarray PyMJCWorld2::GetCOMMulti(const bn::ndarray& x) {
 bn::ndarray PyMJCWorld2::GetJacSite(int site) {
     bn::ndarray out = bn::zeros(bp::make_tuple(3,m_model->nv), bn::dtype::get_builtin<mjtNum>());
     mjtNum* ptr = (mjtNum*)out.get_data();
+    ScopedGILRelease nogil;
+    boost::mutex::scoped_lock lock(m_mutex);
     mj_jacSite(m_model, m_data, ptr, 0, site);
     return out;
 }
 
+bn::ndarray PyMJCWorld2::GetJacSites(const bp::object& sites) {
+    std::vector<int> ids = ToSiteList(sites, m_model);
+    long outdims[2] = {3*(long)ids.size(), m_model->nv};
+    bn::ndarray out = bn::empty(2, outdims, MJTNUM_DTYPE);
+    {
+        ScopedGILRelease nogil;
+        boost::mutex::scoped_lock lock(m_mutex);
+        JacSites(m_model, m_data, ids, reinterpret_cast<mjtNum*>(out.get_data()));
+    }
+    return out;
+}
+
+// Site Jacobians along a trajectory X[T,nq+nv], as [T,3*len(sites),nv].
+// The states are evaluated in parallel on worker copies of the world's data,
+// which is left unchanged.
+bn::ndarray PyMJCWorld2::GetJacSitesTraj(const bn::ndarray& X, const bp::object& sites) {
+    int dS = StateSize(m_model);
+    FAIL_IF_FALSE(IsContiguousMjtNum(X, 2) && X.shape(1) == dS);
+    std::vector<int> ids = ToSiteList(sites, m_model);
+    long T = X.shape(0);
+    long outdims[3] = {T, 3*(long)ids.size(), m_model->nv};
+    bn::ndarray out = bn::empty(3, outdims, MJTNUM_DTYPE);
+    if (T > 0) {
+        std::vector<mjData*> workers = _GetWorkers(0);
+        KinematicsJob job = {m_model, reinterpret_cast<const mjtNum*>(X.get_data()), &ids,
+                             NULL, NULL, NULL, (mjtNum*)out.get_data()};
+        ScopedGILRelease nogil;
+        boost::mutex::scoped_lock lock(m_mutex);
+        RunBatch(m_model, m_data, workers, T, job, false);
+    }
+    return out;
+}
+
+bp::dict PyMJCWorld2::KinematicsBatch(const bn::ndarray& X, bool com, bool site_xpos, bool xpos,
+                                      const bp::object& jac_sites, int nthreads) {
+    int dS = StateSize(m_model), nv = m_model->nv;
+    FAIL_IF_FALSE(IsContiguousMjtNum(X, 2) && X.shape(1) == dS);
+    long N = X.shape(0);
+    std::vector<int> sites;
+    if (!jac_sites.is_none()) sites = ToSiteList(jac_sites, m_model);
+
+    KinematicsJob job = {m_model, reinterpret_cast<const mjtNum*>(X.get_data()), &sites, NULL, NULL, NULL, NULL};
+    bp::dict out;
+    if (com) {
+        long dims[2] = {N, 3};
+        bn::ndarray a = bn::empty(2, dims, MJTNUM_DTYPE);
+        job.com = (mjtNum*)a.get_data();
+        out["com"] = a;
+    }
+    if (site_xpos) {
+        long dims[3] = {N, m_model->nsite, 3};
+        bn::ndarray a = bn::empty(3, dims, MJTNUM_DTYPE);
+        job.site_xpos = (mjtNum*)a.get_data();
+        out["site_xpos"] = a;
+    }
+    if (xpos) {
+        long dims[3] = {N, m_model->nbody, 3};
+        bn::ndarray a = bn::empty(3, dims, MJTNUM_DTYPE);
+        job.xpos = (mjtNum*)a.get_data();
+        out["xpos"] = a;
+    }
+    if (!jac_sites.is_none()) {
+        long dims[3] = {N, 3*(long)sites.size(), nv};
+        bn::ndarray a = bn::empty(3, dims, MJTNUM_DTYPE);
+        job.jac = (mjtNum*)a.get_data();
+        out["jac_site"] = a;
+    }
+    if (N > 0) {
+        std::vector<mjData*> workers = _GetWorkers(nthreads);
+        ScopedGILRelease nogil;
+        boost::mutex::scoped_lock lock(m_mutex);
+        RunBatch(m_model, m_data, workers, N, job, false);
+    }
+    return out;
+}
+
 void PyMJCWorld2::Kinematics() {
+    ScopedGILRelease nogil;
+    boost::mutex::scoped_lock lock(m_mutex);
     mj_kinematics(m_model, m_data);
     mj_comPos(m_model, m_data);
     mj_tendon(m_model, m_data);
@@ -245,6 +922,8 @@ void PyMJCWorld2::_PlotInit(int width, int height, float x, float y, float z, fl
 void PyMJCWorld2::Plot(const bn::ndarray& x) {
     FAIL_IF_FALSE(x.get_dtype() == MJTNUM_DTYPE && x.get_nd() == 1 && x.get_flags() & bn::ndarray::C_CONTIGUOUS);
     _PlotInit();
+    ScopedGILRelease nogil;
+    boost::mutex::scoped_lock lock(m_mutex);
     SetState(reinterpret_cast<const mjtNum*>(x.get_data()),m_model,m_data);
 	m_viewer->SetData(m_data);
 	m_viewer->RenderOnce();
@@ -261,6 +940,8 @@ void PyMJCWorld2::InitViewer(int width, int height, float cx, float cy, float cz
 void PyMJCWorld2::Idle(const bn::ndarray& x) {
     FAIL_IF_FALSE(x.get_dtype() == MJTNUM_DTYPE && x.get_nd() == 1 && x.get_flags() & bn::ndarray::C_CONTIGUOUS);
     _PlotInit();
+    ScopedGILRelease nogil;
+    boost::mutex::scoped_lock lock(m_mutex);
     SetState(reinterpret_cast<const mjtNum*>(x.get_data()),m_model,m_data);
     m_viewer->SetData(m_data);
     m_viewer->Idle();
@@ -303,15 +984,36 @@ bp::dict PyMJCWorld2::GetModel() {
     return out;
 }
 void PyMJCWorld2::SetModel(bp::dict d) {
+    // Other threads may be reading the model without the GIL.
+    ScopedLockWithoutGIL lock(m_mutex);
     #include "mjcpy2_setmodel_autogen.i"
 }
 bp::dict PyMJCWorld2::GetData() {
+    ScopedLockWithoutGIL lock(m_mutex);
     bp::dict out;
     #include "mjcpy2_getdata_autogen.i"
 
     return out;
 }
+// Copies of the named mjData fields.
+bp::dict PyMJCWorld2::GetFields(bp::list names) {
+    ScopedLockWithoutGIL lock(m_mutex);
+    bp::dict out;
+    for (int i=0; i < bp::len(names); ++i) {
+        std::string name = bp::extract<std::string>(names[i]);
+        bp::object field = DataField(name, NULL);
+        if (field.is_none()) PRINT_AND_THROW("unknown mjData field: " + name);
+        out[name] = field;
+    }
+    return out;
+}
+// Field of m_data as a view that keeps owner alive (a copy if owner is NULL), None for unknown names.
+bp::object PyMJCWorld2::DataField(const std::string& name, const bp::object* owner) {
+    #include "mjcpy2_datafield_autogen.i"
+    return bp::object();
+}
 void PyMJCWorld2::SetData(bp::dict d) {
+    ScopedLockWithoutGIL lock(m_mutex);
     #include "mjcpy2_setdata_autogen.i"
 }
 
@@ -320,69 +1022,130 @@ void PyMJCWorld2::SetData(bp::dict d) {
 
 // grabs current image, returns an array of shape [height, width, channels]
 bp::dict PyMJCWorld2::GetImage() {
-    m_viewer->RenderOnce();
-    bp::dict out;
-    const unsigned char* tmp = static_cast<const unsigned char*>(m_viewer->m_image->getDataPointer());
-    out["num_pixels"] = m_viewer->m_image->getTotalDataSize();
-    out["width"] = m_viewer->m_image->s();
-    out["height"] = m_viewer->m_image->t();
-    int num_channels = 0;
-    if (m_viewer->m_image->getTotalDataSize() > 0)
-    {
-        num_channels = m_viewer->m_image->getTotalDataSize() / m_viewer->m_image->s() / m_viewer->m_image->t();
-    }
-    out["img"] = toNdarray3<unsigned char>(tmp, m_viewer->m_image->t(), m_viewer->m_image->s(), num_channels);
-    out["num_channels"] = num_channels;
-    return out;
+    return _RenderImage(-1, -1);
 }
 
 // grabs current image, returns an array of shape [height, width, channels]
 bp::dict PyMJCWorld2::GetImageScaled(int width, int height) {
-    m_viewer->RenderOnce();
-    m_viewer->m_image->scaleImage(width,height,m_viewer->m_image->r());
+    return _RenderImage(width, height);
+}
+
+// Render and grab the current image (scaled to width x height unless width < 0).
+// The pixels are copied out under the lock, without the GIL, and converted afterwards.
+bp::dict PyMJCWorld2::_RenderImage(int width, int height) {
+    std::vector<unsigned char> pixels;
+    int image_width, image_height, num_pixels;
+    {
+        ScopedGILRelease nogil;
+        boost::mutex::scoped_lock lock(m_mutex);
+        m_viewer->RenderOnce();
+        if (width >= 0) {
+            m_viewer->m_image->scaleImage(width,height,m_viewer->m_image->r());
+        }
+        const unsigned char* tmp = static_cast<const unsigned char*>(m_viewer->m_image->getDataPointer());
+        num_pixels = m_viewer->m_image->getTotalDataSize();
+        image_width = m_viewer->m_image->s();
+        image_height = m_viewer->m_image->t();
+        pixels.assign(tmp, tmp + num_pixels);
+    }
     bp::dict out;
-    const unsigned char* tmp = static_cast<const unsigned char*>(m_viewer->m_image->getDataPointer());
-    out["num_pixels"] = m_viewer->m_image->getTotalDataSize();
-    out["width"] = m_viewer->m_image->s();
-    out["height"] = m_viewer->m_image->t();
+    out["num_pixels"] = num_pixels;
+    out["width"] = image_width;
+    out["height"] = image_height;
     int num_channels = 0;
-    if (m_viewer->m_image->getTotalDataSize() > 0)
+    if (num_pixels > 0)
     {
-        num_channels = m_viewer->m_image->getTotalDataSize() / m_viewer->m_image->s() / m_viewer->m_image->t();
+        num_channels = num_pixels / image_width / image_height;
     }
-    out["img"] = toNdarray3<unsigned char>(tmp, m_viewer->m_image->t(), m_viewer->m_image->s(), num_channels);
+    out["img"] = toNdarray3<unsigned char>(pixels.empty() ? NULL : &pixels[0], image_height, image_width, num_channels);
     out["num_channels"] = num_channels;
     return out;
 }
 
 void PyMJCWorld2::SetCamera(float x, float y, float z, float px, float py, float pz){
     // place camera at (x,y,z) pointing to (px,py,pz)
+    ScopedGILRelease nogil;
+    boost::mutex::scoped_lock lock(m_mutex);
     m_viewer->SetCamera(x,y,z,px,py,pz);
 }
 
+// Attribute access to the live mjData of a world. Array attributes are views
+// that keep the world alive; they are read and written in place, so they
+// change as the world steps (use get_fields or get_data for copies).
+// Reads and writes through a view bypass m_mutex: a view must not be used
+// while another thread is inside a call on the same world (the calls that
+// release the GIL write m_data without it). get_fields copies under the lock.
+class PyMJCData {
+public:
+    PyMJCData(bp::object world) : m_world(world) {}
+    bp::object GetAttr(const std::string& name) {
+        PyMJCWorld2& world = bp::extract<PyMJCWorld2&>(m_world);
+        bp::object field = world.DataField(name, &m_world);
+        if (field.is_none()) {
+            PyErr_SetString(PyExc_AttributeError, name.c_str());
+            bp::throw_error_already_set();
+        }
+        return field;
+    }
+private:
+    bp::object m_world;
+};
+
+PyMJCData GetDataView(bp::object world) {
+    return PyMJCData(world);
+}
+
 BOOST_PYTHON_MODULE(mjcpy) {
+#if PY_VERSION_HEX < 0x03070000
+    // Needed before any call releases the GIL.
+    PyEval_InitThreads();
+#endif
     bn::initialize();
 
     bp::class_<PyMJCWorld2,boost::noncopyable>("MJCWorld","docstring here", bp::init<const std::string&>())
 
-        .def("step",&PyMJCWorld2::Step)
+        .def("step",&PyMJCWorld2::Step,
+             (bp::arg("x"), bp::arg("u"), bp::arg("substep_sites")=false))
+        .def("step_into",&PyMJCWorld2::StepInto,
+             (bp::arg("x"), bp::arg("u"), bp::arg("x_out"), bp::arg("site_out"), bp::arg("in_place")=false))
+        .def("rollout",&PyMJCWorld2::Rollout)
+        .def("rollout_lingauss",&PyMJCWorld2::RolloutLinGauss)
+        .def("linearize",&PyMJCWorld2::Linearize,
+             (bp::arg("X"), bp::arg("U"), bp::arg("eps"), bp::arg("substeps"), bp::arg("nthreads")=0))
+        .def("rollout_batch",&PyMJCWorld2::RolloutBatch,
+             (bp::arg("X0"), bp::arg("U"), bp::arg("substeps")=1, bp::arg("nthreads")=0))
+        .def("rollout_lingauss_batch",&PyMJCWorld2::RolloutLinGaussBatch,
+             (bp::arg("X0"), bp::arg("K"), bp::arg("k"), bp::arg("chol_pol_covar"), bp::arg("noise"),
+              bp::arg("substeps"), bp::arg("dt"), bp::arg("nthreads")=0))
         .def("get_model",&PyMJCWorld2::GetModel)
         .def("set_model",&PyMJCWorld2::SetModel)
         .def("get_data",&PyMJCWorld2::GetData)
         .def("set_data",&PyMJCWorld2::SetData)
+        .def("get_data_view",&GetDataView)
+        .def("get_fields",&PyMJCWorld2::GetFields)
         .def("plot",&PyMJCWorld2::Plot)
         .def("init_cam",&PyMJCWorld2::InitCam)
         .def("init_viewer",&PyMJCWorld2::InitViewer)
         .def("idle",&PyMJCWorld2::Idle)
         .def("get_COM_multi",&PyMJCWorld2::GetCOMMulti)
         .def("get_jac_site",&PyMJCWorld2::GetJacSite)
+        .def("get_jac_sites",&PyMJCWorld2::GetJacSites)
+        .def("get_jac_sites_traj",&PyMJCWorld2::GetJacSitesTraj)
         .def("kinematics",&PyMJCWorld2::Kinematics)
+        .def("kinematics_batch",&PyMJCWorld2::KinematicsBatch,
+             (bp::arg("X"), bp::arg("com")=true, bp::arg("site_xpos")=true, bp::arg("xpos")=false,
+              bp::arg("jac_sites")=bp::object(), bp::arg("nthreads")=0))
         .def("get_image",&PyMJCWorld2::GetImage)
         .def("get_image_scaled",&PyMJCWorld2::GetImageScaled)
         .def("set_num_steps",&PyMJCWorld2::SetNumSteps)
         .def("set_camera",&PyMJCWorld2::SetCamera)
         ;
 
+    bp::class_<PyMJCData>("MJCData","live view of the data of an MJCWorld; not synchronized with calls on the world "
+                          "from other threads, which may change the data while it is read", bp::no_init)
+        .def("__getattr__",&PyMJCData::GetAttr)
+        ;
+
 
     bp::object main = bp::import("__main__");
     main_namespace = main.attr("__dict__");
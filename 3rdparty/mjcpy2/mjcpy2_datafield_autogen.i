@@ -0,0 +1,99 @@
+    if (name == "nstack") return bp::object(m_data->nstack);
+    if (name == "nbuffer") return bp::object(m_data->nbuffer);
+    if (name == "pstack") return bp::object(m_data->pstack);
+    if (name == "maxstackuse") return bp::object(m_data->maxstackuse);
+    if (name == "ne") return bp::object(m_data->ne);
+    if (name == "nf") return bp::object(m_data->nf);
+    if (name == "nefc") return bp::object(m_data->nefc);
+    if (name == "ncon") return bp::object(m_data->ncon);
+    if (name == "nwarning") return dataField1<int>(m_data->nwarning, mjNWARNING, owner);
+    if (name == "timer_duration") return dataField1<mjtNum>(m_data->timer_duration, mjNTIMER, owner);
+    if (name == "timer_ncall") return dataField1<mjtNum>(m_data->timer_ncall, mjNTIMER, owner);
+    if (name == "mocaptime") return dataField1<mjtNum>(m_data->mocaptime, 3, owner);
+    if (name == "time") return bp::object(m_data->time);
+    if (name == "energy") return dataField1<mjtNum>(m_data->energy, 2, owner);
+    if (name == "solverstat") return dataField1<mjtNum>(m_data->solverstat, 4, owner);
+    if (name == "qpos") return dataField2<mjtNum>(m_data->qpos, m_model->nq, 1, owner);
+    if (name == "qvel") return dataField2<mjtNum>(m_data->qvel, m_model->nv, 1, owner);
+    if (name == "act") return dataField2<mjtNum>(m_data->act, m_model->na, 1, owner);
+    if (name == "ctrl") return dataField2<mjtNum>(m_data->ctrl, m_model->nu, 1, owner);
+    if (name == "qfrc_applied") return dataField2<mjtNum>(m_data->qfrc_applied, m_model->nv, 1, owner);
+    if (name == "xfrc_applied") return dataField2<mjtNum>(m_data->xfrc_applied, m_model->nbody, 6, owner);
+    if (name == "qacc") return dataField2<mjtNum>(m_data->qacc, m_model->nv, 1, owner);
+    if (name == "act_dot") return dataField2<mjtNum>(m_data->act_dot, m_model->na, 1, owner);
+    if (name == "mocap_pos") return dataField2<mjtNum>(m_data->mocap_pos, m_model->nmocap, 3, owner);
+    if (name == "mocap_quat") return dataField2<mjtNum>(m_data->mocap_quat, m_model->nmocap, 4, owner);
+    if (name == "userdata") return dataField2<mjtNum>(m_data->userdata, m_model->nuserdata, 1, owner);
+    if (name == "sensordata") return dataField2<mjtNum>(m_data->sensordata, m_model->nsensordata, 1, owner);
+    if (name == "xpos") return dataField2<mjtNum>(m_data->xpos, m_model->nbody, 3, owner);
+    if (name == "xquat") return dataField2<mjtNum>(m_data->xquat, m_model->nbody, 4, owner);
+    if (name == "xmat") return dataField2<mjtNum>(m_data->xmat, m_model->nbody, 9, owner);
+    if (name == "xipos") return dataField2<mjtNum>(m_data->xipos, m_model->nbody, 3, owner);
+    if (name == "ximat") return dataField2<mjtNum>(m_data->ximat, m_model->nbody, 9, owner);
+    if (name == "xanchor") return dataField2<mjtNum>(m_data->xanchor, m_model->njnt, 3, owner);
+    if (name == "xaxis") return dataField2<mjtNum>(m_data->xaxis, m_model->njnt, 3, owner);
+    if (name == "geom_xpos") return dataField2<mjtNum>(m_data->geom_xpos, m_model->ngeom, 3, owner);
+    if (name == "geom_xmat") return dataField2<mjtNum>(m_data->geom_xmat, m_model->ngeom, 9, owner);
+    if (name == "site_xpos") return dataField2<mjtNum>(m_data->site_xpos, m_model->nsite, 3, owner);
+    if (name == "site_xmat") return dataField2<mjtNum>(m_data->site_xmat, m_model->nsite, 9, owner);
+    if (name == "cam_xpos") return dataField2<mjtNum>(m_data->cam_xpos, m_model->ncam, 3, owner);
+    if (name == "cam_xmat") return dataField2<mjtNum>(m_data->cam_xmat, m_model->ncam, 9, owner);
+    if (name == "light_xpos") return dataField2<mjtNum>(m_data->light_xpos, m_model->nlight, 3, owner);
+    if (name == "light_xdir") return dataField2<mjtNum>(m_data->light_xdir, m_model->nlight, 3, owner);
+    if (name == "com_subtree") return dataField2<mjtNum>(m_data->com_subtree, m_model->nbody, 3, owner);
+    if (name == "cdof") return dataField2<mjtNum>(m_data->cdof, m_model->nv, 6, owner);
+    if (name == "cinert") return dataField2<mjtNum>(m_data->cinert, m_model->nbody, 10, owner);
+    if (name == "ten_wrapadr") return dataField2<int>(m_data->ten_wrapadr, m_model->ntendon, 1, owner);
+    if (name == "ten_wrapnum") return dataField2<int>(m_data->ten_wrapnum, m_model->ntendon, 1, owner);
+    if (name == "ten_length") return dataField2<mjtNum>(m_data->ten_length, m_model->ntendon, 1, owner);
+    if (name == "ten_moment") return dataField2<mjtNum>(m_data->ten_moment, m_model->ntendon, m_model->nv, owner);
+    if (name == "wrap_obj") return dataField2<int>(m_data->wrap_obj, m_model->nwrap*2, 1, owner);
+    if (name == "wrap_xpos") return dataField2<mjtNum>(m_data->wrap_xpos, m_model->nwrap*2, 3, owner);
+    if (name == "actuator_length") return dataField2<mjtNum>(m_data->actuator_length, m_model->nu, 1, owner);
+    if (name == "actuator_moment") return dataField2<mjtNum>(m_data->actuator_moment, m_model->nu, m_model->nv, owner);
+    if (name == "crb") return dataField2<mjtNum>(m_data->crb, m_model->nbody, 10, owner);
+    if (name == "qM") return dataField2<mjtNum>(m_data->qM, m_model->nM, 1, owner);
+    if (name == "qLD") return dataField2<mjtNum>(m_data->qLD, m_model->nM, 1, owner);
+    if (name == "qLDiagInv") return dataField2<mjtNum>(m_data->qLDiagInv, m_model->nv, 1, owner);
+    if (name == "qLDiagSqrtInv") return dataField2<mjtNum>(m_data->qLDiagSqrtInv, m_model->nv, 1, owner);
+    if (name == "efc_type") return dataField2<int>(m_data->efc_type, m_model->njmax, 1, owner);
+    if (name == "efc_id") return dataField2<int>(m_data->efc_id, m_model->njmax, 1, owner);
+    if (name == "efc_rownnz") return dataField2<int>(m_data->efc_rownnz, m_model->njmax, 1, owner);
+    if (name == "efc_rowadr") return dataField2<int>(m_data->efc_rowadr, m_model->njmax, 1, owner);
+    if (name == "efc_colind") return dataField2<int>(m_data->efc_colind, m_model->njmax, m_model->nv, owner);
+    if (name == "efc_rownnz_T") return dataField2<int>(m_data->efc_rownnz_T, m_model->nv, 1, owner);
+    if (name == "efc_rowadr_T") return dataField2<int>(m_data->efc_rowadr_T, m_model->nv, 1, owner);
+    if (name == "efc_colind_T") return dataField2<int>(m_data->efc_colind_T, m_model->nv, m_model->njmax, owner);
+    if (name == "efc_solref") return dataField2<mjtNum>(m_data->efc_solref, m_model->njmax, mjNREF, owner);
+    if (name == "efc_solimp") return dataField2<mjtNum>(m_data->efc_solimp, m_model->njmax, mjNIMP, owner);
+    if (name == "efc_margin") return dataField2<mjtNum>(m_data->efc_margin, m_model->njmax, 1, owner);
+    if (name == "efc_frictionloss") return dataField2<mjtNum>(m_data->efc_frictionloss, m_model->njmax, 1, owner);
+    if (name == "efc_pos") return dataField2<mjtNum>(m_data->efc_pos, m_model->njmax, 1, owner);
+    if (name == "efc_J") return dataField2<mjtNum>(m_data->efc_J, m_model->njmax, m_model->nv, owner);
+    if (name == "efc_J_T") return dataField2<mjtNum>(m_data->efc_J_T, m_model->nv, m_model->njmax, owner);
+    if (name == "efc_diagApprox") return dataField2<mjtNum>(m_data->efc_diagApprox, m_model->njmax, 1, owner);
+    if (name == "efc_R") return dataField2<mjtNum>(m_data->efc_R, m_model->njmax, 1, owner);
+    if (name == "efc_AR") return dataField2<mjtNum>(m_data->efc_AR, m_model->njmax, m_model->njmax, owner);
+    if (name == "e_ARchol") return dataField2<mjtNum>(m_data->e_ARchol, m_model->nemax, m_model->nemax, owner);
+    if (name == "fc_e_rect") return dataField2<mjtNum>(m_data->fc_e_rect, m_model->njmax, m_model->nemax, owner);
+    if (name == "fc_AR") return dataField2<mjtNum>(m_data->fc_AR, m_model->njmax, m_model->njmax, owner);
+    if (name == "ten_velocity") return dataField2<mjtNum>(m_data->ten_velocity, m_model->ntendon, 1, owner);
+    if (name == "actuator_velocity") return dataField2<mjtNum>(m_data->actuator_velocity, m_model->nu, 1, owner);
+    if (name == "cvel") return dataField2<mjtNum>(m_data->cvel, m_model->nbody, 6, owner);
+    if (name == "cdof_dot") return dataField2<mjtNum>(m_data->cdof_dot, m_model->nv, 6, owner);
+    if (name == "qfrc_bias") return dataField2<mjtNum>(m_data->qfrc_bias, m_model->nv, 1, owner);
+    if (name == "qfrc_passive") return dataField2<mjtNum>(m_data->qfrc_passive, m_model->nv, 1, owner);
+    if (name == "efc_vel") return dataField2<mjtNum>(m_data->efc_vel, m_model->njmax, 1, owner);
+    if (name == "efc_aref") return dataField2<mjtNum>(m_data->efc_aref, m_model->njmax, 1, owner);
+    if (name == "actuator_force") return dataField2<mjtNum>(m_data->actuator_force, m_model->nu, 1, owner);
+    if (name == "qfrc_actuator") return dataField2<mjtNum>(m_data->qfrc_actuator, m_model->nv, 1, owner);
+    if (name == "qfrc_unc") return dataField2<mjtNum>(m_data->qfrc_unc, m_model->nv, 1, owner);
+    if (name == "qacc_unc") return dataField2<mjtNum>(m_data->qacc_unc, m_model->nv, 1, owner);
+    if (name == "efc_b") return dataField2<mjtNum>(m_data->efc_b, m_model->njmax, 1, owner);
+    if (name == "fc_b") return dataField2<mjtNum>(m_data->fc_b, m_model->njmax, 1, owner);
+    if (name == "efc_force") return dataField2<mjtNum>(m_data->efc_force, m_model->njmax, 1, owner);
+    if (name == "qfrc_constraint") return dataField2<mjtNum>(m_data->qfrc_constraint, m_model->nv, 1, owner);
+    if (name == "qfrc_inverse") return dataField2<mjtNum>(m_data->qfrc_inverse, m_model->nv, 1, owner);
+    if (name == "cacc") return dataField2<mjtNum>(m_data->cacc, m_model->nbody, 6, owner);
+    if (name == "cfrc_int") return dataField2<mjtNum>(m_data->cfrc_int, m_model->nbody, 6, owner);
+    if (name == "cfrc_ext") return dataField2<mjtNum>(m_data->cfrc_ext, m_model->nbody, 6, owner);
@@ -4,6 +4,7 @@ Controller that executes a trial using a neural network policy using Caffe.
 #pragma once
 
 // Headers.
+#include <string>
 #include <vector>
 #include <Eigen/Dense>
 
@@ -15,6 +16,18 @@ Controller that executes a trial using a neural network policy using Caffe.
 namespace gps_control
 {
 
+// Settings of a Caffe network controller.
+struct CaffeNNControllerConfig : public TrialControllerConfig
+{
+    // Serialized net parameter with weights.
+    std::string net_param;
+    // Input scale and bias.
+    Eigen::MatrixXd scale;
+    Eigen::VectorXd bias;
+    // Action noise, one per step.
+    std::vector<Eigen::VectorXd> noise;
+};
+
 class CaffeNNController : public TrialController
 {
 private:
@@ -29,7 +42,7 @@ public:
     // Compute the action at the current time step.
     virtual void get_action(int t, const Eigen::VectorXd &X, const Eigen::VectorXd &obs, Eigen::VectorXd &U);
     // Configure the controller.
-    virtual void configure_controller(OptionsMap &options);
+    void configure(const CaffeNNControllerConfig &config);
 };
 
 }
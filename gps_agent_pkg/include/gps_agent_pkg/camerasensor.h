@@ -4,14 +4,20 @@ Camera sensor: records latest images from camera.
 #pragma once
 
 #include <sensor_msgs/Image.h>
+#include <boost/scoped_ptr.hpp>
+#include <boost/atomic.hpp>
+#include <Eigen/Dense>
 
 // Superclass.
 #include "gps_agent_pkg/sensor.h"
 #include "gps_agent_pkg/sample.h"
+#include "gps_agent_pkg/convfeatureextractor.h"
 
 // This sensor writes to the following data types:
 // RGBImage
 // DepthImage
+// or, if a feature extractor is loaded:
+// IMAGE_FEAT
 
 // Default values for image dimensions
 #define IMAGE_WIDTH_INIT 320
@@ -25,12 +31,22 @@ namespace gps_control
 class CameraSensor: public Sensor
 {
 private:
-    // Latest image.
-    std::vector<uint8_t> latest_rgb_image_;
+    // Cropped rgb images, triple buffered: the callback fills the back buffer
+    // and publishes it by exchanging it with the middle one, and the realtime
+    // thread takes the middle one as its front buffer. Neither side waits.
+    std::vector<uint8_t> rgb_images_[3];
+    // Time at which each rgb image was first published.
+    ros::Time rgb_times_[3];
+    // Buffers owned by the callback and by the realtime thread.
+    int rgb_back_, rgb_front_;
+    // Middle buffer, with RGB_IMAGE_FRESH set until the realtime thread takes it.
+    boost::atomic<int> rgb_middle_;
+
+    // Latest depth image.
     std::vector<uint16_t> latest_depth_image_;
 
-    // Time at which the image was first published.
-    ros::Time latest_rgb_time_, latest_depth_time_;
+    // Time at which the depth image was first published.
+    ros::Time latest_depth_time_;
 
     // Image subscribers
     ros::Subscriber depth_subscriber_, rgb_subscriber_;
@@ -40,6 +56,21 @@ private:
 
     std::string rgb_topic_name_, depth_topic_name_;
 
+    // Optional native feature extractor, run in a sensor worker.
+    boost::scoped_ptr<ConvFeatureExtractor> feature_extractor_;
+    // Image captured for the feature extractor.
+    std::vector<uint8_t> snapshot_rgb_image_;
+    // Features computed from the snapshot, and the latest committed features.
+    Eigen::VectorXd snapshot_features_;
+    Eigen::VectorXd latest_features_;
+    // Time of the image behind the snapshot and behind the committed features.
+    ros::Time snapshot_rgb_time_, latest_features_time_;
+
+    // Load the feature extractor named by the image_feature_weights parameter.
+    void initialize_feature_extractor(ros::NodeHandle& n);
+    // Take the latest published rgb image as the front buffer (realtime thread).
+    void acquire_rgb_image();
+
 public:
     // Constructor.
     CameraSensor(ros::NodeHandle& n, RobotPlugin *plugin);
@@ -47,15 +78,29 @@ public:
     virtual ~CameraSensor();
     // Update the sensor (called every tick).
     virtual void update(RobotPlugin *plugin, ros::Time current_time, bool is_controller_step);
+    // Only update when a new rgb image arrived.
+    virtual SensorUpdateRate get_update_rate() const;
+    virtual bool has_new_data() const;
+    // Feature extraction runs asynchronously.
+    virtual SensorExecutionMode get_execution_mode() const;
+    // Copy the latest rgb image for the feature extractor.
+    virtual void capture_snapshot(RobotPlugin *plugin, ros::Time current_time);
+    // Run the feature extractor on the captured image.
+    virtual void process_snapshot();
+    // Make the extracted features visible to set_sample_data.
+    virtual void commit_snapshot();
+    // Time of the image behind the sample data. Extraction takes several
+    // controller steps, so the features lag the current time.
+    virtual ros::Time get_data_time(ros::Time current_time) const;
     void update_rgb_image(const sensor_msgs::Image::ConstPtr& msg);
     void update_depth_image(const sensor_msgs::Image::ConstPtr& msg);
     // Configure the sensor (for sensor-specific trial settings).
     // This function is used to set resolution, cropping, topic to listen to...
-    virtual void configure_sensor(const OptionsMap &options);
+    virtual void configure_sensor(const SensorConfig &config);
     // Set data format and meta data on the provided sample.
-    virtual void set_sample_data_format(boost::scoped_ptr<Sample> sample) const;
+    virtual void set_sample_data_format(boost::scoped_ptr<Sample>& sample);
     // Set data on the provided sample.
-    virtual void set_sample_data(boost::scoped_ptr<Sample> sample) const;
+    virtual void set_sample_data(boost::scoped_ptr<Sample>& sample, int t);
 };
 
 }
@@ -0,0 +1,71 @@
+/*
+Convolutional feature extractor for vision policies. A stack of convolution
+layers is evaluated with im2col and a float32 GEMM per layer, followed by the
+spatial softmax feature-point layer used in the GPS vision networks, which
+turns every channel of the last layer into an expected (x, y) image position.
+
+Weights use the flat blob format of NeuralNetworkNative. Each record holds a
+convolution as its im2col matrix: output_size is the number of output
+channels and the row-major weights are ordered (output, kernel row, kernel
+column, input channel), i.e. a TensorFlow HWIO kernel transposed to OHWI.
+Convolutions use valid padding.
+*/
+#pragma once
+
+// Headers.
+#include <vector>
+#include <stdint.h>
+#include <Eigen/Dense>
+#include "gps_agent_pkg/neuralnetworknative.h"
+
+namespace gps_control
+{
+
+// A convolution layer together with its preallocated buffers. Activations are
+// stored channels x pixels, so each pixel's channels are contiguous.
+struct ConvLayer
+{
+    int in_channels, out_channels, kernel_size, stride;
+    int in_height, in_width, out_height, out_width;
+    // Weights, out_channels x (kernel_size * kernel_size * in_channels).
+    Eigen::MatrixXf weights;
+    Eigen::VectorXf bias;
+    NeuralNetworkActivation activation;
+    // im2col buffer, (kernel_size * kernel_size * in_channels) x output pixels.
+    Eigen::MatrixXf columns;
+    // Layer output, out_channels x output pixels.
+    Eigen::MatrixXf output;
+};
+
+class ConvFeatureExtractor
+{
+private:
+    std::vector<ConvLayer> layers_;
+    // Image converted to float, channels x pixels.
+    Eigen::MatrixXf input_;
+    // Normalized image coordinates of each pixel of the last layer, in [-1, 1].
+    Eigen::RowVectorXf pixel_x_, pixel_y_;
+    // Softmax of one channel of the last layer.
+    Eigen::RowVectorXf softmax_;
+    // Number of channels of the input image.
+    int image_channels_;
+
+    // Expand the receptive fields of a layer input into the columns of its im2col buffer.
+    static void im2col(const Eigen::MatrixXf &input, ConvLayer &layer);
+public:
+    // Constructor.
+    ConvFeatureExtractor();
+    // Destructor.
+    virtual ~ConvFeatureExtractor();
+    // Load the convolution layers for images of the given size. strides holds
+    // the stride of each layer (missing entries default to 1).
+    bool load_weights(const uint8_t *data, size_t size, int image_channels, int image_height, int image_width,
+                      const std::vector<int> &strides);
+    // Compute the feature points of an interleaved 8-bit image (height x width x channels).
+    // The features are all expected x coordinates followed by all expected y coordinates.
+    void extract(const uint8_t *image, Eigen::VectorXd &features);
+    // Number of features (twice the number of channels of the last layer).
+    int get_num_features() const;
+};
+
+}
@@ -20,10 +20,20 @@ private:
     Eigen::MatrixXd time_matrix_;
     Eigen::VectorXd observation_vector_;
     Eigen::MatrixXd filtered_state_;
+    // Preallocated storage for the next filter state.
+    Eigen::MatrixXd next_state_;
 
+protected:
     int num_joints_;
     bool is_configured_;
+
+    // Constructor used by subclasses that configure themselves.
+    EncoderFilter(int num_joints);
+    // Parse the time matrix and observation vector from the parameter string.
+    static bool parse_params(const std::string &params, Eigen::MatrixXd &time_matrix, Eigen::VectorXd &observation_vector);
 public:
+    // Factory function. Picks a fixed-order filter for the common filter orders.
+    static EncoderFilter* create_filter(ros::NodeHandle& n, const Eigen::VectorXd &initial_state);
     // Constructor.
     EncoderFilter(ros::NodeHandle& n, const Eigen::VectorXd &initial_state);
     // Destructor.
@@ -37,6 +47,89 @@ public:
     virtual void get_state(Eigen::VectorXd &state) const;
     // Return filtered velocity.
     virtual void get_velocity(Eigen::VectorXd &state) const;
+    // Check whether the filter estimates velocities (filter order of at least 2).
+    virtual bool has_velocity() const;
+};
+
+// Kalman filter with the filter order fixed at compile time. The state is
+// stored joints-major (one column per filter state, one row per joint), so
+// the update is a small unrolled sum of column operations that vectorizes
+// across joints and never allocates. Order must be at least 2.
+template <int Order>
+class FixedOrderEncoderFilter : public EncoderFilter
+{
+private:
+    Eigen::Matrix<double,Order,Order> fixed_time_matrix_;
+    Eigen::Matrix<double,Order,1> fixed_observation_vector_;
+    // Filtered state, joints x filter order.
+    Eigen::Matrix<double,Eigen::Dynamic,Order> joint_state_;
+    // Preallocated storage for the next filter state.
+    Eigen::Matrix<double,Eigen::Dynamic,Order> next_joint_state_;
+
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    // Constructor.
+    FixedOrderEncoderFilter(const Eigen::MatrixXd &time_matrix, const Eigen::VectorXd &observation_vector,
+                            const Eigen::VectorXd &initial_state)
+    : EncoderFilter(initial_state.size())
+    {
+        fixed_time_matrix_ = time_matrix;
+        fixed_observation_vector_ = observation_vector;
+        joint_state_.setZero(num_joints_, Order);
+        joint_state_.col(0) = initial_state;
+        next_joint_state_.resize(num_joints_, Order);
+        is_configured_ = true;
+    }
+
+    // Destructor.
+    virtual ~FixedOrderEncoderFilter()
+    {
+    }
+
+    // Update the Kalman filter: x' = A x + b y, evaluated one state column at a time.
+    virtual void update(double sec_elapsed, Eigen::VectorXd &state)
+    {
+        for (int i = 0; i < Order; ++i) {
+            next_joint_state_.col(i) = fixed_observation_vector_(i) * state;
+            for (int j = 0; j < Order; ++j) {
+                next_joint_state_.col(i) += fixed_time_matrix_(i,j) * joint_state_.col(j);
+            }
+        }
+        joint_state_.swap(next_joint_state_);
+    }
+
+    // Configure the Kalman filter.
+    virtual void configure(const std::string &params)
+    {
+        Eigen::MatrixXd time_matrix;
+        Eigen::VectorXd observation_vector;
+        if (!parse_params(params, time_matrix, observation_vector) || observation_vector.size() != Order) {
+            ROS_ERROR("Encoder filter params do not describe a filter of order %d", Order);
+            return;
+        }
+        fixed_time_matrix_ = time_matrix;
+        fixed_observation_vector_ = observation_vector;
+        joint_state_.setZero();
+    }
+
+    // Return filtered state.
+    virtual void get_state(Eigen::VectorXd &state) const
+    {
+        state = joint_state_.col(0);
+    }
+
+    // Return filtered velocity.
+    virtual void get_velocity(Eigen::VectorXd &velocity) const
+    {
+        velocity = joint_state_.col(1);
+    }
+
+    // Check whether the filter estimates velocities.
+    virtual bool has_velocity() const
+    {
+        return true;
+    }
 };
 
 }
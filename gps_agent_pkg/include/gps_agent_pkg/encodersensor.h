@@ -1,5 +1,9 @@
 /*
 Joint encoder sensor: returns joint angles and, optionally, their velocities.
+If the velocity_decimator parameter is set ("fir" or "iir"), the joint
+velocities are differenced on every tick at encoder_rate and low-pass
+filtered down to the controller rate, instead of being differenced between
+controller steps.
 */
 #pragma once
 
@@ -65,8 +69,10 @@ private:
     Eigen::MatrixXd end_effector_points_target_;
     // Velocities of points.
     Eigen::MatrixXd previous_end_effector_point_velocities_;
-    // Temporary storage.
-    Eigen::MatrixXd temp_end_effector_points_;
+    // Joint angles and end-effector points of the last controller step, for
+    // the finite-difference velocities.
+    Eigen::VectorXd step_angles_;
+    Eigen::MatrixXd step_end_effector_points_;
     // Previous end-effector position.
     Eigen::Vector3d previous_position_;
     // Previous end-effector rotation.
@@ -76,8 +82,44 @@ private:
     // Time from last update when the previous angles were recorded (necessary to compute velocities).
     ros::Time previous_angles_time_;
 
+    // Whether the joint velocities go through a decimator, and which kind.
+    bool use_velocity_decimator_;
+    SensorDecimatorType velocity_decimator_type_;
+    // Whether a velocity decimator is attached for the current trial.
+    bool decimate_velocities_;
+    // Nominal rate of the encoder readings, in Hz.
+    double encoder_rate_;
+    // Raw joint angles and time of the previous tick, and the per-tick velocities.
+    Eigen::VectorXd tick_angles_;
+    Eigen::VectorXd tick_velocities_;
+    ros::Time previous_tick_time_;
+
+    // Rotated end-effector point offsets of the current step.
+    Eigen::MatrixXd rotated_end_effector_points_;
+
+    // Joint angles and rotated point offsets captured for the Jacobians.
+    Eigen::VectorXd snapshot_angles_;
+    Eigen::MatrixXd snapshot_end_effector_points_;
+    // Time at which the snapshot was captured.
+    ros::Time snapshot_time_;
+    // KDL joint array for the Jacobian solver (kept apart from the one used for FK).
+    KDL::JntArray snapshot_joint_array_;
+    // Jacobians computed from the snapshot, swapped into the current ones on commit.
+    Eigen::MatrixXd snapshot_jacobian_;
+    Eigen::MatrixXd snapshot_point_jacobians_;
+    Eigen::MatrixXd snapshot_point_jacobians_rot_;
+    // Time of the joint angles behind the current Jacobians.
+    ros::Time jacobian_time_;
+    // Compute the Jacobians in a sensor worker instead of the realtime thread.
+    // The joint state and end effector points are always computed inline.
+    bool async_kinematics_;
+
     // which arm is this EncoderSensor for?
     gps::ActuatorType actuator_type_;
+
+    // Read the filtered joint state and compute FK and end effector points
+    // (realtime thread). Velocities are only updated on controller steps.
+    void update_state(RobotPlugin *plugin, ros::Time current_time, bool is_controller_step);
 public:
     // Constructor.
     EncoderSensor(ros::NodeHandle& n, RobotPlugin *plugin, gps::ActuatorType actuator_type);
@@ -85,8 +127,22 @@ public:
     virtual ~EncoderSensor();
     // Update the sensor (called every tick).
     virtual void update(RobotPlugin *plugin, ros::Time current_time, bool is_controller_step);
+    // The filter runs every tick; FK runs on controller steps, or every tick if the trial controller needs it.
+    virtual SensorUpdateRate get_update_rate() const;
+    // Get the expected cost of one update, in seconds.
+    virtual double get_update_cost() const;
+    // Jacobians run asynchronously if the async_kinematics parameter is set.
+    virtual SensorExecutionMode get_execution_mode() const;
+    // Capture the joint angles and point offsets of the current step for the Jacobians.
+    virtual void capture_snapshot(RobotPlugin *plugin, ros::Time current_time);
+    // Compute the end effector and point Jacobians from the snapshot.
+    virtual void process_snapshot();
+    // Swap the snapshot Jacobians into the sample data.
+    virtual void commit_snapshot();
+    // The Jacobians are the oldest data (one controller step old when asynchronous).
+    virtual ros::Time get_data_time(ros::Time current_time) const;
     // Configure the sensor (for sensor-specific trial settings).
-    virtual void configure_sensor(OptionsMap &options);
+    virtual void configure_sensor(const SensorConfig &config);
     // Set data format and meta data on the provided sample.
     virtual void set_sample_data_format(boost::scoped_ptr<Sample>& sample);
     // Set data on the provided sample.
@@ -0,0 +1,40 @@
+/*
+Minimum-time joint-space trajectory between two configurations under per-joint
+velocity and acceleration limits. All joints move along the straight line in
+joint space and arrive together, so the path is scaled by a single
+trapezoidal (or, for short moves, triangular) velocity profile whose limits
+are set by the most constrained joint.
+*/
+#pragma once
+
+// Headers.
+#include <Eigen/Dense>
+
+namespace gps_control
+{
+
+class JointTrajectory
+{
+private:
+    // Start configuration and displacement to the goal.
+    Eigen::VectorXd start_;
+    Eigen::VectorXd delta_;
+    // Limits on the path parameter s in [0,1].
+    double max_path_velocity_;
+    double max_path_acceleration_;
+    // Duration of the acceleration (and deceleration) phase, and of the whole motion.
+    double accel_time_;
+    double duration_;
+public:
+    // Constructor.
+    JointTrajectory();
+    // Plan a motion from start to goal (allocates; call outside the realtime loop or once per reset).
+    void plan(const Eigen::VectorXd &start, const Eigen::VectorXd &goal,
+              const Eigen::VectorXd &max_velocities, const Eigen::VectorXd &max_accelerations);
+    // Evaluate the position, velocity and acceleration at time t after the start.
+    void evaluate(double t, Eigen::VectorXd &position, Eigen::VectorXd &velocity, Eigen::VectorXd &acceleration) const;
+    // Duration of the motion in seconds.
+    double get_duration() const;
+};
+
+}
@@ -1,6 +1,8 @@
 /*
 Controller that executes a trial using a time-varying linear-Gaussian
-control law.
+control law. Optionally, the control law is also evaluated on every tick
+between controller steps, with the gains interpolated between the trajectory
+knots.
 */
 #pragma once
 
@@ -14,6 +16,27 @@ control law.
 namespace gps_control
 {
 
+// How the gains are interpolated between controller steps.
+enum LinGaussInterpolation
+{
+    LinGaussInterpolationNone = 0, // Hold the torque between controller steps.
+    LinGaussInterpolationLinear,   // Linear in time between neighbouring knots.
+    LinGaussInterpolationCubic,    // Catmull-Rom spline through the knots.
+    TotalLinGaussInterpolationTypes
+};
+
+// Settings of a linear-Gaussian controller.
+struct LinearGaussianControllerConfig : public TrialControllerConfig
+{
+    // Linear feedbacks (dU x dX) and biases (dU), one per step.
+    std::vector<Eigen::MatrixXd> K;
+    std::vector<Eigen::VectorXd> k;
+    // Interpolation between knots.
+    LinGaussInterpolation interpolation;
+    // Time between knots, in seconds.
+    double step_period;
+};
+
 class LinearGaussianController : public TrialController
 {
 private:
@@ -22,6 +45,16 @@ private:
 
     // Bias.
     std::vector<Eigen::VectorXd> k_;
+
+    // Interpolation between knots.
+    LinGaussInterpolation interpolation_;
+    // Time between knots, in seconds.
+    double step_period_;
+    // Preallocated storage for the per-knot actions.
+    Eigen::VectorXd knot_action_;
+
+    // Add weight*(K_[t]*X+k_[t]) to U, with t clamped to the trajectory.
+    void add_knot_action(int t, double weight, const Eigen::VectorXd &X, Eigen::VectorXd &U);
 public:
     // Constructor.
     LinearGaussianController();
@@ -29,8 +62,12 @@ public:
     virtual ~LinearGaussianController();
     // Compute the action at the current time step.
     virtual void get_action(int t, const Eigen::VectorXd &X, const Eigen::VectorXd &obs, Eigen::VectorXd &U);
+    // Compute the action between controller steps from interpolated gains.
+    virtual void get_tick_action(int t, double elapsed, const Eigen::VectorXd &X, Eigen::VectorXd &U);
+    // Check whether the control law runs on every tick.
+    virtual bool updates_every_tick() const;
     // Configure the controller.
-    virtual void configure_controller(OptionsMap &options);
+    void configure(const LinearGaussianControllerConfig &config);
 };
 
 }
@@ -0,0 +1,53 @@
+/*
+Controller that executes a trial using a dense neural network policy that is
+evaluated natively in the realtime thread. The network backend is picked by
+name from the network registry (a native backend by default).
+*/
+#pragma once
+
+// Headers.
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+
+#include "gps_agent_pkg/neuralnetworknative.h"
+
+// Superclass.
+#include "gps_agent_pkg/trialcontroller.h"
+
+namespace gps_control
+{
+
+// Settings of a native network controller.
+struct NativeNNControllerConfig : public TrialControllerConfig
+{
+    // Flat binary weight blob (see neuralnetworknative.h).
+    std::string weights;
+    // Registered network backend (picked from the precision if empty).
+    std::string network_backend;
+    NeuralNetworkPrecision precision;
+    // Input scale and bias.
+    Eigen::MatrixXd scale;
+    Eigen::VectorXd bias;
+    // Action noise, one per step.
+    std::vector<Eigen::VectorXd> noise;
+};
+
+class NativeNNController : public TrialController
+{
+private:
+    // Network, created by name from the network registry.
+    boost::scoped_ptr<NeuralNetwork> net_;
+    std::vector<Eigen::VectorXd> noise_;
+public:
+    // Constructor.
+    NativeNNController();
+    // Destructor.
+    virtual ~NativeNNController();
+    // Compute the action at the current time step.
+    virtual void get_action(int t, const Eigen::VectorXd &X, const Eigen::VectorXd &obs, Eigen::VectorXd &U);
+    // Configure the controller.
+    void configure(const NativeNNControllerConfig &config);
+};
+
+}
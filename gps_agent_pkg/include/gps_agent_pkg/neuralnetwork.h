@@ -7,6 +7,7 @@ is a helper class for running neural networks on the robot.
 // Headers
 #include <Eigen/Dense>
 #include <vector>
+#include <stdint.h>
 #include <ros/ros.h>
 
 namespace gps_control
@@ -17,11 +18,18 @@ protected:
     // Internal scales and biases of network input
     Eigen::MatrixXd scale_;
     Eigen::VectorXd bias_;
+    // Diagonal of the scale, used instead of the full matrix when the scale is diagonal.
+    Eigen::VectorXd scale_diagonal_;
+    bool is_scale_diagonal_;
+
+    // Compute input_scaled_ from the leading entries of the input.
+    void scale_input(const Eigen::VectorXd &input);
 
 public:
     // Pre-allocated scaled input data
     Eigen::VectorXd input_scaled_;
 
+    NeuralNetwork();
     virtual ~NeuralNetwork();
 
     // Function that takes in an input state and outputs the neural network output action.
@@ -35,6 +43,14 @@ public:
     // Set the weights of the neural network.
     // Should be implemented in the subclass.
     virtual void set_weights(void *weights_ptr);
+
+    // Load the weights from a flat binary blob (see neuralnetworknative.h).
+    // Returns false if the blob is malformed or the network does not support it.
+    virtual bool load_weights(const uint8_t *data, size_t size);
+
+    // Number of network inputs and outputs (-1 if unknown).
+    virtual int get_input_size() const;
+    virtual int get_output_size() const;
 };
 
 }
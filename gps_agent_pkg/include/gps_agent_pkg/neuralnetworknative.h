@@ -0,0 +1,150 @@
+/*
+Dependency-free neural network for dense (fully connected) policies. The
+weights are loaded from a flat binary blob, and the forward pass runs entirely
+in preallocated Eigen storage, so it can be evaluated in the realtime thread.
+
+Blob layout (little-endian):
+    uint32 magic (NATIVE_NN_MAGIC), uint32 version, uint32 num_layers
+    for each layer:
+        uint32 output_size, uint32 input_size, uint32 activation
+        float64 weights[output_size*input_size] (row-major)
+        float64 bias[output_size]
+*/
+#pragma once
+
+// Headers
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <Eigen/Dense>
+#include <ros/ros.h>
+#include "gps_agent_pkg/neuralnetwork.h"
+
+#define NATIVE_NN_MAGIC 0x4e535047
+#define NATIVE_NN_VERSION 1
+
+namespace gps_control
+{
+
+// Activation applied after the bias of a dense layer.
+enum NeuralNetworkActivation
+{
+    ActivationLinear = 0,
+    ActivationRelu,
+    ActivationTanh,
+    ActivationSigmoid,
+    TotalActivationTypes
+};
+
+// Numeric precision of the forward pass.
+enum NeuralNetworkPrecision
+{
+    PrecisionDouble = 0,
+    // Float32 weights and activations.
+    PrecisionFloat,
+    // Int8 weights with one scale per output channel, int8 inputs quantized
+    // per layer, int32 accumulation and float32 activations.
+    PrecisionInt8,
+    TotalPrecisionTypes
+};
+
+// A dense layer: output = activation(weights * input + bias).
+struct DenseLayer
+{
+    Eigen::MatrixXd weights;
+    Eigen::VectorXd bias;
+    NeuralNetworkActivation activation;
+};
+
+// Float32 copy of a dense layer.
+struct DenseLayerFloat
+{
+    Eigen::MatrixXf weights;
+    Eigen::VectorXf bias;
+    NeuralNetworkActivation activation;
+};
+
+// Int8 copy of a dense layer, quantized symmetrically per output channel:
+// weights(i,j) ~= channel_scales(i) * quantized_weights[i*cols+j].
+// Columns of the int8 weights are padded to a multiple of this many, so that
+// the dot products run in fixed-size blocks (which GCC vectorizes at -O2).
+#define NATIVE_NN_INT8_BLOCK 16
+
+struct DenseLayerInt8
+{
+    int rows, cols;
+    // cols rounded up to a multiple of NATIVE_NN_INT8_BLOCK.
+    int padded_cols;
+    // Row-major quantized weights (rows x padded_cols, zero padded).
+    std::vector<int8_t> quantized_weights;
+    Eigen::VectorXf channel_scales;
+    Eigen::VectorXf bias;
+    NeuralNetworkActivation activation;
+};
+
+// Accuracy of a reduced-precision forward pass against the double reference.
+struct NeuralNetworkCalibration
+{
+    // Largest absolute output error.
+    double max_abs_error;
+    // Root mean square output error.
+    double rms_error;
+    // Root mean square of the reference outputs, for scale.
+    double rms_output;
+};
+
+class NeuralNetworkNative : public NeuralNetwork {
+protected:
+    // Network layers.
+    std::vector<DenseLayer> layers_;
+    // Preallocated layer outputs.
+    std::vector<Eigen::VectorXd> activations_;
+
+    // Precision used by forward.
+    NeuralNetworkPrecision precision_;
+    // Reduced-precision copies of the layers (built by set_precision).
+    std::vector<DenseLayerFloat> float_layers_;
+    std::vector<DenseLayerInt8> int8_layers_;
+    // Preallocated float32 storage for the scaled input and layer outputs.
+    Eigen::VectorXf input_float_;
+    std::vector<Eigen::VectorXf> activations_float_;
+    // Preallocated storage for the quantized layer input (int8 range, widened to int16).
+    std::vector<int16_t> input_quantized_;
+
+    // Forward pass at each precision, starting from input_scaled_.
+    void forward_double(Eigen::VectorXd &output);
+    void forward_float(Eigen::VectorXd &output);
+    void forward_int8(Eigen::VectorXd &output);
+    // Build the reduced-precision layers.
+    void build_float_layers();
+    void build_int8_layers();
+
+public:
+    // Constructor. The precision is applied whenever weights are loaded.
+    NeuralNetworkNative(NeuralNetworkPrecision precision = PrecisionDouble);
+    virtual ~NeuralNetworkNative();
+
+    // Function that takes in an input state and outputs the neural network output action.
+    virtual void forward(const Eigen::VectorXd &input, Eigen::VectorXd &output);
+
+    // Set the weights of the neural network from a std::string holding the blob.
+    virtual void set_weights(void *weights_ptr);
+    // Load the layers from a flat binary blob. Returns false if the blob is malformed.
+    virtual bool load_weights(const uint8_t *data, size_t size);
+    // Parse the layer records of a flat binary blob without checking that consecutive layers fit together.
+    static bool parse_layers(const uint8_t *data, size_t size, std::vector<DenseLayer> &layers);
+
+    // Select the precision of the forward pass, building the reduced-precision weights.
+    virtual void set_precision(NeuralNetworkPrecision precision);
+    NeuralNetworkPrecision get_precision() const;
+    // Compare the forward pass at the given precision against the double
+    // reference on a set of inputs (one per column, before scale and bias).
+    virtual NeuralNetworkCalibration calibrate(const Eigen::MatrixXd &inputs, NeuralNetworkPrecision precision);
+
+    // Number of inputs of the first layer.
+    virtual int get_input_size() const;
+    // Number of outputs of the last layer.
+    virtual int get_output_size() const;
+};
+
+}
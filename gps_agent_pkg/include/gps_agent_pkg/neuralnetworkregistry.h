@@ -0,0 +1,35 @@
+/*
+Registry of neural network backends. Each backend registers a factory under a
+name from its own translation unit (with REGISTER_NEURAL_NETWORK), so that
+controllers and tools can pick a backend by name without knowing its type.
+*/
+#pragma once
+
+// Headers.
+#include <string>
+#include <vector>
+
+#include "gps_agent_pkg/neuralnetwork.h"
+
+// Register a network factory at static initialization time.
+#define REGISTER_NEURAL_NETWORK(name, factory) \
+    static bool factory##_registered = gps_control::NeuralNetworkRegistry::register_network(name, factory)
+
+namespace gps_control
+{
+
+// Creates a new, unconfigured network.
+typedef NeuralNetwork *(*NeuralNetworkFactory)();
+
+class NeuralNetworkRegistry
+{
+public:
+    // Register a factory under a name. Returns false if the name is taken.
+    static bool register_network(const std::string &name, NeuralNetworkFactory factory);
+    // Create a network by name (NULL if no backend has that name).
+    static NeuralNetwork *create(const std::string &name);
+    // Names of all registered backends, in sorted order.
+    static void get_registered(std::vector<std::string> &names);
+};
+
+}
@@ -0,0 +1,21 @@
+/*
+Batched end-effector point Jacobian computation. Given the 6xN Jacobian of the
+end-effector frame and the offsets of all tracked points (already rotated into
+the base frame), this computes the positional and rotational Jacobians of every
+point in one pass over the joints.
+*/
+#pragma once
+
+// Headers.
+#include <Eigen/Dense>
+
+namespace gps_control
+{
+
+// Compute the point Jacobians (3*n_points x n_joints) and their rotational
+// counterparts from the end-effector Jacobian (6 x n_joints) and the rotated
+// point offsets (3 x n_points). Outputs must already have the correct size.
+void compute_point_jacobians(const Eigen::MatrixXd &jacobian, const Eigen::MatrixXd &rotated_points,
+                             Eigen::MatrixXd &point_jacobians, Eigen::MatrixXd &point_jacobians_rot);
+
+}
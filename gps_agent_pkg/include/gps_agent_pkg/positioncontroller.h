@@ -1,19 +1,37 @@
 /*
 Controller that moves the arm to a position, either in joint space or in task
-space.
+space. In JOINT_SPACE_TRAJECTORY mode it tracks a minimum-time trajectory to
+the target with feedforward plus PD control; in TASK_SPACE mode it moves
+towards the target end-effector pose by damped least squares.
 */
 #pragma once
 
 // Headers.
 #include <Eigen/Dense>
+#include <boost/shared_ptr.hpp>
+#include <kdl/chainfksolverpos_recursive.hpp>
+#include <kdl/chainjnttojacsolver.hpp>
+#include <kdl/chaindynparam.hpp>
+#include <kdl/jntspaceinertiamatrix.hpp>
 
 // Superclass.
 #include "gps_agent_pkg/controller.h"
+#include "gps_agent_pkg/jointtrajectory.h"
 #include "gps/proto/gps.pb.h"
 
 namespace gps_control
 {
 
+// Settings of a position command.
+struct PositionControllerConfig
+{
+    gps::PositionControlMode mode;
+    // Joint angles, or task-space position optionally followed by roll, pitch and yaw.
+    Eigen::VectorXd data;
+    // One row per joint: P, I and D gains and the integral clamp (may be empty for NO_CONTROL).
+    Eigen::MatrixXd pd_gains;
+};
+
 class PositionController : public Controller
 {
 private:
@@ -28,6 +46,8 @@ private:
     Eigen::VectorXd i_clamp_;
     // Maximum joint velocities.
     Eigen::VectorXd max_velocities_;
+    // Maximum joint accelerations.
+    Eigen::VectorXd max_accelerations_;
     // Temporary storage for Jacobian.
     Eigen::MatrixXd temp_jacobian_;
     // Temporary storage for joint angle offset.
@@ -42,6 +62,48 @@ private:
     Eigen::VectorXd current_angle_velocities_;
     // Latest pose.
     Eigen::VectorXd current_pose_;
+    // Reference position, velocity and feedforward torques tracked by the PD law.
+    Eigen::VectorXd reference_angles_;
+    Eigen::VectorXd reference_velocities_;
+    Eigen::VectorXd reference_accelerations_;
+    Eigen::VectorXd feedforward_torques_;
+
+    // Minimum-time trajectory to the target (JOINT_SPACE_TRAJECTORY mode).
+    JointTrajectory trajectory_;
+    // Whether the trajectory still has to be planned from the current angles.
+    bool trajectory_pending_;
+    // Time since the start of the trajectory.
+    double trajectory_elapsed_;
+
+    // Task space control (TASK_SPACE mode).
+    // Target end-effector frame.
+    KDL::Frame target_frame_;
+    // Number of controlled task dimensions (3 for position, 6 for the full pose).
+    int task_dims_;
+    // Damping of the least-squares solution.
+    double task_space_damping_;
+    // Maximum joint-space step towards the target per update.
+    double task_space_max_step_;
+    // Norm of the latest task-space error.
+    double task_error_norm_;
+    // Solvers and temporary storage for the kinematics and dynamics.
+    boost::shared_ptr<KDL::ChainFkSolverPos> fk_solver_;
+    boost::shared_ptr<KDL::ChainJntToJacSolver> jac_solver_;
+    boost::shared_ptr<KDL::ChainDynParam> dyn_solver_;
+    KDL::JntArray temp_joint_array_;
+    KDL::Jacobian temp_kdl_jacobian_;
+    KDL::JntSpaceInertiaMatrix temp_mass_matrix_;
+    KDL::Frame temp_frame_;
+    // Fixed-size task-space system; uncontrolled dimensions are zeroed so the realtime loop never allocates.
+    Eigen::Matrix<double,6,Eigen::Dynamic> task_jacobian_;
+    Eigen::Matrix<double,6,1> task_error_;
+    Eigen::Matrix<double,6,6> task_gram_;
+    Eigen::LDLT<Eigen::Matrix<double,6,6> > task_solver_;
+
+    // Compute the joint target for the next update by damped least squares.
+    void update_task_space_target(RobotPlugin *plugin);
+    // Compute the trajectory reference and feedforward torques.
+    void update_trajectory_reference(RobotPlugin *plugin, ros::Time current_time);
 
     //Eigen::VectorXd torques_;
 
@@ -54,6 +116,8 @@ private:
     // Time of last update.
     ros::Time last_update_time_;
 public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
     // Constructor.
     PositionController(ros::NodeHandle& n, gps::ActuatorType arm, int size);
     // Destructor.
@@ -61,7 +125,7 @@ public:
     // Update the controller (take an action).
     virtual void update(RobotPlugin *plugin, ros::Time current_time, boost::scoped_ptr<Sample>& sample, Eigen::VectorXd &torques);
     // Configure the controller.
-    virtual void configure_controller(OptionsMap &options);
+    void configure(const PositionControllerConfig &config);
     // Check if controller is finished with its current task.
     virtual bool is_finished() const;
     // Reset the controller -- this is typically called when the controller is turned on.
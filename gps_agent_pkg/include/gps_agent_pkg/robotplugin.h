@@ -9,11 +9,13 @@ with the robot.
 #include <Eigen/Dense>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/atomic.hpp>
 #include <ros/ros.h>
 #include <std_msgs/Empty.h>
 #include <kdl/chain.hpp>
 #include <kdl/chainjnttojacsolver.hpp>
 #include <kdl/chainfksolverpos_recursive.hpp>
+#include <kdl/chaindynparam.hpp>
 #include <realtime_tools/realtime_publisher.h>
 
 #include "gps_agent_pkg/PositionCommand.h"
@@ -24,9 +26,14 @@ with the robot.
 #include "gps_agent_pkg/TfActionCommand.h"
 #include "gps_agent_pkg/TfObsData.h"
 #include "gps_agent_pkg/TfParams.h"
+#include "gps_agent_pkg/ControllerParams.h"
 #include "gps_agent_pkg/sensor.h"
+#include "gps_agent_pkg/sensorworkerpool.h"
+#include "gps_agent_pkg/shmtransport.h"
+#include "gps_agent_pkg/shadowevaluator.h"
 #include "gps_agent_pkg/controller.h"
 #include "gps_agent_pkg/positioncontroller.h"
+#include "gps_agent_pkg/trialcontroller.h"
 #include "gps/proto/gps.pb.h"
 
 // Convenience defines.
@@ -36,6 +43,15 @@ with the robot.
 namespace gps_control
 {
 
+// Who owns the sensors: the realtime thread uses them while they are active,
+// and configure_sensors may only resize them once they are released.
+enum SensorOwnership
+{
+    SensorsReleased = 0,     // Not in use by the realtime thread.
+    SensorsActive,           // Updated by the realtime thread.
+    SensorsReleaseRequested  // configure_sensors waits for the jobs to drain.
+};
+
 // Forward declarations.
 // Controllers.
 class PositionController;
@@ -65,6 +81,14 @@ protected:
     boost::scoped_ptr<PositionController> active_arm_controller_;
     // Current trial controller (if any).
     boost::scoped_ptr<TrialController> trial_controller_;
+    // Shadow controllers evaluated alongside the trial controller (if any).
+    boost::scoped_ptr<ShadowEvaluator> shadow_evaluator_;
+    // Evaluator of the last trial, handed over by the realtime thread so that
+    // the ROS thread waits for its worker and destroys it. The flag tells
+    // which thread owns it: set by the realtime thread once it is handed over,
+    // and cleared by the ROS thread once it is destroyed.
+    boost::scoped_ptr<ShadowEvaluator> retired_shadow_evaluator_;
+    boost::atomic<bool> shadow_evaluator_retired_;
     // Sensor data for the current time step.
     boost::scoped_ptr<Sample> current_time_step_sample_;
     // Auxiliary Sensor data for the current time step.
@@ -79,6 +103,8 @@ protected:
     boost::shared_ptr<KDL::ChainFkSolverPos> passive_arm_fk_solver_, active_arm_fk_solver_;
     // KDL solvers for end-effector Jacobians.
     boost::shared_ptr<KDL::ChainJntToJacSolver> passive_arm_jac_solver_, active_arm_jac_solver_;
+    // KDL solvers for the joint-space inertia (optional, used for feedforward).
+    boost::shared_ptr<KDL::ChainDynParam> passive_arm_dyn_solver_, active_arm_dyn_solver_;
     // Subscribers.
     // Subscriber for position control commands.
     ros::Subscriber position_subscriber_;
@@ -96,14 +122,28 @@ protected:
     bool trial_data_request_waiting_;
     // Is a auxiliary data request pending?
     bool aux_data_request_waiting_;
-    // Are the sensors initialized?
-    bool sensors_initialized_;
+    // Who owns the sensors. configure_sensors asks the realtime thread to drain
+    // the asynchronous sensor jobs and release the sensors, and may withdraw
+    // the request if the realtime loop does not answer.
+    boost::atomic<int> sensor_ownership_;
     // Is everything initialized for the trial controller?
     bool controller_initialized_;
     //tf publisher
     ros_publisher_ptr(gps_agent_pkg::TfObsData) tf_publisher_;
     //tf action subscriber
     ros::Subscriber action_subscriber_tf_;
+    // Optional shared-memory transport for the tf controller (used instead of the tf topics).
+    boost::scoped_ptr<ShmTransport> shm_transport_;
+    // Preallocated storage for action chunks read from shared memory (dU x longest chunk).
+    Eigen::MatrixXd shm_action_commands_;
+    // Preallocated per-sensor stale mask and input delay written to the samples.
+    Eigen::VectorXd sensor_stale_, sensor_delay_;
+    Eigen::VectorXd aux_sensor_stale_, aux_sensor_delay_;
+    // Asynchronous jobs, one per sensor (NULL for sensors that run inline).
+    std::vector<boost::shared_ptr<SensorJob> > sensor_jobs_;
+    std::vector<boost::shared_ptr<SensorJob> > aux_sensor_jobs_;
+    // Worker pool for asynchronous sensors (declared last so that it is destroyed first).
+    boost::scoped_ptr<SensorWorkerPool> sensor_worker_pool_;
 public:
     // Constructor (this should do nothing).
     RobotPlugin();
@@ -117,11 +157,19 @@ public:
     virtual void initialize_position_controllers(ros::NodeHandle& n);
     // Initialize all of the sensors (this also includes FK computation objects).
     virtual void initialize_sensors(ros::NodeHandle& n);
+    // Create the jobs and worker pool for the sensors that run asynchronously.
+    virtual void initialize_sensor_jobs(ros::NodeHandle& n);
     // TODO: Comment
     virtual void initialize_sample(boost::scoped_ptr<Sample>& sample, gps::ActuatorType actuator_type);
 
     //Helper method to configure all sensors
-    virtual void configure_sensors(OptionsMap &opts);
+    virtual bool configure_sensors(const SensorConfig &config);
+
+    // Set the format of the per-sensor stale mask and input delay on a sample.
+    virtual void set_sensor_status_format(int num_sensors, boost::scoped_ptr<Sample>& sample);
+    // Write the stale mask and input delay of the sensors into a sample.
+    virtual void set_sensor_status_data(const std::vector<boost::shared_ptr<Sensor> > &sensors, Eigen::VectorXd &stale, Eigen::VectorXd &delay,
+                                        boost::scoped_ptr<Sample>& sample, int t, ros::Time current_time);
 
     // Report publishers
     // Publish a sample with data from up to T timesteps
@@ -132,6 +180,8 @@ public:
     virtual void position_subscriber_callback(const gps_agent_pkg::PositionCommand::ConstPtr& msg);
     // Trial command callback.
     virtual void trial_subscriber_callback(const gps_agent_pkg::TrialCommand::ConstPtr& msg);
+    // Create and configure a trial controller (NULL if the type is unknown).
+    virtual TrialController *create_trial_controller(const gps_agent_pkg::ControllerParams &params, const TrialControllerConfig &trial, double frequency);
     virtual void test_callback(const std_msgs::Empty::ConstPtr& msg);
     // Relax command callback.
     virtual void relax_subscriber_callback(const gps_agent_pkg::RelaxCommand::ConstPtr& msg);
@@ -143,6 +193,17 @@ public:
     // Update functions.
     // Update the sensors at each time step.
     virtual void update_sensors(ros::Time current_time, bool is_controller_step);
+    // Check whether a sensor is due for an update on this tick.
+    virtual bool is_sensor_due(const boost::shared_ptr<Sensor> &sensor, bool is_controller_step) const;
+    // Log the rate and expected cost of each sensor.
+    virtual void log_sensor_schedule(const std::vector<boost::shared_ptr<Sensor> > &sensors) const;
+    // Merge the result of an asynchronous sensor job and submit its next snapshot.
+    virtual void merge_sensor_job(SensorJob &job, ros::Time current_time);
+    // Drop the results of finished asynchronous sensor jobs. Returns true once
+    // no job is in flight (realtime thread, never blocks).
+    virtual bool flush_sensor_jobs();
+    // Log and clear the deadlines missed by asynchronous sensors.
+    virtual void report_missed_deadlines();
     // Update the controllers at each time step.
     virtual void update_controllers(ros::Time current_time, bool is_controller_step);
     // Accessors.
@@ -152,12 +213,19 @@ public:
     virtual Sensor *get_sensor(SensorType sensor, gps::ActuatorType actuator_type);
     // Get current encoder readings (robot-dependent).
     virtual void get_joint_encoder_readings(Eigen::VectorXd &angles, gps::ActuatorType arm) const = 0;
+    // Check whether the sensors of an arm must refresh its state between
+    // controller steps (the trial controller acts on every tick).
+    virtual bool needs_tick_state(gps::ActuatorType arm) const;
     // Get forward kinematics solver.
     virtual void get_fk_solver(boost::shared_ptr<KDL::ChainFkSolverPos> &fk_solver, boost::shared_ptr<KDL::ChainJntToJacSolver> &jac_solver, gps::ActuatorType arm);
+    // Get dynamics solver (NULL if the robot does not provide one).
+    virtual boost::shared_ptr<KDL::ChainDynParam> get_dyn_solver(gps::ActuatorType arm);
 
     //tf controller commands.
     //tf publish observation command.
-    virtual void tf_publish_obs(Eigen::VectorXd obs);
+    virtual void tf_publish_obs(int t, Eigen::VectorXd obs);
+    //tf poll the shared-memory transport for new actions.
+    virtual void tf_poll_shm_actions();
 
 };
 
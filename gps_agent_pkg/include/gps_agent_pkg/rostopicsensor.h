@@ -23,6 +23,8 @@ namespace gps_control
 	// Vector dimension
 	int data_size_;
 	std::string topic_name_;
+	// Set by the subscriber callback, cleared by update.
+	volatile bool new_data_;
     public:
 	// Constructor.
 	ROSTopicSensor(ros::NodeHandle& n, RobotPlugin *plugin);
@@ -31,8 +33,12 @@ namespace gps_control
 	// Update the sensor (called every tick).
 	virtual void update(RobotPlugin *plugin, ros::Time current_time, bool is_controller_step);
 	void update_data_vector(const std_msgs::Float64MultiArray::ConstPtr& msg);
+	// Only update when the subscriber received a new message.
+	virtual SensorUpdateRate get_update_rate() const;
+	// Check whether a new message arrived since the last update.
+	virtual bool has_new_data() const;
 	// Configure the sensor (for sensor-specific trial settings).
-	virtual void configure_sensor(OptionsMap &options);
+	virtual void configure_sensor(const SensorConfig &config);
 	// Set data format and meta data on the provided sample.
 	virtual void set_sample_data_format(boost::scoped_ptr<Sample>& sample);
 	// Set data on the provided sample.
@@ -69,6 +69,8 @@ public:
     virtual void set_meta_data(gps::SampleType type, int data_size, SampleDataFormat data_format, OptionsMap meta_data_);
     // Set sensor meta-data. Note that this resizes any fields that don't match the current format and deletes their data!
     virtual void set_meta_data(gps::SampleType type, int data_size_rows, int data_size_cols, SampleDataFormat data_format, OptionsMap meta_data_);
+    // Clear the meta-data of a type, so that it is no longer reported.
+    virtual void clear_meta_data(gps::SampleType type);
     // Get datatypes which have metadata set
     virtual void get_available_dtypes(std::vector<gps::SampleType> &types);
 
@@ -5,8 +5,11 @@ anything that produces state (X) or observation (phi) information.
 #pragma once
 
 // Headers.
+#include <map>
+#include <Eigen/Dense>
 #include <ros/ros.h>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 
 // This header defines the main enum that lists the available sensors, which
 // is also used by the state assembler.
@@ -14,6 +17,7 @@ anything that produces state (X) or observation (phi) information.
 
 // This header contains additional defines for communicating with the sample object.
 #include "gps_agent_pkg/sample.h"
+#include "gps_agent_pkg/sensordecimator.h"
 
 namespace gps_control
 {
@@ -28,6 +32,36 @@ enum SensorType
     TotalSensorTypes
 };
 
+// How often a sensor needs to be updated by the robot plugin.
+enum SensorUpdateRate
+{
+    // Every realtime tick (for example, encoders that feed a filter).
+    SensorUpdateEveryTick = 0,
+    // Only on ticks that coincide with a controller step.
+    SensorUpdateControllerStep,
+    // Only when new data has arrived (for example, from a subscriber).
+    SensorUpdateNewData
+};
+
+// Where a sensor computes its derived outputs.
+enum SensorExecutionMode
+{
+    // Everything is computed in update on the realtime thread.
+    SensorExecutionInline = 0,
+    // Raw inputs are captured on the realtime thread and processed by a worker;
+    // the result is merged at the next controller step.
+    SensorExecutionAsync
+};
+
+// Trial settings passed to every sensor.
+struct SensorConfig
+{
+    // End-effector points (one row per point, in the end-effector frame).
+    Eigen::MatrixXd ee_sites;
+    // End-effector point targets (one row per point).
+    Eigen::MatrixXd ee_points_tgt;
+};
+
 // Forward declarations.
 class Sample;
 class RobotPlugin;
@@ -37,6 +71,19 @@ class Sensor
 protected:
     // Current sensor update delay, in seconds (should match controller step length).
     double sensor_step_length_;
+    // Whether the latest asynchronous result missed its deadline.
+    bool is_stale_;
+    // Decimation stages attached to high-rate data types.
+    std::map<gps::SampleType, boost::shared_ptr<SensorDecimator> > decimators_;
+
+    // Attach a decimation stage to a data type (takes ownership).
+    void attach_decimator(gps::SampleType type, SensorDecimator *decimator);
+    // Feed a raw reading of a data type into its decimation stage (called at the native rate).
+    void push_decimated(gps::SampleType type, const double *data);
+    // Set data format and meta data for all decimated data types.
+    void set_decimated_sample_data_format(boost::scoped_ptr<Sample>& sample);
+    // Write the filtered value of all decimated data types into the sample.
+    void set_decimated_sample_data(boost::scoped_ptr<Sample>& sample, int t);
 public:
     // Factory function.
     static Sensor* create_sensor(SensorType type, ros::NodeHandle& n, RobotPlugin *plugin, gps::ActuatorType);
@@ -53,8 +100,29 @@ public:
     virtual void update(RobotPlugin *plugin, ros::Time current_time, bool is_controller_step);
     // Set Sensor update delay.
     virtual void set_update(double new_sensor_step_length);
+    // Get the rate at which this sensor needs to be updated.
+    virtual SensorUpdateRate get_update_rate() const;
+    // Get the expected cost of one update, in seconds (used to budget the realtime tick).
+    virtual double get_update_cost() const;
+    // Check whether new data has arrived since the last update (for SensorUpdateNewData sensors).
+    virtual bool has_new_data() const;
+    // Get the execution mode of this sensor.
+    virtual SensorExecutionMode get_execution_mode() const;
+    // Capture the raw inputs for asynchronous processing (realtime thread, must not block or allocate).
+    virtual void capture_snapshot(RobotPlugin *plugin, ros::Time current_time);
+    // Compute the derived outputs from the captured inputs (worker thread).
+    virtual void process_snapshot();
+    // Make the processed outputs visible to set_sample_data (realtime thread).
+    virtual void commit_snapshot();
+    // Flag the sensor data as stale (or fresh).
+    virtual void set_stale(bool is_stale);
+    // Check whether the sensor data is stale.
+    virtual bool is_stale() const;
+    // Get the time at which the inputs behind the sensor data were captured
+    // (current_time for sensors whose data is always up to date).
+    virtual ros::Time get_data_time(ros::Time current_time) const;
     // Configure the Sensor (for Sensor-specific trial settings).
-    virtual void configure_sensor(OptionsMap &options);
+    virtual void configure_sensor(const SensorConfig &config);
     // Set data format and meta data on the provided sample.
     virtual void set_sample_data_format(boost::scoped_ptr<Sample>& sample);
     // Set data on the provided sample.
@@ -0,0 +1,106 @@
+/*
+Decimation stage for high-rate sensor streams. A sensor feeds every raw
+reading of a data type into the stage at its native rate, and only the
+filtered value at the controller step is written into the sample, so fast
+signals (force/torque, accelerometers) are low-pass filtered instead of being
+aliased into the state.
+*/
+#pragma once
+
+// Headers.
+#include <Eigen/Dense>
+
+namespace gps_control
+{
+
+// List of decimation filter types.
+enum SensorDecimatorType
+{
+    // Linear-phase FIR low-pass, only evaluated when the output is read.
+    FIRDecimatorType = 0,
+    // Butterworth low-pass as a cascade of biquad sections.
+    IIRDecimatorType
+};
+
+class SensorDecimator
+{
+protected:
+    // Number of channels in the data type.
+    int num_channels_;
+    // Preallocated filter output.
+    Eigen::VectorXd output_;
+public:
+    // Factory function. Designs a low-pass with its cutoff at the Nyquist
+    // frequency of the output rate.
+    static SensorDecimator* create_decimator(SensorDecimatorType type, int num_channels, double input_rate, double output_rate);
+    // Constructor.
+    SensorDecimator(int num_channels);
+    // Destructor.
+    virtual ~SensorDecimator();
+    // Reset the filter to a steady state at the given value.
+    virtual void reset(const Eigen::VectorXd &value) = 0;
+    // Add one raw reading (num_channels values, called at the input rate).
+    virtual void push(const double *data) = 0;
+    // Get the filtered value at the current time.
+    virtual const Eigen::VectorXd &get_output() = 0;
+    // Get the number of channels.
+    int get_num_channels() const;
+};
+
+// FIR decimator. Readings are stored in a ring buffer that is written twice,
+// so the latest num_taps readings are always one contiguous block and the
+// output is a single matrix-vector product across all channels. The output is
+// only computed when it is read, i.e. one polyphase branch per output sample.
+class FIRDecimator : public SensorDecimator
+{
+private:
+    // Filter taps, reversed so that they line up with the oldest reading first.
+    Eigen::VectorXd reversed_taps_;
+    // Readings, channels x (2 * num_taps).
+    Eigen::MatrixXd history_;
+    // Index of the oldest reading in the ring.
+    int head_;
+public:
+    // Constructor.
+    FIRDecimator(int num_channels, const Eigen::VectorXd &taps);
+    // Destructor.
+    virtual ~FIRDecimator();
+    // Reset the filter to a steady state at the given value.
+    virtual void reset(const Eigen::VectorXd &value);
+    // Add one raw reading.
+    virtual void push(const double *data);
+    // Get the filtered value at the current time.
+    virtual const Eigen::VectorXd &get_output();
+    // Design a windowed-sinc (Hamming) low-pass with unit DC gain. The cutoff is
+    // a fraction of the input sample rate.
+    static Eigen::VectorXd design_lowpass(int num_taps, double cutoff);
+};
+
+// IIR decimator. Each biquad section runs in transposed direct form II with
+// the state of all channels updated as one vector operation per reading.
+class IIRDecimator : public SensorDecimator
+{
+private:
+    // Sections, one row per biquad: b0 b1 b2 a1 a2 (a0 normalized to 1).
+    Eigen::MatrixXd sections_;
+    // Filter state, channels x (2 * num_sections).
+    Eigen::ArrayXXd state_;
+    // Temporary storage for the section input.
+    Eigen::ArrayXd section_input_;
+public:
+    // Constructor.
+    IIRDecimator(int num_channels, const Eigen::MatrixXd &sections);
+    // Destructor.
+    virtual ~IIRDecimator();
+    // Reset the filter to a steady state at the given value.
+    virtual void reset(const Eigen::VectorXd &value);
+    // Add one raw reading.
+    virtual void push(const double *data);
+    // Get the filtered value at the current time.
+    virtual const Eigen::VectorXd &get_output();
+    // Design an even-order Butterworth low-pass as biquad sections. The cutoff
+    // is a fraction of the input sample rate.
+    static Eigen::MatrixXd design_lowpass(int order, double cutoff);
+};
+
+}
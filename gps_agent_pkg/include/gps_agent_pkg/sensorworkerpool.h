@@ -0,0 +1,69 @@
+/*
+Worker pool for asynchronous sensors. The realtime thread captures a sensor's
+raw inputs and submits a job through a lock-free queue; a worker thread then
+computes the derived outputs. The realtime thread checks whether the job is
+done at the next controller step and either merges the result or flags the
+sensor as stale.
+*/
+#pragma once
+
+// Headers.
+#include <semaphore.h>
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include <boost/lockfree/queue.hpp>
+
+namespace gps_control
+{
+
+// Forward declarations.
+class Sensor;
+
+// One asynchronous sensor job. Only the done flag is shared with the worker;
+// everything else is owned by the realtime thread.
+struct SensorJob
+{
+    // Sensor that processes the snapshot.
+    Sensor *sensor;
+    // Set by the worker once the snapshot has been processed.
+    boost::atomic<bool> done;
+    // Whether the job has been submitted and not yet collected.
+    bool in_flight;
+    // Whether the job missed the controller step it was due at.
+    bool missed_deadline;
+    // Number of deadlines missed since the counter was last cleared.
+    int missed_deadlines;
+
+    // Constructor.
+    SensorJob(Sensor *job_sensor);
+    // Destructor.
+    virtual ~SensorJob();
+    // Process the snapshot (called by the worker). Other asynchronous work can override this.
+    virtual void process();
+};
+
+class SensorWorkerPool
+{
+private:
+    // Submitted jobs waiting for a worker.
+    boost::lockfree::queue<SensorJob*> jobs_;
+    // Counts queued jobs so that idle workers can sleep.
+    sem_t jobs_available_;
+    // Cleared to shut the workers down.
+    boost::atomic<bool> running_;
+    // Worker threads.
+    boost::thread_group workers_;
+    int num_workers_;
+
+    // Worker thread main loop.
+    void worker_loop();
+public:
+    // Constructor. Capacity is the maximum number of jobs in flight.
+    SensorWorkerPool(int num_workers, int capacity);
+    // Destructor. Stops and joins the workers.
+    virtual ~SensorWorkerPool();
+    // Submit a job (realtime safe: never blocks or allocates). Returns false if the queue is full.
+    bool submit(SensorJob *job);
+};
+
+}
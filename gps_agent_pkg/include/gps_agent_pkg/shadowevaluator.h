@@ -0,0 +1,90 @@
+/*
+Evaluates extra "shadow" controllers on the states visited by a trial. The
+shadow controllers never act on the robot; at every controller step they get
+the same state and observation as the trial controller, and their actions are
+logged under SHADOW_ACTIONS (the actions of all shadow controllers, one after
+the other). Expensive shadow controllers can run on a worker thread, in which
+case the actions for a step are written at the next controller step, and steps
+the worker could not keep up with are filled with NaN.
+*/
+#pragma once
+
+// Headers.
+#include <vector>
+#include <Eigen/Dense>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "gps_agent_pkg/sensorworkerpool.h"
+#include "gps_agent_pkg/trialcontroller.h"
+#include "gps/proto/gps.pb.h"
+
+namespace gps_control
+{
+
+// Forward declarations.
+class Sample;
+class ShadowEvaluator;
+
+// Worker job that evaluates the shadow controllers on a snapshot.
+struct ShadowJob : public SensorJob
+{
+    ShadowEvaluator *evaluator;
+
+    // Constructor.
+    ShadowJob(ShadowEvaluator *job_evaluator);
+    // Evaluate the shadow controllers.
+    virtual void process();
+};
+
+class ShadowEvaluator
+{
+private:
+    // Shadow controllers.
+    std::vector<boost::shared_ptr<TrialController> > controllers_;
+    // State and obs datatypes.
+    std::vector<gps::SampleType> state_datatypes_;
+    std::vector<gps::SampleType> obs_datatypes_;
+    // Action dimension of each controller.
+    int dU_;
+    // Snapshot of the state and observation, and the step they belong to.
+    Eigen::VectorXd X_;
+    Eigen::VectorXd obs_;
+    int step_;
+    // Actions of all shadow controllers, and storage for one controller's action.
+    Eigen::VectorXd actions_;
+    Eigen::VectorXd controller_action_;
+    // Written for steps that were not evaluated.
+    Eigen::VectorXd missed_actions_;
+    // Asynchronous evaluation (NULL worker for inline evaluation).
+    ShadowJob job_;
+    boost::scoped_ptr<SensorWorkerPool> worker_;
+    // Steps skipped because the previous evaluation was still running.
+    int missed_steps_;
+
+    // Write the actions of the evaluated step into the sample.
+    void write_actions(boost::scoped_ptr<Sample>& sample);
+    // Mark step t as not evaluated in the sample.
+    void write_missed_step(int t, boost::scoped_ptr<Sample>& sample);
+public:
+    // Constructor. The controllers must be configured already.
+    ShadowEvaluator(const std::vector<boost::shared_ptr<TrialController> > &controllers,
+                    const std::vector<gps::SampleType> &state_datatypes,
+                    const std::vector<gps::SampleType> &obs_datatypes, int dU, bool async);
+    // Destructor. Waits for an in-flight evaluation, so it must not run on the
+    // realtime thread.
+    virtual ~ShadowEvaluator();
+    // Set the SHADOW_ACTIONS data format on the sample.
+    void set_sample_data_format(boost::scoped_ptr<Sample>& sample);
+    // Evaluate the shadow controllers on the state and observation of step t (called on controller steps).
+    void evaluate(int t, boost::scoped_ptr<Sample>& sample);
+    // Write the actions of the last evaluation if it is done, or mark its step
+    // as missed (called at the end of the trial, never blocks).
+    void finish(boost::scoped_ptr<Sample>& sample);
+    // Evaluate all shadow controllers on the snapshot.
+    void compute();
+    // Number of steps skipped or given up because the worker was still busy.
+    int get_missed_steps() const;
+};
+
+}
@@ -0,0 +1,78 @@
+/*
+Shared-memory transport for observations and actions between the robot plugin
+and a policy process on the same machine (python/gps/agent/ros/shm_transport.py).
+
+The segment holds a fixed header followed by one observation buffer and one
+action buffer. Each buffer is guarded by a sequence counter used as a seqlock:
+the writer makes it odd, writes the payload and makes it even again, and the
+reader retries if the counter changed while it copied (the python side has no
+fences and relies on x86 memory ordering for this). The plugin wakes the
+policy process with a futex on the observation counter; the plugin itself never
+blocks and only polls the action counter on controller steps.
+*/
+#pragma once
+
+// Headers.
+#include <stdint.h>
+#include <string>
+#include <Eigen/Dense>
+
+namespace gps_control
+{
+
+#define SHM_TRANSPORT_MAGIC 0x4d535047 // "GPSM"
+#define SHM_TRANSPORT_VERSION 1
+
+// Segment header. Layout is shared with shm_transport.py; keep both in sync.
+struct ShmTransportHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    // Maximum number of observation and action entries.
+    uint32_t obs_capacity;
+    uint32_t action_capacity;
+    // Observation seqlock counter, also the futex word the policy waits on.
+    uint32_t obs_seq;
+    int32_t obs_step;
+    uint32_t obs_size;
+    uint32_t reserved0;
+    // Action seqlock counter.
+    uint32_t action_seq;
+    int32_t action_id;
+    int32_t action_obs_step;
+    int32_t action_start_step;
+    int32_t action_dU;
+    int32_t action_horizon;
+    uint32_t reserved1[2];
+};
+
+class ShmTransport
+{
+private:
+    std::string name_;
+    ShmTransportHeader *header_;
+    double *obs_data_;
+    double *action_data_;
+    size_t segment_size_;
+    // Last action sequence number that was read.
+    uint32_t last_action_seq_;
+public:
+    // Constructor. Creates (or reuses) the shared-memory segment /name.
+    ShmTransport(const std::string &name, int obs_capacity, int action_capacity);
+    // Destructor. Unmaps and unlinks the segment.
+    virtual ~ShmTransport();
+    // Check whether the segment was created successfully.
+    bool is_open() const;
+    // Write an observation and wake the policy process (realtime safe).
+    void write_obs(int step, const Eigen::VectorXd &obs);
+    // Get the maximum number of action entries (dU times the chunk length).
+    int get_action_capacity() const;
+    // Read a new action chunk into the first horizon columns of the
+    // preallocated commands matrix (one column per step). Chunks whose dU does
+    // not match its rows or that have more steps than it has columns are
+    // dropped. Returns false if there is no new, consistent chunk. Realtime
+    // safe: commands is never resized.
+    bool read_actions(int &id, int &obs_step, int &start_step, int &horizon, Eigen::MatrixXd &commands);
+};
+
+}
@@ -1,20 +1,68 @@
 /*
 Controller that executes a trial using a neural network policy using tf.
+
+The policy runs in a remote process, so its actions arrive with a delay. Each
+action command carries a chunk of actions for consecutive steps, starting at
+start_step, computed from the observation published at obs_step. The chunks
+are written into a preallocated ring indexed by step, and every controller
+step picks the action scheduled for it. If no action was scheduled, the last
+action is held and the step is counted as stale.
 */
 #pragma once
 
 // Headers.
 #include <vector>
 #include <Eigen/Dense>
+#include <boost/thread/mutex.hpp>
 
 // Superclass.
 #include "gps_agent_pkg/trialcontroller.h"
 
 namespace gps_control
 {
+    // Settings of a tf controller.
+    struct TfControllerConfig : public TrialControllerConfig
+    {
+        int dU;
+        // Number of future steps the action ring holds (0 for the default).
+        int action_capacity;
+        // Consecutive stale steps before an error is logged (0 for the default).
+        int max_stale_steps;
+    };
 
     class TfController : public TrialController
     {
+    private:
+        // Ring of future actions, one column per step (slot = step % capacity).
+        Eigen::MatrixXd action_ring_;
+        // Step each ring slot holds an action for (-1 if empty).
+        std::vector<int> ring_steps_;
+        // Observation step each ring slot's action was computed from.
+        std::vector<int> ring_obs_steps_;
+        // Protects the ring; the controller only ever try-locks it.
+        boost::mutex ring_mutex_;
+        // Number of consecutive stale steps after which an error is logged.
+        int max_stale_steps_;
+        // Current run of consecutive stale steps.
+        int stale_streak_;
+
+        // Statistics, reported at the end of the trial.
+        // Steps that used a fresh action.
+        int fresh_steps_;
+        // Steps that held the previous action.
+        int stale_steps_;
+        // Longest run of consecutive stale steps.
+        int max_stale_streak_;
+        // Actions that arrived after the step they were scheduled for.
+        int late_actions_;
+        // Steps where the ring was locked by the subscriber.
+        int contended_steps_;
+        // Sum and maximum of the age (in steps) of the observation behind each fresh action.
+        int total_action_age_;
+        int max_action_age_;
+
+        // Reset ring and statistics.
+        void reset_actions();
 
     public:
         // Constructor.
@@ -24,13 +72,15 @@ namespace gps_control
         // Compute the action at the current time step.
         virtual void get_action(int t, const Eigen::VectorXd &X, const Eigen::VectorXd &obs, Eigen::VectorXd &U);
         // Configure the controller.
-        virtual void configure_controller(OptionsMap &options);
+        void configure(const TfControllerConfig &config);
         // receive new actions from subscriber.
-        virtual void update_action_command(int id, const Eigen::VectorXd &command);
+        virtual void update_action_command(int id, int obs_step, int start_step, const Eigen::Ref<const Eigen::MatrixXd> &commands);
         //publish the observations as we use them to act.
-        virtual void publish_obs(Eigen::VectorXd obs, RobotPlugin *plugin);
+        virtual void publish_obs(int t, Eigen::VectorXd obs, RobotPlugin *plugin);
+        // Log the deadline and staleness counters.
+        virtual void report_statistics();
 
-        int last_command_id_received, last_command_id_acted_upon, failed_attempts;
+        int last_command_id_received;
         Eigen::VectorXd last_action_command_received;
     };
 
@@ -17,6 +17,17 @@ a subclass.
 namespace gps_control
 {
 
+// Settings shared by all trial controllers. Each controller extends this
+// with its own typed settings, filled directly from the ROS messages.
+struct TrialControllerConfig
+{
+    // Trial length.
+    int T;
+    // State and obs datatypes.
+    std::vector<gps::SampleType> state_datatypes;
+    std::vector<gps::SampleType> obs_datatypes;
+};
+
 class TrialController : public Controller
 {
 private:
@@ -36,6 +47,8 @@ private:
     std::vector<gps::SampleType> obs_datatypes_;
     // end effector target (subtracted before control is computed)
     Eigen::VectorXd ee_tgt_;
+    // Preallocated state for updates between controller steps.
+    Eigen::VectorXd tick_state_;
 
 protected:
     bool is_configured_;
@@ -49,8 +62,14 @@ public:
     virtual void get_action(int t, const Eigen::VectorXd &X, const Eigen::VectorXd &obs, Eigen::VectorXd &U) = 0;
     // Update the controller (take an action).
     virtual void update(RobotPlugin *plugin, ros::Time current_time, boost::scoped_ptr<Sample>& sample, Eigen::VectorXd &torques);
-    // Configure the controller.
-    virtual void configure_controller(OptionsMap &options);
+    // Update the torques between controller steps from the freshest state (if updates_every_tick).
+    virtual void update_tick(RobotPlugin *plugin, ros::Time current_time, boost::scoped_ptr<Sample>& sample, Eigen::VectorXd &torques);
+    // Compute the action between controller steps t and t+1, elapsed seconds after step t.
+    virtual void get_tick_action(int t, double elapsed, const Eigen::VectorXd &X, Eigen::VectorXd &U);
+    // Check whether the controller also acts between controller steps.
+    virtual bool updates_every_tick() const;
+    // Configure the settings shared by all trial controllers.
+    void configure(const TrialControllerConfig &config);
     // Check if controller is finished with its current task.
     virtual bool is_finished() const;
     // Return trial step index
@@ -59,10 +78,13 @@ public:
     virtual int get_trial_length();
     // Called when controller is turned on
     virtual void reset(ros::Time update_time);
-    //for tf controller to update actions.
-    virtual void update_action_command(int id, const Eigen::VectorXd &command);
+    //for tf controller to update actions (one column per step, starting at start_step).
+    //Takes a reference so that a block of a preallocated buffer is passed without a copy.
+    virtual void update_action_command(int id, int obs_step, int start_step, const Eigen::Ref<const Eigen::MatrixXd> &commands);
     //for tf controller obs publishing
-    virtual void publish_obs(Eigen::VectorXd obs, RobotPlugin *plugin);
+    virtual void publish_obs(int t, Eigen::VectorXd obs, RobotPlugin *plugin);
+    // Log controller statistics at the end of the trial.
+    virtual void report_statistics();
 
     const bool is_configured(){
         return is_configured_;
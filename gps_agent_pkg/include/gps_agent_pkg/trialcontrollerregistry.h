@@ -0,0 +1,84 @@
+/*
+Registry of trial controller backends. Each controller registers a factory
+from its own translation unit (with REGISTER_TRIAL_CONTROLLER), under its
+ControllerType and a name. The factory checks the sizes in the controller
+parameters message, unpacks it into the controller's typed config and
+configures the controller, so the plugin can create any registered controller
+without knowing its type.
+*/
+#pragma once
+
+// Headers.
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include <ros/ros.h>
+
+#include "gps_agent_pkg/ControllerParams.h"
+#include "gps_agent_pkg/trialcontroller.h"
+
+// Register a controller factory at static initialization time.
+#define REGISTER_TRIAL_CONTROLLER(type, name, factory) \
+    static bool factory##_registered = gps_control::TrialControllerRegistry::register_controller(type, name, factory)
+
+namespace gps_control
+{
+
+// Creates and configures a controller from its parameters message (NULL if the message is malformed).
+typedef TrialController *(*TrialControllerFactory)(const gps_agent_pkg::ControllerParams &params, const TrialControllerConfig &trial, double frequency);
+
+class TrialControllerRegistry
+{
+public:
+    // Register a factory under a controller type and name. Returns false if either is taken.
+    static bool register_controller(int type, const std::string &name, TrialControllerFactory factory);
+    // Create a controller, looked up by params.backend if it is set and by
+    // params.controller_to_execute otherwise (NULL if nothing is registered).
+    static TrialController *create(const gps_agent_pkg::ControllerParams &params, const TrialControllerConfig &trial, double frequency);
+    // Names of all registered controllers, in registration order.
+    static void get_registered(std::vector<std::string> &names);
+};
+
+// Helpers for the factories.
+// Check that a message field holds the expected number of entries.
+template <typename T>
+bool check_param_size(const std::vector<T> &values, int expected, const char *name)
+{
+    if (values.size() != expected)
+    {
+        ROS_ERROR("Controller parameter %s has %d entries, expected %d", name, (int)values.size(), expected);
+        return false;
+    }
+    return true;
+}
+
+// Unpack consecutive vectors of the given size, one per step.
+template <typename T>
+void unpack_step_vectors(const std::vector<T> &values, int size, int steps, std::vector<Eigen::VectorXd> &vectors)
+{
+    vectors.resize(steps);
+    for (int t = 0; t < steps; t++)
+    {
+        vectors[t].resize(size);
+        for (int i = 0; i < size; i++)
+            vectors[t](i) = values[i+t*size];
+    }
+}
+
+// Check and unpack a column-major dim x dim input scale and its bias.
+template <typename T>
+bool unpack_scale_bias(const std::vector<T> &scale_values, const std::vector<T> &bias_values, int dim,
+                       Eigen::MatrixXd &scale, Eigen::VectorXd &bias)
+{
+    if (!check_param_size(scale_values, dim*dim, "scale") || !check_param_size(bias_values, dim, "bias"))
+        return false;
+    scale.resize(dim, dim);
+    for (int i = 0; i < dim*dim; i++)
+        scale(i) = scale_values[i];
+    bias.resize(dim);
+    for (int i = 0; i < dim; i++)
+        bias(i) = bias_values[i];
+    return true;
+}
+
+}
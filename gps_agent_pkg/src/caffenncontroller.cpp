@@ -3,6 +3,8 @@
 #include "gps_agent_pkg/caffenncontroller.h"
 #include "gps_agent_pkg/robotplugin.h"
 #include "gps_agent_pkg/util.h"
+#include "gps_agent_pkg/trialcontrollerregistry.h"
+#include "gps_agent_pkg/CaffeParams.h"
 
 using namespace gps_control;
 
@@ -26,29 +28,45 @@ void CaffeNNController::get_action(int t, const Eigen::VectorXd &X, const Eigen:
 }
 
 // Configure the controller.
-void CaffeNNController::configure_controller(OptionsMap &options)
+void CaffeNNController::configure(const CaffeNNControllerConfig &config)
 {
     //Call superclass
-    TrialController::configure_controller(options);
-
-    std::string net_param_string = boost::get<string>(options["net_param"]);
+    TrialController::configure(config);
 
     NetParameter net_param;
-    net_param.ParseFromString(net_param_string);
+    net_param.ParseFromString(config.net_param);
 
     // This sets the network and the weights
     net_.reset(new NeuralNetworkCaffe(net_param));
 
-    Eigen::MatrixXd scale = boost::get<Eigen::MatrixXd>(options["scale"]);
-    Eigen::VectorXd bias  = boost::get<Eigen::VectorXd>(options["bias"]);
-    net_->set_scalebias(scale, bias);
-
-    int T = boost::get<int>(options["T"]);
-    noise_.resize(T);
-    for(int i=0; i<T; i++){
-        noise_[i] = boost::get<Eigen::VectorXd>(options["noise_"+to_string(i)]);
-    }
+    net_->set_scalebias(config.scale, config.bias);
+    noise_ = config.noise;
 
     ROS_INFO_STREAM("Set Caffe network parameters");
     is_configured_ = true;
 }
+
+namespace
+{
+
+// Unpack the Caffe network, scale, bias and noise from the parameters message and configure a controller.
+TrialController *create_caffe_controller(const gps_agent_pkg::ControllerParams &params, const TrialControllerConfig &trial, double frequency)
+{
+    const gps_agent_pkg::CaffeParams &caffe = params.caffe;
+    int dU = (int) caffe.dU;
+    CaffeNNControllerConfig config;
+    static_cast<TrialControllerConfig&>(config) = trial;
+    if (!unpack_scale_bias(caffe.scale, caffe.bias, caffe.dim_bias, config.scale, config.bias) ||
+        !check_param_size(caffe.noise, trial.T*dU, "caffe.noise"))
+        return NULL;
+    unpack_step_vectors(caffe.noise, dU, trial.T, config.noise);
+    config.net_param = caffe.net_param;
+
+    CaffeNNController *controller = new CaffeNNController();
+    controller->configure(config);
+    return controller;
+}
+
+}
+
+REGISTER_TRIAL_CONTROLLER(gps::CAFFE_CONTROLLER, "caffe", create_caffe_controller);
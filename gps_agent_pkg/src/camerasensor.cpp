@@ -1,4 +1,9 @@
 #include "gps_agent_pkg/camerasensor.h"
+#include <fstream>
+#include <iterator>
+
+// Set on the middle rgb buffer index while it holds an image the realtime thread has not taken.
+#define RGB_IMAGE_FRESH 4
 
 using namespace gps_control;
 
@@ -27,15 +32,50 @@ CameraSensor::CameraSensor(ros::NodeHandle& n, RobotPlugin *plugin): Sensor(n, p
       image_height_init_ = IMAGE_HEIGHT_INIT;
     image_size_ = image_width_*image_height_;
 
-    // Initialize rgb image.
-    latest_rgb_image_.resize(image_size_*3,0);
+    // Initialize rgb images.
+    for (int i = 0; i < 3; i++)
+    {
+        rgb_images_[i].resize(image_size_*3,0);
+        rgb_times_[i] = ros::Time(0.0);
+    }
+    rgb_back_ = 0;
+    rgb_middle_ = 1;
+    rgb_front_ = 2;
 
     // Initialize depth image.
     latest_depth_image_.resize(image_size_,0);
 
     // Set time.
-    latest_rgb_time_ = ros::Time(0.0);
     latest_depth_time_ = ros::Time(0.0);
+    snapshot_rgb_time_ = ros::Time(0.0);
+    latest_features_time_ = ros::Time(0.0);
+
+    initialize_feature_extractor(n);
+}
+
+// Load the feature extractor named by the image_feature_weights parameter.
+void CameraSensor::initialize_feature_extractor(ros::NodeHandle& n)
+{
+    std::string weights_file;
+    if (!n.getParam("image_feature_weights", weights_file))
+        return;
+
+    std::ifstream file(weights_file.c_str(), std::ios::binary);
+    std::string weights((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::vector<int> strides;
+    n.getParam("image_feature_strides", strides);
+
+    feature_extractor_.reset(new ConvFeatureExtractor());
+    if (!file || !feature_extractor_->load_weights(reinterpret_cast<const uint8_t*>(weights.data()), weights.size(),
+                                                   3, image_height_, image_width_, strides))
+    {
+        ROS_ERROR("Failed to load image feature extractor from %s", weights_file.c_str());
+        feature_extractor_.reset();
+        return;
+    }
+    snapshot_rgb_image_.resize(image_size_*3, 0);
+    snapshot_features_.setZero(feature_extractor_->get_num_features());
+    latest_features_.setZero(feature_extractor_->get_num_features());
 }
 
 // Destructor.
@@ -44,14 +84,11 @@ CameraSensor::~CameraSensor()
     // Nothing to do here.
 }
 
-// Callback from camera sensor. Crops and updates the stored rgb image
+// Callback from camera sensor. Crops the rgb image into the back buffer and publishes it
 void CameraSensor::update_rgb_image(const sensor_msgs::Image::ConstPtr& msg) {
-    latest_rgb_time_ = msg->header.stamp;
-    if (latest_rgb_image_.empty()) {
-        latest_rgb_image_.resize(3*image_size_);
-    } else { // better way to make this assertion? (error message?)
-        assert(latest_rgb_image_.size() == 3*image_size_);
-    }
+    std::vector<uint8_t> &rgb_image = rgb_images_[rgb_back_];
+    rgb_times_[rgb_back_] = msg->header.stamp;
+    assert(rgb_image.size() == 3*image_size_);
     // Check message dimensions.
     assert(msg->width == image_width_init_ && msg->height == image_height_init_);
 
@@ -70,12 +107,21 @@ void CameraSensor::update_rgb_image(const sensor_msgs::Image::ConstPtr& msg) {
                 {
                     for (int c = 0; c < 3; c++)
                     {
-                        latest_rgb_image_[(y-y_start)*image_width_*3 + (x-x_start)*3 + c] = msg->data[y*image_width_init_*3 + x*3 + c];
+                        rgb_image[(y-y_start)*image_width_*3 + (x-x_start)*3 + c] = msg->data[y*image_width_init_*3 + x*3 + c];
                     }
                 }
             }
         }
     }
+    // Publish the image and take back whichever buffer was in the middle.
+    rgb_back_ = rgb_middle_.exchange(rgb_back_ | RGB_IMAGE_FRESH, boost::memory_order_acq_rel) & ~RGB_IMAGE_FRESH;
+}
+
+// Take the latest published rgb image as the front buffer.
+void CameraSensor::acquire_rgb_image()
+{
+    if (rgb_middle_.load(boost::memory_order_relaxed) & RGB_IMAGE_FRESH)
+        rgb_front_ = rgb_middle_.exchange(rgb_front_, boost::memory_order_acq_rel) & ~RGB_IMAGE_FRESH;
 }
 
 // Callback from camera sensor. Crops and updates the stored depth image
@@ -112,18 +158,72 @@ void CameraSensor::update_depth_image(const sensor_msgs::Image::ConstPtr& msg) {
 // Update the sensor (called every tick).
 void CameraSensor::update(RobotPlugin *plugin, ros::Time current_time, bool is_controller_step)
 {
-  // Not needed for camera, since callback function is used.
+    // The image itself is copied in the callback; just take the buffer it was copied into.
+    acquire_rgb_image();
+}
+
+// Only update when a new rgb image arrived.
+SensorUpdateRate CameraSensor::get_update_rate() const
+{
+    return SensorUpdateNewData;
 }
 
-// The settings include the configuration for the Kalman filter.
-void CameraSensor::configure_sensor(const OptionsMap &options)
+// Check whether a new rgb image arrived since the last update.
+bool CameraSensor::has_new_data() const
+{
+    return rgb_middle_.load(boost::memory_order_relaxed) & RGB_IMAGE_FRESH;
+}
+
+// Feature extraction runs asynchronously.
+SensorExecutionMode CameraSensor::get_execution_mode() const
+{
+    return feature_extractor_ ? SensorExecutionAsync : SensorExecutionInline;
+}
+
+// Copy the latest rgb image for the feature extractor.
+void CameraSensor::capture_snapshot(RobotPlugin *plugin, ros::Time current_time)
+{
+    acquire_rgb_image();
+    std::copy(rgb_images_[rgb_front_].begin(), rgb_images_[rgb_front_].end(), snapshot_rgb_image_.begin());
+    snapshot_rgb_time_ = rgb_times_[rgb_front_];
+}
+
+// Run the feature extractor on the captured image.
+void CameraSensor::process_snapshot()
+{
+    feature_extractor_->extract(&snapshot_rgb_image_[0], snapshot_features_);
+}
+
+// Make the extracted features visible to set_sample_data.
+void CameraSensor::commit_snapshot()
+{
+    latest_features_.swap(snapshot_features_);
+    latest_features_time_ = snapshot_rgb_time_;
+}
+
+// Time of the image behind the sample data.
+ros::Time CameraSensor::get_data_time(ros::Time current_time) const
+{
+    return feature_extractor_ ? latest_features_time_ : rgb_times_[rgb_front_];
+}
+
+// Configure the sensor (for sensor-specific trial settings).
+void CameraSensor::configure_sensor(const SensorConfig &config)
 {
     // not used for camera sensor, though maybe in the future for image specs.
 }
 
 // Set data format and meta data on the provided sample.
-void CameraSensor::set_sample_data_format(boost::scoped_ptr<Sample> sample) const
+void CameraSensor::set_sample_data_format(boost::scoped_ptr<Sample>& sample)
 {
+    // With a feature extractor, only the feature points go into the sample.
+    if (feature_extractor_)
+    {
+        OptionsMap feature_metadata;
+        sample->set_meta_data(gps::IMAGE_FEAT,latest_features_.size(),SampleDataFormatEigenVector,feature_metadata);
+        return;
+    }
+
     // Set image size and format.
     OptionsMap rgb_metadata;
     sample->set_meta_data(gps::RGB_IMAGE,image_size_*3,SampleDataFormatUInt8,rgb_metadata);
@@ -134,10 +234,16 @@ void CameraSensor::set_sample_data_format(boost::scoped_ptr<Sample> sample) cons
 }
 
 // Set data on the provided sample.
-void CameraSensor::set_sample_data(boost::scoped_ptr<Sample> sample) const
+void CameraSensor::set_sample_data(boost::scoped_ptr<Sample>& sample, int t)
 {
+    if (feature_extractor_)
+    {
+        sample->set_data_vector(t,gps::IMAGE_FEAT,latest_features_.data(),latest_features_.size(),SampleDataFormatEigenVector);
+        return;
+    }
+
     // Set rgb image.
-    sample->set_data(0,gps::RGB_IMAGE,&latest_rgb_image_[0],latest_rgb_image_.size(),SampleDataFormatUInt8);
+    sample->set_data(0,gps::RGB_IMAGE,&rgb_images_[rgb_front_][0],rgb_images_[rgb_front_].size(),SampleDataFormatUInt8);
 
     // Set depth image.
     sample->set_data(0,gps::DEPTH_IMAGE,&latest_depth_image_[0],latest_depth_image_.size(),SampleDataFormatUInt16);
@@ -16,10 +16,6 @@ Controller::~Controller()
 {
 }
 
-void Controller::configure_controller(OptionsMap &options)
-{
-}
-
 void Controller::set_update_delay(double new_step_length)
 {
 }
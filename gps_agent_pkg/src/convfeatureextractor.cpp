@@ -0,0 +1,160 @@
+#include "gps_agent_pkg/convfeatureextractor.h"
+#include <math.h>
+#include <cmath>
+#include <string.h>
+
+using namespace gps_control;
+
+// Constructor.
+ConvFeatureExtractor::ConvFeatureExtractor()
+{
+    image_channels_ = 0;
+}
+
+// Destructor.
+ConvFeatureExtractor::~ConvFeatureExtractor()
+{
+}
+
+// Load the convolution layers for images of the given size.
+bool ConvFeatureExtractor::load_weights(const uint8_t *data, size_t size, int image_channels, int image_height, int image_width,
+                                        const std::vector<int> &strides)
+{
+    std::vector<DenseLayer> records;
+    if (!NeuralNetworkNative::parse_layers(data, size, records))
+        return false;
+    if (records.empty())
+    {
+        ROS_ERROR("Feature extractor weights have no layers");
+        return false;
+    }
+
+    std::vector<ConvLayer> layers(records.size());
+    int channels = image_channels, height = image_height, width = image_width;
+    for (int l = 0; l < records.size(); l++)
+    {
+        ConvLayer &layer = layers[l];
+        int kernel_area = records[l].weights.cols()/channels;
+        int kernel_size = (int)(sqrt((double)kernel_area) + 0.5);
+        if (kernel_size*kernel_size*channels != records[l].weights.cols())
+        {
+            ROS_ERROR("Convolution layer %d has %d weights per output, which is not a square kernel over %d channels",
+                      l, (int)records[l].weights.cols(), channels);
+            return false;
+        }
+        layer.in_channels = channels;
+        layer.out_channels = records[l].weights.rows();
+        layer.kernel_size = kernel_size;
+        layer.stride = l < strides.size() ? strides[l] : 1;
+        layer.in_height = height;
+        layer.in_width = width;
+        layer.out_height = (height - kernel_size)/layer.stride + 1;
+        layer.out_width = (width - kernel_size)/layer.stride + 1;
+        if (layer.stride < 1 || layer.out_height < 1 || layer.out_width < 1)
+        {
+            ROS_ERROR("Convolution layer %d does not fit its %dx%d input", l, height, width);
+            return false;
+        }
+        layer.weights = records[l].weights.cast<float>();
+        layer.bias = records[l].bias.cast<float>();
+        layer.activation = records[l].activation;
+        layer.columns.setZero(records[l].weights.cols(), layer.out_height*layer.out_width);
+        layer.output.setZero(layer.out_channels, layer.out_height*layer.out_width);
+
+        channels = layer.out_channels;
+        height = layer.out_height;
+        width = layer.out_width;
+    }
+
+    layers_.swap(layers);
+    image_channels_ = image_channels;
+    input_.setZero(image_channels, image_height*image_width);
+
+    // Coordinates of the last layer pixels, as in the GPS spatial softmax.
+    pixel_x_.resize(height*width);
+    pixel_y_.resize(height*width);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            pixel_x_(y*width + x) = width > 1 ? -1.0f + 2.0f*x/(width - 1) : 0.0f;
+            pixel_y_(y*width + x) = height > 1 ? -1.0f + 2.0f*y/(height - 1) : 0.0f;
+        }
+    }
+    softmax_.setZero(height*width);
+    ROS_INFO("Loaded feature extractor with %d convolution layers and %d features", (int)layers_.size(), get_num_features());
+    return true;
+}
+
+// Expand the receptive fields of a layer input into the columns of its im2col buffer.
+void ConvFeatureExtractor::im2col(const Eigen::MatrixXf &input, ConvLayer &layer)
+{
+    // Each receptive field row is kernel_size pixels with all their channels,
+    // which are contiguous in both the input and the column.
+    const int channels = layer.in_channels;
+    const size_t row_bytes = sizeof(float)*channels*layer.kernel_size;
+    for (int oy = 0; oy < layer.out_height; oy++)
+    {
+        for (int ox = 0; ox < layer.out_width; ox++)
+        {
+            float *column = layer.columns.col(oy*layer.out_width + ox).data();
+            for (int ky = 0; ky < layer.kernel_size; ky++)
+            {
+                int pixel = (oy*layer.stride + ky)*layer.in_width + ox*layer.stride;
+                memcpy(column + ky*layer.kernel_size*channels, input.col(pixel).data(), row_bytes);
+            }
+        }
+    }
+}
+
+// Compute the feature points of an interleaved 8-bit image.
+void ConvFeatureExtractor::extract(const uint8_t *image, Eigen::VectorXd &features)
+{
+    // Interleaved pixels map directly onto the channels x pixels layout.
+    input_ = Eigen::Map<const Eigen::Matrix<uint8_t,Eigen::Dynamic,Eigen::Dynamic> >(
+        image, image_channels_, input_.cols()).cast<float>()*(1.0f/255.0f);
+
+    const Eigen::MatrixXf *layer_input = &input_;
+    for (int l = 0; l < layers_.size(); l++)
+    {
+        ConvLayer &layer = layers_[l];
+        im2col(*layer_input, layer);
+        layer.output.noalias() = layer.weights*layer.columns;
+        layer.output.colwise() += layer.bias;
+        switch (layer.activation)
+        {
+        case ActivationRelu:
+            layer.output = layer.output.cwiseMax(0.0f);
+            break;
+        case ActivationTanh:
+            for (int i = 0; i < layer.output.size(); i++)
+                layer.output(i) = std::tanh(layer.output(i));
+            break;
+        case ActivationSigmoid:
+            layer.output = (1.0f + (-layer.output.array()).exp()).inverse();
+            break;
+        default:
+            break;
+        }
+        layer_input = &layer.output;
+    }
+
+    // Spatial softmax: the expected image position of each channel.
+    const Eigen::MatrixXf &last = *layer_input;
+    const int num_channels = last.rows();
+    features.resize(2*num_channels);
+    for (int c = 0; c < num_channels; c++)
+    {
+        float max_value = last.row(c).maxCoeff();
+        softmax_ = (last.row(c).array() - max_value).exp().matrix();
+        float inverse_sum = 1.0f/softmax_.sum();
+        features(c) = softmax_.dot(pixel_x_)*inverse_sum;
+        features(num_channels + c) = softmax_.dot(pixel_y_)*inverse_sum;
+    }
+}
+
+// Number of features.
+int ConvFeatureExtractor::get_num_features() const
+{
+    return layers_.empty() ? 0 : 2*layers_.back().out_channels;
+}
@@ -1,9 +1,41 @@
 #include "gps_agent_pkg/encoderfilter.h"
 #include "gps_agent_pkg/util.h"
-#include <stdlib.h>
+#include <sstream>
 
 using namespace gps_control;
 
+// Factory function.
+EncoderFilter* EncoderFilter::create_filter(ros::NodeHandle& n, const Eigen::VectorXd &initial_state)
+{
+    std::string params;
+    Eigen::MatrixXd time_matrix;
+    Eigen::VectorXd observation_vector;
+    if (n.getParam("encoder_filter_params", params) &&
+        parse_params(params, time_matrix, observation_vector))
+    {
+        switch (observation_vector.size())
+        {
+        case 2:
+            return new FixedOrderEncoderFilter<2>(time_matrix, observation_vector, initial_state);
+        case 3:
+            return new FixedOrderEncoderFilter<3>(time_matrix, observation_vector, initial_state);
+        case 4:
+            return new FixedOrderEncoderFilter<4>(time_matrix, observation_vector, initial_state);
+        default:
+            break;
+        }
+    }
+
+    // Fall back to the dynamically sized filter for any other order.
+    return new EncoderFilter(n, initial_state);
+}
+
+EncoderFilter::EncoderFilter(int num_joints)
+{
+    num_joints_ = num_joints;
+    is_configured_ = false;
+}
+
 EncoderFilter::EncoderFilter(ros::NodeHandle& n, const Eigen::VectorXd &initial_state)
 {
     // Set initial state.
@@ -18,8 +50,8 @@ EncoderFilter::EncoderFilter(ros::NodeHandle& n, const Eigen::VectorXd &initial_
 
     configure(params);
 
-    for (int i = 0; i < num_joints_; ++i) {
-        filtered_state_(0,i) = initial_state(i);
+    if (is_configured_) {
+        filtered_state_.row(0) = initial_state.transpose();
     }
 }
 
@@ -29,32 +61,50 @@ EncoderFilter::~EncoderFilter()
     // Nothing to do here.
 }
 
-void EncoderFilter::configure(const std::string& params)
+bool EncoderFilter::parse_params(const std::string &params, Eigen::MatrixXd &time_matrix, Eigen::VectorXd &observation_vector)
 {
-    ROS_INFO("Configuring encoder Kalman filter.");
     std::vector<std::string> matrices;
     util::split(params, '\n', matrices);
+    if (matrices.size() < 2) {
+        ROS_ERROR("Encoder filter params must contain a time matrix and an observation vector.");
+        return false;
+    }
 
-    // First line is time matrix
-    std::vector<std::string> time_values;
-    util::split(matrices[0], ' ', time_values);
-    // Second line is observation vector
-    std::vector<std::string> obs_values;
-    util::split(matrices[1], ' ', obs_values);
+    // First line is time matrix, second line is observation vector.
+    std::vector<double> time_values, obs_values;
+    double value;
+    std::istringstream time_stream(matrices[0]);
+    while (time_stream >> value)
+        time_values.push_back(value);
+    std::istringstream obs_stream(matrices[1]);
+    while (obs_stream >> value)
+        obs_values.push_back(value);
 
     int filter_order = obs_values.size();
-    time_matrix_.resize(filter_order, filter_order);
-    observation_vector_.resize(filter_order);
+    if (filter_order == 0 || time_values.size() != filter_order*filter_order) {
+        ROS_ERROR("Encoder filter time matrix has %d entries, expected %d.",
+                  (int)time_values.size(), filter_order*filter_order);
+        return false;
+    }
+
+    // The time matrix is stored column-major.
+    time_matrix = Eigen::Map<Eigen::MatrixXd>(time_values.data(), filter_order, filter_order);
+    observation_vector = Eigen::Map<Eigen::VectorXd>(obs_values.data(), filter_order);
+    return true;
+}
+
+void EncoderFilter::configure(const std::string& params)
+{
+    ROS_INFO("Configuring encoder Kalman filter.");
+    if (!parse_params(params, time_matrix_, observation_vector_)) {
+        return;
+    }
 
+    int filter_order = observation_vector_.size();
     filtered_state_.resize(filter_order, num_joints_);
     filtered_state_.fill(0.0);
+    next_state_.resize(filter_order, num_joints_);
 
-    for (int i = 0; i < filter_order; ++i) {
-        for (int j = 0; j < filter_order; ++j) {
-            time_matrix_(i,j) = (double) atof(time_values[i + j*filter_order].c_str());
-        }
-        observation_vector_(i) = (double) atof(obs_values[i].c_str());
-    }
     is_configured_ = true;
     ROS_INFO("Joint kalman filter configured.");
 }
@@ -62,7 +112,9 @@ void EncoderFilter::configure(const std::string& params)
 void EncoderFilter::update(double sec_elapsed, Eigen::VectorXd &state)
 {
     if (is_configured_) {
-        filtered_state_ = time_matrix_ * filtered_state_ + observation_vector_ * state.transpose();
+        next_state_.noalias() = time_matrix_ * filtered_state_;
+        next_state_.noalias() += observation_vector_ * state.transpose();
+        filtered_state_.swap(next_state_);
     } else {
         ROS_FATAL("Not implemented if not configured");
     }
@@ -77,3 +129,8 @@ void EncoderFilter::get_velocity(Eigen::VectorXd &velocity) const
 {
     velocity = filtered_state_.row(1);
 }
+
+bool EncoderFilter::has_velocity() const
+{
+    return is_configured_ && filtered_state_.rows() > 1;
+}
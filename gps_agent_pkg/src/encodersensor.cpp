@@ -1,5 +1,6 @@
 #include "gps_agent_pkg/encodersensor.h"
 #include "gps_agent_pkg/robotplugin.h"
+#include "gps_agent_pkg/pointjacobians.h"
 
 using namespace gps_control;
 
@@ -17,19 +18,27 @@ EncoderSensor::EncoderSensor(ros::NodeHandle& n, RobotPlugin *plugin, gps::Actua
 
     // Initialize temporary angles.
     temp_joint_angles_.resize(previous_angles_.size());
+    step_angles_ = previous_angles_;
 
-    // Resize KDL joint array.
+    // Resize KDL joint arrays.
     temp_joint_array_.resize(previous_angles_.size());
+    snapshot_joint_array_.resize(previous_angles_.size());
 
     // Resize Jacobian.
     previous_jacobian_.resize(6,previous_angles_.size());
+    snapshot_jacobian_.resize(6,previous_angles_.size());
     temp_jacobian_.resize(previous_angles_.size());
 
+    // Initialize snapshot storage.
+    snapshot_angles_.resize(previous_angles_.size());
+
     // Allocate space for end effector points
     n_points_ = 1;
     previous_end_effector_points_.resize(3,1);
     previous_end_effector_point_velocities_.resize(3,1);
-    temp_end_effector_points_.resize(3,1);
+    step_end_effector_points_.resize(3,1);
+    rotated_end_effector_points_.setZero(3,1);
+    snapshot_end_effector_points_.setZero(3,1);
     end_effector_points_.resize(3,1);
     end_effector_points_.fill(0.0);
     end_effector_points_target_.resize(3,1);
@@ -38,13 +47,42 @@ EncoderSensor::EncoderSensor(ros::NodeHandle& n, RobotPlugin *plugin, gps::Actua
     // Resize point jacobians
     point_jacobians_.resize(3, previous_angles_.size());
     point_jacobians_rot_.resize(3, previous_angles_.size());
-
+    snapshot_point_jacobians_.resize(3, previous_angles_.size());
+    snapshot_point_jacobians_rot_.resize(3, previous_angles_.size());
 
     // Set time.
     previous_angles_time_ = ros::Time(0.0); // This ignores the velocities on the first step.
+    jacobian_time_ = ros::Time(0.0);
 
     // Initialize and configure Kalman filter
-    joint_filter_.reset(new EncoderFilter(n, previous_angles_));
+    joint_filter_.reset(EncoderFilter::create_filter(n, previous_angles_));
+
+    // Optionally move the Jacobians off the realtime thread.
+    if (!n.getParam("async_kinematics", async_kinematics_))
+        async_kinematics_ = false;
+
+    // Optionally decimate the joint velocities. The decimator itself is
+    // attached in configure_sensor, once the controller rate is known.
+    use_velocity_decimator_ = false;
+    decimate_velocities_ = false;
+    std::string velocity_decimator;
+    if (n.getParam("velocity_decimator", velocity_decimator) && !velocity_decimator.empty())
+    {
+        if (joint_filter_->has_velocity())
+            ROS_WARN("Encoder filter tracks the joint velocities, ignoring velocity_decimator");
+        else if (velocity_decimator == "fir" || velocity_decimator == "iir")
+        {
+            use_velocity_decimator_ = true;
+            velocity_decimator_type_ = velocity_decimator == "fir" ? FIRDecimatorType : IIRDecimatorType;
+        }
+        else
+            ROS_ERROR("Unknown velocity_decimator %s (must be fir or iir)", velocity_decimator.c_str());
+    }
+    if (!n.getParam("encoder_rate", encoder_rate_))
+        encoder_rate_ = 1000.0;
+    tick_angles_ = previous_angles_;
+    tick_velocities_.setZero(previous_angles_.size());
+    previous_tick_time_ = ros::Time(0.0);
 }
 
 // Destructor.
@@ -62,103 +100,177 @@ void EncoderSensor::update(RobotPlugin *plugin, ros::Time current_time, bool is_
     plugin->get_joint_encoder_readings(temp_joint_angles_, actuator_type_);
     joint_filter_->update(update_time, temp_joint_angles_);
 
+    // Feed the velocity decimator with the raw velocities of every tick.
+    if (decimate_velocities_)
+    {
+        double tick_time = current_time.toSec() - previous_tick_time_.toSec();
+        if (!previous_tick_time_.isZero() && tick_time > 0.0)
+        {
+            // As for the controller steps, trust the nominal period unless the
+            // tick is far off it.
+            double tick_period = 1.0/encoder_rate_;
+            if (tick_time/tick_period < 0.5 || tick_time/tick_period > 2.0)
+                tick_period = tick_time;
+            tick_velocities_ = (temp_joint_angles_ - tick_angles_)/tick_period;
+            push_decimated(gps::JOINT_VELOCITIES, tick_velocities_.data());
+        }
+        tick_angles_ = temp_joint_angles_;
+        previous_tick_time_ = current_time;
+    }
+
     if (is_controller_step)
     {
-        // Get filtered joint angles
-        joint_filter_->get_state(temp_joint_angles_);
+        update_state(plugin, current_time, true);
+        // In asynchronous mode the plugin captures, processes and commits the Jacobians.
+        if (!async_kinematics_)
+        {
+            capture_snapshot(plugin, current_time);
+            process_snapshot();
+            commit_snapshot();
+        }
+    }
+    else if (plugin->needs_tick_state(actuator_type_))
+    {
+        // The trial controller acts between controller steps, so keep the
+        // joint state and end effector points current on every tick.
+        update_state(plugin, current_time, false);
+    }
+}
 
-        // Get FK solvers from plugin.
+// Read the filtered joint state and compute FK and end effector points. The
+// finite-difference velocities only advance on controller steps, so between
+// steps they keep the last estimate unless the filter tracks velocities.
+void EncoderSensor::update_state(RobotPlugin *plugin, ros::Time current_time, bool is_controller_step)
+{
+    // Get FK solvers from plugin (they do not change once the plugin is initialized).
+    if (!fk_solver_)
         plugin->get_fk_solver(fk_solver_,jac_solver_, actuator_type_);
 
-        // Compute end effector position, rotation, and Jacobian.
-        // Save angles in KDL joint array.
-        for (unsigned i = 0; i < temp_joint_angles_.size(); i++)
-            temp_joint_array_(i) = temp_joint_angles_[i];
-        // Run the solvers.
-        fk_solver_->JntToCart(temp_joint_array_, temp_tip_pose_);
-        jac_solver_->JntToJac(temp_joint_array_, temp_jacobian_);
-        // Store position, rotation, and Jacobian.
+    // Get filtered joint angles, and velocities when the Kalman filter tracks them.
+    joint_filter_->get_state(temp_joint_angles_);
+    bool filtered_velocities = joint_filter_->has_velocity();
+    if (filtered_velocities)
+        joint_filter_->get_velocity(previous_velocities_);
+
+    // Compute end effector position and rotation.
+    for (unsigned i = 0; i < temp_joint_angles_.size(); i++)
+        temp_joint_array_(i) = temp_joint_angles_[i];
+    fk_solver_->JntToCart(temp_joint_array_, temp_tip_pose_);
+    for (unsigned i = 0; i < 3; i++)
+        previous_position_(i) = temp_tip_pose_.p(i);
+    for (unsigned j = 0; j < 3; j++)
         for (unsigned i = 0; i < 3; i++)
-            previous_position_(i) = temp_tip_pose_.p(i);
-        for (unsigned j = 0; j < 3; j++)
-            for (unsigned i = 0; i < 3; i++)
-                previous_rotation_(i,j) = temp_tip_pose_.M(i,j);
-        for (unsigned j = 0; j < temp_jacobian_.columns(); j++)
-            for (unsigned i = 0; i < 6; i++)
-                previous_jacobian_(i,j) = temp_jacobian_(i,j);
-
-        // IMPORTANT: note that the Python code will assume that the Jacobian is the Jacobian of the end effector points, not of the end
-        // effector itself. In the old code, this correction was done in Matlab, but since the simulator will produce Jacobians of end
-        // effector points directly, it would make sense to also do this transformation on the robot, and send back N Jacobians, one for
-        // each feature point.
-
-        // Compute jacobian
-        // TODO - This assumes we are using all joints.
-        unsigned n_actuator = previous_angles_.size();
-
-        for(int i=0; i<n_points_; i++){
-            unsigned site_start = i*3;
-            Eigen::VectorXd ovec = end_effector_points_.col(i);
-
-            for(unsigned j=0; j<3; j++){
-                for(unsigned k=0; k<n_actuator; k++){
-                    point_jacobians_(site_start+j, k) = temp_jacobian_(j,k);
-                    point_jacobians_rot_(site_start+j, k) = temp_jacobian_(j+3,k);
-                }
-            }
+            previous_rotation_(i,j) = temp_tip_pose_.M(i,j);
 
-            // Compute site Jacobian.
-            ovec = previous_rotation_*ovec;
-            for(unsigned k=0; k<n_actuator; k++){
-                point_jacobians_(site_start  , k) += point_jacobians_rot_(site_start+1, k)*ovec[2] - point_jacobians_rot_(site_start+2, k)*ovec[1];
-                point_jacobians_(site_start+1, k) += point_jacobians_rot_(site_start+2, k)*ovec[0] - point_jacobians_rot_(site_start  , k)*ovec[2];
-                point_jacobians_(site_start+2, k) += point_jacobians_rot_(site_start  , k)*ovec[1] - point_jacobians_rot_(site_start+1, k)*ovec[0];
-            }
-        }
+    // Rotate the end effector point offsets into the base frame, and compute
+    // the current end effector points relative to their targets so that the
+    // goal is always zero.
+    rotated_end_effector_points_.noalias() = previous_rotation_*end_effector_points_;
+    previous_end_effector_points_ = rotated_end_effector_points_;
+    previous_end_effector_points_.colwise() += previous_position_;
+    previous_end_effector_points_ -= end_effector_points_target_;
+    previous_angles_ = temp_joint_angles_;
 
-        // Compute current end effector points and store in temporary storage.
-        temp_end_effector_points_ = previous_rotation_*end_effector_points_;
-        temp_end_effector_points_.colwise() += previous_position_;
-
-        // Subtract the target end effector points so that the goal is always zero
-        temp_end_effector_points_ -= end_effector_points_target_;
-
-        // Compute velocities.
-        // Note that we can't assume the last angles are actually from one step ago, so we check first.
-        // If they are roughly from one step ago, assume the step is correct, otherwise use actual time.
-
-        double update_time = current_time.toSec() - previous_angles_time_.toSec();
-        if (!previous_angles_time_.isZero())
-        { // Only compute velocities if we have a previous sample.
-            if (fabs(update_time)/sensor_step_length_ >= 0.5 &&
-                fabs(update_time)/sensor_step_length_ <= 2.0)
-            {
-                previous_end_effector_point_velocities_ = (temp_end_effector_points_ - previous_end_effector_points_)/sensor_step_length_;
-                for (unsigned i = 0; i < previous_velocities_.size(); i++){
-                    previous_velocities_[i] = (temp_joint_angles_[i] - previous_angles_[i])/sensor_step_length_;
-                }
-            }
-            else
-            {
-                previous_end_effector_point_velocities_ = (temp_end_effector_points_ - previous_end_effector_points_)/update_time;
-                for (unsigned i = 0; i < previous_velocities_.size(); i++){
-                    previous_velocities_[i] = (temp_joint_angles_[i] - previous_angles_[i])/update_time;
-                }
+    if (!is_controller_step)
+        return;
+
+    // Compute remaining velocities by finite differences from the last controller step.
+    // Note that we can't assume the last angles are actually from one step ago, so we check first.
+    // If they are roughly from one step ago, assume the step is correct, otherwise use actual time.
+
+    double update_time = current_time.toSec() - previous_angles_time_.toSec();
+    if (!previous_angles_time_.isZero())
+    { // Only compute velocities if we have a previous sample.
+        double velocity_step = update_time;
+        if (fabs(update_time)/sensor_step_length_ >= 0.5 &&
+            fabs(update_time)/sensor_step_length_ <= 2.0)
+        {
+            velocity_step = sensor_step_length_;
+        }
+        previous_end_effector_point_velocities_ = (previous_end_effector_points_ - step_end_effector_points_)/velocity_step;
+        // Decimated joint velocities are read from the decimator instead.
+        if (!filtered_velocities && !decimate_velocities_)
+        {
+            for (unsigned i = 0; i < previous_velocities_.size(); i++){
+                previous_velocities_[i] = (previous_angles_[i] - step_angles_[i])/velocity_step;
             }
         }
+    }
 
-        // Move temporaries into the previous joint angles.
-        previous_end_effector_points_ = temp_end_effector_points_;
-        for (unsigned i = 0; i < previous_angles_.size(); i++){
-            previous_angles_[i] = temp_joint_angles_[i];
-        }
+    // Remember the state of this controller step for the next finite differences.
+    step_end_effector_points_ = previous_end_effector_points_;
+    step_angles_ = previous_angles_;
 
-        // Update stored time.
-        previous_angles_time_ = current_time;
-    }
+    // Update stored time.
+    previous_angles_time_ = current_time;
+}
+
+// Capture the joint angles and point offsets of the current step for the Jacobians.
+void EncoderSensor::capture_snapshot(RobotPlugin *plugin, ros::Time current_time)
+{
+    snapshot_angles_ = previous_angles_;
+    snapshot_end_effector_points_ = rotated_end_effector_points_;
+    snapshot_time_ = current_time;
+}
+
+// Compute the end effector and point Jacobians from the snapshot.
+void EncoderSensor::process_snapshot()
+{
+    // Save angles in KDL joint array.
+    for (unsigned i = 0; i < snapshot_angles_.size(); i++)
+        snapshot_joint_array_(i) = snapshot_angles_[i];
+    // Run the solver.
+    jac_solver_->JntToJac(snapshot_joint_array_, temp_jacobian_);
+    // Store the Jacobian.
+    for (unsigned j = 0; j < temp_jacobian_.columns(); j++)
+        for (unsigned i = 0; i < 6; i++)
+            snapshot_jacobian_(i,j) = temp_jacobian_(i,j);
+
+    // IMPORTANT: note that the Python code will assume that the Jacobian is the Jacobian of the end effector points, not of the end
+    // effector itself. In the old code, this correction was done in Matlab, but since the simulator will produce Jacobians of end
+    // effector points directly, it would make sense to also do this transformation on the robot, and send back N Jacobians, one for
+    // each feature point.
+
+    // Compute the Jacobians of all points in one batched pass.
+    compute_point_jacobians(snapshot_jacobian_, snapshot_end_effector_points_, snapshot_point_jacobians_, snapshot_point_jacobians_rot_);
+}
+
+// Swap the snapshot Jacobians into the sample data.
+void EncoderSensor::commit_snapshot()
+{
+    // The snapshot buffers are fully rewritten next time, so swap rather than copy.
+    previous_jacobian_.swap(snapshot_jacobian_);
+    point_jacobians_.swap(snapshot_point_jacobians_);
+    point_jacobians_rot_.swap(snapshot_point_jacobians_rot_);
+    jacobian_time_ = snapshot_time_;
+}
+
+// The Jacobians are the oldest data (one controller step old when asynchronous).
+ros::Time EncoderSensor::get_data_time(ros::Time current_time) const
+{
+    return jacobian_time_;
+}
+
+// The filter needs every encoder reading, so this sensor runs every tick.
+SensorUpdateRate EncoderSensor::get_update_rate() const
+{
+    return SensorUpdateEveryTick;
 }
 
-void EncoderSensor::configure_sensor(OptionsMap &options)
+// Filtering is cheap; the FK and Jacobian solves only happen on controller steps
+// (FK also runs between them while the trial controller acts on every tick).
+double EncoderSensor::get_update_cost() const
+{
+    return 2e-6;
+}
+
+// Jacobians run asynchronously if the async_kinematics parameter is set.
+SensorExecutionMode EncoderSensor::get_execution_mode() const
+{
+    return async_kinematics_ ? SensorExecutionAsync : SensorExecutionInline;
+}
+
+void EncoderSensor::configure_sensor(const SensorConfig &config)
 {
     /* TODO: note that this will get called every time there is a report, so
     we should not throw out the previous transform just because we are trying
@@ -166,7 +278,7 @@ void EncoderSensor::configure_sensor(OptionsMap &options)
     compute what the points should be! This will allow us to query positions
     and velocities each time. */
 
-    end_effector_points_ = boost::get<Eigen::MatrixXd>(options["ee_sites"]).transpose();
+    end_effector_points_ = config.ee_sites.transpose();
     n_points_ = end_effector_points_.cols();
 
     if( end_effector_points_.cols() != 3){
@@ -175,7 +287,7 @@ void EncoderSensor::configure_sensor(OptionsMap &options)
                 (int)end_effector_points_.cols());
     }
 
-    end_effector_points_target_ = boost::get<Eigen::MatrixXd>(options["ee_points_tgt"]).transpose();
+    end_effector_points_target_ = config.ee_points_tgt.transpose();
     int n_points_target_ = end_effector_points_target_.cols();
     if( end_effector_points_target_.cols() != 3){
         ROS_ERROR("EE tgt has more than 3 coordinates: Shape=(%d,%d)",
@@ -189,10 +301,27 @@ void EncoderSensor::configure_sensor(OptionsMap &options)
 
     previous_end_effector_points_.resize(3, n_points_);
     previous_end_effector_point_velocities_.resize(3, n_points_);
-    temp_end_effector_points_.resize(3, n_points_);
+    step_end_effector_points_.resize(3, n_points_);
+    rotated_end_effector_points_.setZero(3, n_points_);
+    snapshot_end_effector_points_.setZero(3, n_points_);
     point_jacobians_.resize(3*n_points_, previous_angles_.size());
     point_jacobians_rot_.resize(3*n_points_, previous_angles_.size());
-
+    snapshot_point_jacobians_.resize(3*n_points_, previous_angles_.size());
+    snapshot_point_jacobians_rot_.resize(3*n_points_, previous_angles_.size());
+
+    // Attach a fresh velocity decimator for the controller rate of this trial.
+    // The auxiliary arm has no controller rate, so it is never decimated.
+    decimators_.clear();
+    decimate_velocities_ = false;
+    if (use_velocity_decimator_ && sensor_step_length_ > 0.0)
+    {
+        attach_decimator(gps::JOINT_VELOCITIES, SensorDecimator::create_decimator(
+            velocity_decimator_type_, previous_angles_.size(), encoder_rate_, 1.0/sensor_step_length_));
+        decimate_velocities_ = !decimators_.empty();
+        if (decimate_velocities_)
+            decimators_[gps::JOINT_VELOCITIES]->reset(Eigen::VectorXd::Zero(previous_angles_.size()));
+        previous_tick_time_ = ros::Time(0.0);
+    }
 }
 
 // Set data format and meta data on the provided sample.
@@ -202,9 +331,12 @@ void EncoderSensor::set_sample_data_format(boost::scoped_ptr<Sample>& sample)
     OptionsMap joints_metadata;
     sample->set_meta_data(gps::JOINT_ANGLES,previous_angles_.size(),SampleDataFormatEigenVector,joints_metadata);
 
-    // Set joint velocities size and format.
-    OptionsMap velocities_metadata;
-    sample->set_meta_data(gps::JOINT_VELOCITIES,previous_velocities_.size(),SampleDataFormatEigenVector,joints_metadata);
+    // Set joint velocities size and format (decimated velocities are set below).
+    if (!decimate_velocities_)
+    {
+        OptionsMap velocities_metadata;
+        sample->set_meta_data(gps::JOINT_VELOCITIES,previous_velocities_.size(),SampleDataFormatEigenVector,joints_metadata);
+    }
 
     // Set end effector point size and format.
     OptionsMap eep_metadata;
@@ -233,6 +365,9 @@ void EncoderSensor::set_sample_data_format(boost::scoped_ptr<Sample>& sample)
     // Set jacobian size and format.
     OptionsMap eejac_metadata;
     sample->set_meta_data(gps::END_EFFECTOR_JACOBIANS,previous_jacobian_.rows(),previous_jacobian_.cols(),SampleDataFormatEigenMatrix,eejac_metadata);
+
+    // Set size and format of the decimated data types.
+    set_decimated_sample_data_format(sample);
 }
 
 // Set data on the provided sample.
@@ -241,8 +376,9 @@ void EncoderSensor::set_sample_data(boost::scoped_ptr<Sample>& sample, int t)
     // Set joint angles.
     sample->set_data_vector(t,gps::JOINT_ANGLES,previous_angles_.data(),previous_angles_.size(),SampleDataFormatEigenVector);
 
-    // Set joint velocities.
-    sample->set_data_vector(t,gps::JOINT_VELOCITIES,previous_velocities_.data(),previous_velocities_.size(),SampleDataFormatEigenVector);
+    // Set joint velocities (decimated velocities are set below).
+    if (!decimate_velocities_)
+        sample->set_data_vector(t,gps::JOINT_VELOCITIES,previous_velocities_.data(),previous_velocities_.size(),SampleDataFormatEigenVector);
 
     // Set end effector point.
     sample->set_data_vector(t,gps::END_EFFECTOR_POINTS,previous_end_effector_points_.data(),previous_end_effector_points_.cols()*previous_end_effector_points_.rows(),SampleDataFormatEigenVector);
@@ -264,4 +400,7 @@ void EncoderSensor::set_sample_data(boost::scoped_ptr<Sample>& sample, int t)
 
     // Set end effector jacobian.
     sample->set_data_vector(t,gps::END_EFFECTOR_JACOBIANS,previous_jacobian_.data(),previous_jacobian_.rows(),previous_jacobian_.cols(),SampleDataFormatEigenMatrix);
+
+    // Set the filtered value of the decimated data types.
+    set_decimated_sample_data(sample, t);
 }
@@ -0,0 +1,97 @@
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "gps_agent_pkg/jointtrajectory.h"
+
+using namespace gps_control;
+
+// Constructor.
+JointTrajectory::JointTrajectory()
+: max_path_velocity_(0.0), max_path_acceleration_(0.0), accel_time_(0.0), duration_(0.0)
+{
+}
+
+// Plan a motion from start to goal.
+void JointTrajectory::plan(const Eigen::VectorXd &start, const Eigen::VectorXd &goal,
+                           const Eigen::VectorXd &max_velocities, const Eigen::VectorXd &max_accelerations)
+{
+    start_ = start;
+    delta_ = goal - start;
+
+    // The joint with the largest displacement relative to its limit bounds the path rate.
+    max_path_velocity_ = std::numeric_limits<double>::infinity();
+    max_path_acceleration_ = std::numeric_limits<double>::infinity();
+    for (int i = 0; i < delta_.size(); i++)
+    {
+        double distance = std::fabs(delta_(i));
+        if (distance < 1e-12) continue;
+        max_path_velocity_ = std::min(max_path_velocity_, max_velocities(i)/distance);
+        max_path_acceleration_ = std::min(max_path_acceleration_, max_accelerations(i)/distance);
+    }
+
+    if (max_path_velocity_ == std::numeric_limits<double>::infinity())
+    {
+        // Already at the goal.
+        accel_time_ = duration_ = 0.0;
+        return;
+    }
+
+    // Trapezoidal profile over s in [0,1]; triangular if the cruise velocity is never reached.
+    accel_time_ = max_path_velocity_/max_path_acceleration_;
+    if (max_path_velocity_*accel_time_ >= 1.0)
+    {
+        accel_time_ = std::sqrt(1.0/max_path_acceleration_);
+        max_path_velocity_ = max_path_acceleration_*accel_time_;
+        duration_ = 2.0*accel_time_;
+    }
+    else
+    {
+        duration_ = accel_time_ + 1.0/max_path_velocity_;
+    }
+}
+
+// Evaluate the trajectory at time t.
+void JointTrajectory::evaluate(double t, Eigen::VectorXd &position, Eigen::VectorXd &velocity, Eigen::VectorXd &acceleration) const
+{
+    double s, sd, sdd;
+    if (t <= 0.0 || duration_ == 0.0)
+    {
+        s = (duration_ == 0.0 && t > 0.0) ? 1.0 : 0.0;
+        sd = sdd = 0.0;
+    }
+    else if (t < accel_time_)
+    {
+        sdd = max_path_acceleration_;
+        sd = sdd*t;
+        s = 0.5*sdd*t*t;
+    }
+    else if (t < duration_ - accel_time_)
+    {
+        sdd = 0.0;
+        sd = max_path_velocity_;
+        s = 0.5*max_path_velocity_*accel_time_ + max_path_velocity_*(t - accel_time_);
+    }
+    else if (t < duration_)
+    {
+        double remaining = duration_ - t;
+        sdd = -max_path_acceleration_;
+        sd = max_path_acceleration_*remaining;
+        s = 1.0 - 0.5*max_path_acceleration_*remaining*remaining;
+    }
+    else
+    {
+        s = 1.0;
+        sd = sdd = 0.0;
+    }
+
+    position = start_ + s*delta_;
+    velocity = sd*delta_;
+    acceleration = sdd*delta_;
+}
+
+// Duration of the motion in seconds.
+double JointTrajectory::get_duration() const
+{
+    return duration_;
+}
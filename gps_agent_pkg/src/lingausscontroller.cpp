@@ -1,6 +1,8 @@
 #include "gps_agent_pkg/robotplugin.h"
 #include "gps_agent_pkg/lingausscontroller.h"
 #include "gps_agent_pkg/util.h"
+#include "gps_agent_pkg/trialcontrollerregistry.h"
+#include "gps_agent_pkg/LinGaussParams.h"
 
 using namespace gps_control;
 
@@ -9,6 +11,8 @@ LinearGaussianController::LinearGaussianController()
 : TrialController()
 {
     is_configured_ = false;
+    interpolation_ = LinGaussInterpolationNone;
+    step_period_ = 0.0;
 }
 
 // Destructor.
@@ -22,25 +26,96 @@ void LinearGaussianController::get_action(int t, const Eigen::VectorXd &X, const
     U = K_[t]*X+k_[t];
 }
 
+// Add weight*(K_[t]*X+k_[t]) to U, with t clamped to the trajectory.
+void LinearGaussianController::add_knot_action(int t, double weight, const Eigen::VectorXd &X, Eigen::VectorXd &U)
+{
+    t = std::max(0, std::min(t, (int)K_.size()-1));
+    knot_action_.noalias() = K_[t]*X;
+    knot_action_ += k_[t];
+    U += weight*knot_action_;
+}
+
+// Compute the action between controller steps t and t+1. Since the control
+// law is linear in K and k, blending the per-knot actions is the same as
+// applying the blended gains, and avoids forming the blended matrix.
+void LinearGaussianController::get_tick_action(int t, double elapsed, const Eigen::VectorXd &X, Eigen::VectorXd &U)
+{
+    double s = std::max(0.0, std::min(elapsed/step_period_, 1.0));
+    U.setZero(k_[0].size());
+    if (interpolation_ == LinGaussInterpolationLinear)
+    {
+        add_knot_action(t, 1.0-s, X, U);
+        add_knot_action(t+1, s, X, U);
+    }
+    else
+    {
+        // Catmull-Rom weights for the knots t-1, t, t+1 and t+2.
+        double s2 = s*s, s3 = s2*s;
+        add_knot_action(t-1, 0.5*(-s3 + 2.0*s2 - s), X, U);
+        add_knot_action(t,   0.5*(3.0*s3 - 5.0*s2 + 2.0), X, U);
+        add_knot_action(t+1, 0.5*(-3.0*s3 + 4.0*s2 + s), X, U);
+        add_knot_action(t+2, 0.5*(s3 - s2), X, U);
+    }
+}
+
+// Check whether the control law runs on every tick.
+bool LinearGaussianController::updates_every_tick() const
+{
+    return interpolation_ != LinGaussInterpolationNone && step_period_ > 0.0;
+}
+
 // Configure the controller.
-void LinearGaussianController::configure_controller(OptionsMap &options)
+void LinearGaussianController::configure(const LinearGaussianControllerConfig &config)
 {
     //Call superclass
-    TrialController::configure_controller(options);
+    TrialController::configure(config);
 
-    // TODO: Update K_
-    int T = boost::get<int>(options["T"]);
+    K_ = config.K;
+    k_ = config.k;
 
-    //TODO Don't do this hacky string indexing
-    K_.resize(T);
-    for(int i=0; i<T; i++){
-        K_[i] = boost::get<Eigen::MatrixXd>(options["K_"+to_string(i)]);
-    }
-
-    k_.resize(T);
-    for(int i=0; i<T; i++){
-        k_[i] = boost::get<Eigen::VectorXd>(options["k_"+to_string(i)]);
+    interpolation_ = config.interpolation;
+    if (interpolation_ < LinGaussInterpolationNone || interpolation_ >= TotalLinGaussInterpolationTypes)
+    {
+        ROS_ERROR("Unknown gain interpolation %d, holding torques between steps", (int)interpolation_);
+        interpolation_ = LinGaussInterpolationNone;
     }
+    step_period_ = config.step_period;
+    if (!k_.empty())
+        knot_action_.resize(k_[0].size());
     ROS_INFO_STREAM("Set LG parameters");
     is_configured_ = true;
 }
+
+namespace
+{
+
+// Unpack the linear-Gaussian gains from the parameters message and configure a controller.
+TrialController *create_lingauss_controller(const gps_agent_pkg::ControllerParams &params, const TrialControllerConfig &trial, double frequency)
+{
+    typedef Eigen::Matrix<double,Eigen::Dynamic,Eigen::Dynamic,Eigen::RowMajor> RowMajorMatrixXd;
+    const gps_agent_pkg::LinGaussParams &lingauss = params.lingauss;
+    int T = trial.T;
+    int dX = (int) lingauss.dX;
+    int dU = (int) lingauss.dU;
+    if (!check_param_size(lingauss.K_t, T*dU*dX, "lingauss.K_t") ||
+        !check_param_size(lingauss.k_t, T*dU, "lingauss.k_t"))
+        return NULL;
+
+    LinearGaussianControllerConfig config;
+    static_cast<TrialControllerConfig&>(config) = trial;
+    // K_t holds a row-major dU x dX gain matrix per step.
+    config.K.resize(T);
+    for(int t=0; t<T; t++)
+        config.K[t] = Eigen::Map<const RowMajorMatrixXd>(&lingauss.K_t[t*dU*dX], dU, dX);
+    unpack_step_vectors(lingauss.k_t, dU, T, config.k);
+    config.interpolation = (LinGaussInterpolation)lingauss.interpolation;
+    config.step_period = 1.0/frequency;
+
+    LinearGaussianController *controller = new LinearGaussianController();
+    controller->configure(config);
+    return controller;
+}
+
+}
+
+REGISTER_TRIAL_CONTROLLER(gps::LIN_GAUSS_CONTROLLER, "lingauss", create_lingauss_controller);
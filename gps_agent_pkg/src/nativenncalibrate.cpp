@@ -0,0 +1,101 @@
+/*
+Calibration utility for the native network. Loads a weight blob, evaluates it
+at every precision on a set of calibration inputs, and reports the output
+error against the double reference together with the time per forward pass.
+
+Usage: nativenn_calibrate weights.bin [inputs.bin]
+inputs.bin holds float64 rows of the network input size (already scaled). If
+it is omitted, standard normal inputs are used.
+*/
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <time.h>
+#include <boost/random.hpp>
+
+#include "gps_agent_pkg/neuralnetworknative.h"
+
+using namespace gps_control;
+
+namespace
+{
+
+double now_sec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+bool read_file(const char *path, std::string &contents)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s weights.bin [inputs.bin]\n", argv[0]);
+        return 1;
+    }
+
+    std::string blob;
+    NeuralNetworkNative net;
+    if (!read_file(argv[1], blob) || !net.load_weights(reinterpret_cast<const uint8_t*>(blob.data()), blob.size()))
+    {
+        fprintf(stderr, "could not load weights from %s\n", argv[1]);
+        return 1;
+    }
+    const int input_size = net.get_input_size();
+    net.set_scalebias(Eigen::MatrixXd::Identity(input_size, input_size), Eigen::VectorXd::Zero(input_size));
+
+    Eigen::MatrixXd inputs;
+    std::string input_data;
+    if (argc > 2)
+    {
+        if (!read_file(argv[2], input_data) || input_data.size() % (sizeof(double)*input_size) != 0)
+        {
+            fprintf(stderr, "%s does not hold rows of %d doubles\n", argv[2], input_size);
+            return 1;
+        }
+        inputs = Eigen::Map<const Eigen::MatrixXd>(reinterpret_cast<const double*>(input_data.data()),
+                                                   input_size, input_data.size()/(sizeof(double)*input_size));
+    }
+    else
+    {
+        boost::mt19937 rng(0);
+        boost::normal_distribution<double> normal;
+        inputs.resize(input_size, 1000);
+        for (int i = 0; i < inputs.size(); i++)
+            inputs(i) = normal(rng);
+    }
+
+    const char *names[] = {"float64", "float32", "int8"};
+    printf("%d calibration inputs, %d -> %d\n", (int)inputs.cols(), input_size, net.get_output_size());
+    printf("%10s %14s %14s %14s %12s\n", "precision", "max abs error", "rms error", "relative rms", "time [us]");
+    Eigen::VectorXd input, output;
+    for (int p = 0; p < TotalPrecisionTypes; p++)
+    {
+        NeuralNetworkCalibration calibration = net.calibrate(inputs, (NeuralNetworkPrecision)p);
+
+        net.set_precision((NeuralNetworkPrecision)p);
+        const int iterations = 10000;
+        input = inputs.col(0);
+        double start = now_sec();
+        for (int it = 0; it < iterations; it++)
+            net.forward(input, output);
+        double time = (now_sec() - start)/iterations;
+
+        printf("%10s %14.3e %14.3e %14.3e %12.2f\n", names[p], calibration.max_abs_error, calibration.rms_error,
+               calibration.rms_output > 0.0 ? calibration.rms_error/calibration.rms_output : 0.0, 1e6*time);
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "gps_agent_pkg/nativenncontroller.h"
+#include "gps_agent_pkg/robotplugin.h"
+#include "gps_agent_pkg/util.h"
+#include "gps_agent_pkg/neuralnetworkregistry.h"
+#include "gps_agent_pkg/trialcontrollerregistry.h"
+#include "gps_agent_pkg/NativeNNParams.h"
+
+using namespace gps_control;
+
+// Network backend used for each NeuralNetworkPrecision when none is named.
+static const char *precision_backends[TotalPrecisionTypes] = {"native_double", "native_float", "native_int8"};
+
+// Constructor.
+NativeNNController::NativeNNController()
+: TrialController()
+{
+    is_configured_ = false;
+}
+
+// Destructor.
+NativeNNController::~NativeNNController()
+{
+}
+
+void NativeNNController::get_action(int t, const Eigen::VectorXd &X, const Eigen::VectorXd &obs, Eigen::VectorXd &U){
+    if (is_configured_) {
+        net_->forward(obs, U);
+        U += noise_[t];
+    }
+}
+
+// Configure the controller.
+void NativeNNController::configure(const NativeNNControllerConfig &config)
+{
+    //Call superclass
+    TrialController::configure(config);
+    is_configured_ = false;
+
+    std::string backend = config.network_backend;
+    if (backend.empty())
+    {
+        int precision = config.precision;
+        if (precision < 0 || precision >= TotalPrecisionTypes)
+        {
+            ROS_ERROR("Unknown network precision %d, using double", precision);
+            precision = PrecisionDouble;
+        }
+        backend = precision_backends[precision];
+    }
+    net_.reset(NeuralNetworkRegistry::create(backend));
+    if (!net_)
+        return;
+    if (!net_->load_weights(reinterpret_cast<const uint8_t*>(config.weights.data()), config.weights.size()))
+    {
+        ROS_ERROR("Network backend %s could not load the weights", backend.c_str());
+        return;
+    }
+
+    if (net_->get_input_size() >= 0 && net_->get_input_size() != config.bias.size()) {
+        ROS_ERROR("Native network expects %d inputs, but the scale and bias have %d",
+                  net_->get_input_size(), (int)config.bias.size());
+        return;
+    }
+    net_->set_scalebias(config.scale, config.bias);
+    noise_ = config.noise;
+
+    ROS_INFO("Set native network parameters (backend %s)", backend.c_str());
+    is_configured_ = true;
+}
+
+namespace
+{
+
+// Unpack the native network, scale, bias and noise from the parameters message and configure a controller.
+TrialController *create_native_nn_controller(const gps_agent_pkg::ControllerParams &params, const TrialControllerConfig &trial, double frequency)
+{
+    const gps_agent_pkg::NativeNNParams &native = params.native;
+    int dU = (int) native.dU;
+    NativeNNControllerConfig config;
+    static_cast<TrialControllerConfig&>(config) = trial;
+    if (!unpack_scale_bias(native.scale, native.bias, native.dim_bias, config.scale, config.bias) ||
+        !check_param_size(native.noise, trial.T*dU, "native.noise"))
+        return NULL;
+    unpack_step_vectors(native.noise, dU, trial.T, config.noise);
+    config.weights.assign(native.weights.begin(), native.weights.end());
+    config.network_backend = native.network_backend;
+    config.precision = (NeuralNetworkPrecision)native.precision;
+
+    NativeNNController *controller = new NativeNNController();
+    controller->configure(config);
+    return controller;
+}
+
+}
+
+REGISTER_TRIAL_CONTROLLER(gps::NATIVE_NN_CONTROLLER, "native_nn", create_native_nn_controller);
@@ -2,6 +2,12 @@
 
 using namespace gps_control;
 
+// Constructor.
+NeuralNetwork::NeuralNetwork()
+{
+    is_scale_diagonal_ = false;
+}
+
 // Destruct all objects.
 NeuralNetwork::~NeuralNetwork()
 {
@@ -19,6 +25,12 @@ void NeuralNetwork::set_scalebias(const Eigen::MatrixXd& scale, const Eigen::Vec
     scale_ = scale;
     bias_ = bias;
 
+    // Scales are usually diagonal, which turns the matrix-vector product into
+    // an element-wise product.
+    is_scale_diagonal_ = scale.rows() == scale.cols() && scale.isDiagonal(0.0);
+    if (is_scale_diagonal_)
+        scale_diagonal_ = scale.diagonal();
+
     int dim_bias = bias.size();
 
     // Preallocate temporaries
@@ -26,7 +38,40 @@ void NeuralNetwork::set_scalebias(const Eigen::MatrixXd& scale, const Eigen::Vec
     ROS_INFO("Scale and bias set successfully");
 }
 
+// Compute input_scaled_ from the leading entries of the input.
+void NeuralNetwork::scale_input(const Eigen::VectorXd &input)
+{
+    // Note that this assumes that all state information that we don't want to feed to the network is stored at the end of the state vector.
+    assert(input.rows() >= input_scaled_.rows());
+    if (is_scale_diagonal_)
+        input_scaled_ = scale_diagonal_.cwiseProduct(input.head(input_scaled_.rows())) + bias_;
+    else
+    {
+        input_scaled_.noalias() = scale_ * input.head(input_scaled_.rows());
+        input_scaled_ += bias_;
+    }
+}
+
 void NeuralNetwork::set_weights(void *weights_ptr)
 {
     // Nothing to do here.
 }
+
+// Load the weights from a flat binary blob.
+bool NeuralNetwork::load_weights(const uint8_t *data, size_t size)
+{
+    ROS_ERROR("This network does not support loading weights from a binary blob");
+    return false;
+}
+
+// Number of network inputs.
+int NeuralNetwork::get_input_size() const
+{
+    return -1;
+}
+
+// Number of network outputs.
+int NeuralNetwork::get_output_size() const
+{
+    return -1;
+}
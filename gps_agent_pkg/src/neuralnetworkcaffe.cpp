@@ -36,9 +36,7 @@ NeuralNetworkCaffe::~NeuralNetworkCaffe()
 void NeuralNetworkCaffe::forward(const Eigen::VectorXd &input, std::vector<float> &feat_input, Eigen::VectorXd &output)
 {
     // Transform the input by scale and bias.
-    // Note that this assumes that all state information that we don't want to feed to the network is stored at the end of the state vector.
-    assert(input.rows() >= input_scaled_.rows());
-    input_scaled_ = scale_*input.segment(0, input_scaled_.rows()) + bias_;
+    scale_input(input);
 
     ROS_FATAL("Forward with >1 input not implemented!");
     // TODO implement, will be very similar to forward with one input
@@ -48,9 +46,7 @@ void NeuralNetworkCaffe::forward(const Eigen::VectorXd &input, std::vector<float
 void NeuralNetworkCaffe::forward(const Eigen::VectorXd &input, Eigen::VectorXd &output)
 {
     // Transform the input by scale and bias.
-    // Note that this assumes that all state information that we don't want to feed to the network is stored at the end of the state vector.
-    assert(input.rows() >= input_scaled_.rows());
-    input_scaled_ = scale_ * input.segment(0, input_scaled_.rows()) + bias_;
+    scale_input(input);
 
     Blob<float>* input_blob = net_->bottom_vecs()[1][0];
 
@@ -0,0 +1,405 @@
+#include "gps_agent_pkg/neuralnetworknative.h"
+#include "gps_agent_pkg/neuralnetworkregistry.h"
+#include <string.h>
+#include <math.h>
+#include <cmath>
+#include <algorithm>
+
+using namespace gps_control;
+
+namespace
+{
+
+// Read a little-endian value from the blob and advance the offset.
+template <typename T>
+bool read_value(const uint8_t *data, size_t size, size_t &offset, T &value)
+{
+    if (offset + sizeof(T) > size)
+        return false;
+    memcpy(&value, data + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+// Add the bias and apply the activation in a single pass over the layer output.
+template <typename Vector>
+void apply_bias_activation(const Vector &bias, NeuralNetworkActivation activation, Vector &values)
+{
+    typedef typename Vector::Scalar Scalar;
+    switch (activation)
+    {
+    case ActivationLinear:
+        values += bias;
+        break;
+    case ActivationRelu:
+        values = (values + bias).cwiseMax(Scalar(0));
+        break;
+    case ActivationTanh:
+        for (int i = 0; i < values.size(); i++)
+            values(i) = std::tanh(values(i) + bias(i));
+        break;
+    case ActivationSigmoid:
+        for (int i = 0; i < values.size(); i++)
+            values(i) = Scalar(1)/(Scalar(1) + std::exp(-(values(i) + bias(i))));
+        break;
+    default:
+        break;
+    }
+}
+
+// Backend factories, one per precision.
+NeuralNetwork *create_native_double()
+{
+    return new NeuralNetworkNative(PrecisionDouble);
+}
+
+NeuralNetwork *create_native_float()
+{
+    return new NeuralNetworkNative(PrecisionFloat);
+}
+
+NeuralNetwork *create_native_int8()
+{
+    return new NeuralNetworkNative(PrecisionInt8);
+}
+
+}
+
+REGISTER_NEURAL_NETWORK("native_double", create_native_double);
+REGISTER_NEURAL_NETWORK("native_float", create_native_float);
+REGISTER_NEURAL_NETWORK("native_int8", create_native_int8);
+
+// Constructor.
+NeuralNetworkNative::NeuralNetworkNative(NeuralNetworkPrecision precision)
+{
+    precision_ = precision;
+}
+
+// Destructor.
+NeuralNetworkNative::~NeuralNetworkNative()
+{
+}
+
+// Run forward pass of network with passed in input, and fill in output.
+void NeuralNetworkNative::forward(const Eigen::VectorXd &input, Eigen::VectorXd &output)
+{
+    // Transform the input by scale and bias.
+    scale_input(input);
+
+    switch (precision_)
+    {
+    case PrecisionFloat:
+        forward_float(output);
+        break;
+    case PrecisionInt8:
+        forward_int8(output);
+        break;
+    default:
+        forward_double(output);
+        break;
+    }
+}
+
+// Double precision forward pass.
+void NeuralNetworkNative::forward_double(Eigen::VectorXd &output)
+{
+    const Eigen::VectorXd *layer_input = &input_scaled_;
+    for (int l = 0; l < layers_.size(); l++)
+    {
+        activations_[l].noalias() = layers_[l].weights * (*layer_input);
+        apply_bias_activation(layers_[l].bias, layers_[l].activation, activations_[l]);
+        layer_input = &activations_[l];
+    }
+    output = *layer_input;
+}
+
+// Float32 forward pass.
+void NeuralNetworkNative::forward_float(Eigen::VectorXd &output)
+{
+    input_float_ = input_scaled_.cast<float>();
+    const Eigen::VectorXf *layer_input = &input_float_;
+    for (int l = 0; l < float_layers_.size(); l++)
+    {
+        activations_float_[l].noalias() = float_layers_[l].weights * (*layer_input);
+        apply_bias_activation(float_layers_[l].bias, float_layers_[l].activation, activations_float_[l]);
+        layer_input = &activations_float_[l];
+    }
+    output = layer_input->cast<double>();
+}
+
+// Int8 forward pass.
+void NeuralNetworkNative::forward_int8(Eigen::VectorXd &output)
+{
+    input_float_ = input_scaled_.cast<float>();
+    const Eigen::VectorXf *layer_input = &input_float_;
+    for (int l = 0; l < int8_layers_.size(); l++)
+    {
+        const DenseLayerInt8 &layer = int8_layers_[l];
+
+        // Quantize the layer input symmetrically with a single scale.
+        float input_max = layer_input->cwiseAbs().maxCoeff();
+        float input_scale = input_max > 0.0f ? input_max/127.0f : 1.0f;
+        float inverse_input_scale = 1.0f/input_scale;
+        const float *input_data = layer_input->data();
+        int16_t *x = &input_quantized_[0];
+        for (int j = 0; j < layer.cols; j++)
+        {
+            float v = input_data[j]*inverse_input_scale;
+            x[j] = (int16_t)(v >= 0.0f ? v + 0.5f : v - 0.5f);
+        }
+
+        // Integer dot products, four output channels at a time so that each
+        // input load is shared; these vectorize as widening multiply-adds.
+        // The blocks have a fixed length, so no scalar remainder is needed and
+        // GCC vectorizes them without -O3. The padding weights are zero, so
+        // whatever the input buffer holds past cols does not matter.
+        Eigen::VectorXf &values = activations_float_[l];
+        const int cols = layer.padded_cols;
+        const int8_t *weights = &layer.quantized_weights[0];
+        int i = 0;
+        for (; i + 4 <= layer.rows; i += 4)
+        {
+            const int8_t *w0 = weights + (size_t)i*cols;
+            const int8_t *w1 = w0 + cols, *w2 = w1 + cols, *w3 = w2 + cols;
+            int32_t sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+            for (int b = 0; b < cols; b += NATIVE_NN_INT8_BLOCK)
+            {
+                for (int j = b; j < b + NATIVE_NN_INT8_BLOCK; j++)
+                {
+                    sum0 += w0[j]*x[j];
+                    sum1 += w1[j]*x[j];
+                    sum2 += w2[j]*x[j];
+                    sum3 += w3[j]*x[j];
+                }
+            }
+            values(i  ) = sum0*layer.channel_scales(i  )*input_scale;
+            values(i+1) = sum1*layer.channel_scales(i+1)*input_scale;
+            values(i+2) = sum2*layer.channel_scales(i+2)*input_scale;
+            values(i+3) = sum3*layer.channel_scales(i+3)*input_scale;
+        }
+        for (; i < layer.rows; i++)
+        {
+            const int8_t *w = weights + (size_t)i*cols;
+            int32_t sum = 0;
+            for (int b = 0; b < cols; b += NATIVE_NN_INT8_BLOCK)
+            {
+                for (int j = b; j < b + NATIVE_NN_INT8_BLOCK; j++)
+                    sum += w[j]*x[j];
+            }
+            values(i) = sum*layer.channel_scales(i)*input_scale;
+        }
+        apply_bias_activation(layer.bias, layer.activation, values);
+        layer_input = &values;
+    }
+    output = layer_input->cast<double>();
+}
+
+// Set the weights of the neural network from a std::string holding the blob.
+void NeuralNetworkNative::set_weights(void *weights_ptr)
+{
+    const std::string *weights = static_cast<const std::string*>(weights_ptr);
+    load_weights(reinterpret_cast<const uint8_t*>(weights->data()), weights->size());
+}
+
+// Load the layers from a flat binary blob.
+bool NeuralNetworkNative::load_weights(const uint8_t *data, size_t size)
+{
+    std::vector<DenseLayer> layers;
+    if (!parse_layers(data, size, layers))
+        return false;
+    for (int l = 1; l < layers.size(); l++)
+    {
+        if (layers[l].weights.cols() != layers[l-1].weights.rows())
+        {
+            ROS_ERROR("Layer %d expects %d inputs, previous layer has %d outputs", l,
+                      (int)layers[l].weights.cols(), (int)layers[l-1].weights.rows());
+            return false;
+        }
+    }
+
+    layers_.swap(layers);
+    // Preallocate the layer outputs.
+    activations_.resize(layers_.size());
+    for (int l = 0; l < layers_.size(); l++)
+        activations_[l].setZero(layers_[l].weights.rows());
+    // Rebuild the reduced-precision layers for the new weights.
+    set_precision(precision_);
+    ROS_INFO("Loaded native network with %d layers", (int)layers_.size());
+    return true;
+}
+
+// Parse the layer records of a flat binary blob.
+bool NeuralNetworkNative::parse_layers(const uint8_t *data, size_t size, std::vector<DenseLayer> &layers)
+{
+    size_t offset = 0;
+    uint32_t magic, version, num_layers;
+    if (!read_value(data, size, offset, magic) || magic != NATIVE_NN_MAGIC ||
+        !read_value(data, size, offset, version) || version != NATIVE_NN_VERSION ||
+        !read_value(data, size, offset, num_layers))
+    {
+        ROS_ERROR("Native network weights have an unknown header");
+        return false;
+    }
+
+    // Every layer needs at least its header, so a count that the rest of the
+    // blob cannot hold is corrupt (and must not size the allocation below).
+    const size_t layer_header_size = 3*sizeof(uint32_t);
+    if (num_layers > (size - offset)/layer_header_size)
+    {
+        ROS_ERROR("Native network weights declare %u layers but hold at most %d", num_layers,
+                  (int)((size - offset)/layer_header_size));
+        return false;
+    }
+
+    layers.resize(num_layers);
+    for (uint32_t l = 0; l < num_layers; l++)
+    {
+        uint32_t rows, cols, activation;
+        if (!read_value(data, size, offset, rows) ||
+            !read_value(data, size, offset, cols) ||
+            !read_value(data, size, offset, activation))
+        {
+            ROS_ERROR("Native network weights truncated in layer %d header", l);
+            return false;
+        }
+        if (activation >= TotalActivationTypes)
+        {
+            ROS_ERROR("Unknown activation %d in layer %d", activation, l);
+            return false;
+        }
+        // Compare element counts rather than bytes, which could overflow.
+        if ((size_t)rows*cols + rows > (size - offset)/sizeof(double))
+        {
+            ROS_ERROR("Native network weights truncated in layer %d", l);
+            return false;
+        }
+        // Weights are stored row-major.
+        Eigen::Matrix<double,Eigen::Dynamic,Eigen::Dynamic,Eigen::RowMajor> weights(rows, cols);
+        memcpy(weights.data(), data + offset, sizeof(double)*rows*cols);
+        offset += sizeof(double)*rows*cols;
+        layers[l].weights = weights;
+        layers[l].bias.resize(rows);
+        memcpy(layers[l].bias.data(), data + offset, sizeof(double)*rows);
+        offset += sizeof(double)*rows;
+        layers[l].activation = (NeuralNetworkActivation)activation;
+    }
+    if (offset != size)
+        ROS_WARN("Ignoring %d trailing bytes in native network weights", (int)(size - offset));
+    return true;
+}
+
+// Select the precision of the forward pass.
+void NeuralNetworkNative::set_precision(NeuralNetworkPrecision precision)
+{
+    precision_ = precision;
+    float_layers_.clear();
+    int8_layers_.clear();
+    if (precision == PrecisionFloat)
+        build_float_layers();
+    else if (precision == PrecisionInt8)
+        build_int8_layers();
+    else if (precision != PrecisionDouble)
+    {
+        ROS_ERROR("Unknown network precision %d, using double", precision);
+        precision_ = PrecisionDouble;
+    }
+
+    // Preallocate the float32 storage shared by both reduced-precision paths.
+    int max_cols = 0;
+    activations_float_.resize(layers_.size());
+    for (int l = 0; l < layers_.size(); l++)
+    {
+        activations_float_[l].setZero(layers_[l].weights.rows());
+        max_cols = std::max(max_cols, (int)layers_[l].weights.cols());
+    }
+    input_float_.setZero(get_input_size());
+    input_quantized_.assign((max_cols + NATIVE_NN_INT8_BLOCK - 1)/NATIVE_NN_INT8_BLOCK*NATIVE_NN_INT8_BLOCK, 0);
+}
+
+NeuralNetworkPrecision NeuralNetworkNative::get_precision() const
+{
+    return precision_;
+}
+
+// Build the float32 layers.
+void NeuralNetworkNative::build_float_layers()
+{
+    float_layers_.resize(layers_.size());
+    for (int l = 0; l < layers_.size(); l++)
+    {
+        float_layers_[l].weights = layers_[l].weights.cast<float>();
+        float_layers_[l].bias = layers_[l].bias.cast<float>();
+        float_layers_[l].activation = layers_[l].activation;
+    }
+}
+
+// Build the int8 layers with one symmetric scale per output channel.
+void NeuralNetworkNative::build_int8_layers()
+{
+    int8_layers_.resize(layers_.size());
+    for (int l = 0; l < layers_.size(); l++)
+    {
+        const Eigen::MatrixXd &weights = layers_[l].weights;
+        DenseLayerInt8 &layer = int8_layers_[l];
+        layer.rows = weights.rows();
+        layer.cols = weights.cols();
+        layer.padded_cols = (layer.cols + NATIVE_NN_INT8_BLOCK - 1)/NATIVE_NN_INT8_BLOCK*NATIVE_NN_INT8_BLOCK;
+        layer.quantized_weights.assign((size_t)layer.rows*layer.padded_cols, 0);
+        layer.channel_scales.resize(layer.rows);
+        for (int i = 0; i < layer.rows; i++)
+        {
+            double channel_max = weights.row(i).cwiseAbs().maxCoeff();
+            double channel_scale = channel_max > 0.0 ? channel_max/127.0 : 1.0;
+            layer.channel_scales(i) = channel_scale;
+            for (int j = 0; j < layer.cols; j++)
+                layer.quantized_weights[(size_t)i*layer.padded_cols + j] = (int8_t)lrint(weights(i,j)/channel_scale);
+        }
+        layer.bias = layers_[l].bias.cast<float>();
+        layer.activation = layers_[l].activation;
+    }
+}
+
+// Compare the forward pass at the given precision against the double reference.
+NeuralNetworkCalibration NeuralNetworkNative::calibrate(const Eigen::MatrixXd &inputs, NeuralNetworkPrecision precision)
+{
+    NeuralNetworkPrecision previous_precision = precision_;
+    Eigen::VectorXd reference, reduced;
+    double squared_error = 0.0, squared_output = 0.0;
+    NeuralNetworkCalibration calibration;
+    calibration.max_abs_error = 0.0;
+
+    // Evaluate the double reference first, then switch precision once.
+    Eigen::MatrixXd references(get_output_size(), inputs.cols());
+    set_precision(PrecisionDouble);
+    for (int i = 0; i < inputs.cols(); i++)
+    {
+        forward(inputs.col(i), reference);
+        references.col(i) = reference;
+    }
+    set_precision(precision);
+    for (int i = 0; i < inputs.cols(); i++)
+    {
+        forward(inputs.col(i), reduced);
+        calibration.max_abs_error = std::max(calibration.max_abs_error, (reduced - references.col(i)).cwiseAbs().maxCoeff());
+        squared_error += (reduced - references.col(i)).squaredNorm();
+        squared_output += references.col(i).squaredNorm();
+    }
+    int count = std::max((int)(inputs.cols()*get_output_size()), 1);
+    calibration.rms_error = sqrt(squared_error/count);
+    calibration.rms_output = sqrt(squared_output/count);
+
+    set_precision(previous_precision);
+    return calibration;
+}
+
+// Number of inputs of the first layer.
+int NeuralNetworkNative::get_input_size() const
+{
+    return layers_.empty() ? 0 : layers_.front().weights.cols();
+}
+
+// Number of outputs of the last layer.
+int NeuralNetworkNative::get_output_size() const
+{
+    return layers_.empty() ? 0 : layers_.back().weights.rows();
+}
@@ -0,0 +1,44 @@
+#include "gps_agent_pkg/neuralnetworkregistry.h"
+#include <map>
+
+using namespace gps_control;
+
+namespace
+{
+
+typedef std::map<std::string, NeuralNetworkFactory> NeuralNetworkFactoryMap;
+
+// Construct on first use, since backends register during static initialization.
+NeuralNetworkFactoryMap &get_factories()
+{
+    static NeuralNetworkFactoryMap factories;
+    return factories;
+}
+
+}
+
+// Register a factory under a name.
+bool NeuralNetworkRegistry::register_network(const std::string &name, NeuralNetworkFactory factory)
+{
+    return get_factories().insert(std::make_pair(name, factory)).second;
+}
+
+// Create a network by name.
+NeuralNetwork *NeuralNetworkRegistry::create(const std::string &name)
+{
+    NeuralNetworkFactoryMap::const_iterator it = get_factories().find(name);
+    if (it == get_factories().end())
+    {
+        ROS_ERROR("No neural network backend named %s", name.c_str());
+        return NULL;
+    }
+    return it->second();
+}
+
+// Names of all registered backends.
+void NeuralNetworkRegistry::get_registered(std::vector<std::string> &names)
+{
+    names.clear();
+    for (NeuralNetworkFactoryMap::const_iterator it = get_factories().begin(); it != get_factories().end(); ++it)
+        names.push_back(it->first);
+}
@@ -0,0 +1,217 @@
+/*
+Side-by-side benchmark of the registered network backends. Loads the same
+weights into every backend and reports the p50/p99 time per forward pass, the
+heap allocations per forward pass, and the largest output difference against
+the native_double reference, to pick the fastest acceptable backend for a
+policy size.
+
+Usage: nnbackend_benchmark (weights.bin | 32x64x64x7) [iterations]
+A layer size list instead of a weight blob benchmarks a random ReLU network of
+that shape. Inputs are standard normal (already scaled).
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <time.h>
+#include <boost/random.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "gps_agent_pkg/neuralnetworknative.h"
+#include "gps_agent_pkg/neuralnetworkregistry.h"
+
+using namespace gps_control;
+
+#ifdef __GLIBC__
+// Count heap allocations by interposing malloc. Eigen and operator new both
+// allocate through malloc, so this sees every allocation of a forward pass.
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+static unsigned long allocation_count = 0;
+
+extern "C" void *malloc(size_t size) __THROW
+{
+    allocation_count++;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) __THROW
+{
+    allocation_count++;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) __THROW
+{
+    allocation_count++;
+    return __libc_realloc(ptr, size);
+}
+#define COUNTS_ALLOCATIONS 1
+#else
+static unsigned long allocation_count = 0;
+#define COUNTS_ALLOCATIONS 0
+#endif
+
+namespace
+{
+
+double now_sec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+bool read_file(const char *path, std::string &contents)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+template <typename T>
+void append_value(std::string &blob, T value)
+{
+    blob.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Build the blob of a random ReLU network (linear output layer) from a size list such as 32x64x7.
+bool make_random_blob(const std::string &shape, std::string &blob)
+{
+    std::vector<int> sizes;
+    std::stringstream stream(shape);
+    std::string size;
+    while (std::getline(stream, size, 'x'))
+    {
+        int value = atoi(size.c_str());
+        if (value <= 0)
+            return false;
+        sizes.push_back(value);
+    }
+    if (sizes.size() < 2)
+        return false;
+
+    boost::mt19937 rng(0);
+    boost::normal_distribution<double> normal;
+    blob.clear();
+    append_value<uint32_t>(blob, NATIVE_NN_MAGIC);
+    append_value<uint32_t>(blob, NATIVE_NN_VERSION);
+    append_value<uint32_t>(blob, sizes.size() - 1);
+    for (int l = 0; l + 1 < sizes.size(); l++)
+    {
+        int rows = sizes[l+1], cols = sizes[l];
+        bool last = l + 2 == sizes.size();
+        append_value<uint32_t>(blob, rows);
+        append_value<uint32_t>(blob, cols);
+        append_value<uint32_t>(blob, last ? ActivationLinear : ActivationRelu);
+        for (int i = 0; i < rows*cols; i++)
+            append_value<double>(blob, normal(rng)/sqrt((double)cols));
+        for (int i = 0; i < rows; i++)
+            append_value<double>(blob, 0.1*normal(rng));
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s (weights.bin | 32x64x64x7) [iterations]\n", argv[0]);
+        return 1;
+    }
+    const int iterations = argc > 2 ? atoi(argv[2]) : 10000;
+    if (iterations <= 0)
+    {
+        fprintf(stderr, "iterations must be positive\n");
+        return 1;
+    }
+
+    std::string blob;
+    if (!read_file(argv[1], blob) && !make_random_blob(argv[1], blob))
+    {
+        fprintf(stderr, "%s is neither a weight blob nor a layer size list\n", argv[1]);
+        return 1;
+    }
+    std::vector<DenseLayer> layers;
+    if (!NeuralNetworkNative::parse_layers(reinterpret_cast<const uint8_t*>(blob.data()), blob.size(), layers) || layers.empty())
+    {
+        fprintf(stderr, "could not parse the weights\n");
+        return 1;
+    }
+    const int input_size = layers.front().weights.cols();
+    const int output_size = layers.back().weights.rows();
+
+    boost::mt19937 rng(0);
+    boost::normal_distribution<double> normal;
+    Eigen::MatrixXd inputs(input_size, 1000);
+    for (int i = 0; i < inputs.size(); i++)
+        inputs(i) = normal(rng);
+
+    std::vector<std::string> names;
+    NeuralNetworkRegistry::get_registered(names);
+    // Evaluate the reference first.
+    std::vector<std::string>::iterator reference_name = std::find(names.begin(), names.end(), "native_double");
+    if (reference_name != names.end())
+        std::rotate(names.begin(), reference_name, reference_name + 1);
+
+    printf("%d layers, %d -> %d, %d iterations\n", (int)layers.size(), input_size, output_size, iterations);
+    printf("%16s %10s %10s %14s %16s\n", "backend", "p50 [us]", "p99 [us]", "allocs/call", "max abs diff");
+    Eigen::MatrixXd references;
+    Eigen::VectorXd input, output;
+    std::vector<double> times(iterations);
+    for (int b = 0; b < names.size(); b++)
+    {
+        boost::scoped_ptr<NeuralNetwork> net(NeuralNetworkRegistry::create(names[b]));
+        if (!net || !net->load_weights(reinterpret_cast<const uint8_t*>(blob.data()), blob.size()))
+        {
+            printf("%16s %10s\n", names[b].c_str(), "(cannot load these weights)");
+            continue;
+        }
+        net->set_scalebias(Eigen::MatrixXd::Identity(input_size, input_size), Eigen::VectorXd::Zero(input_size));
+
+        // Agreement with the reference on all inputs (this also warms up the backend).
+        Eigen::MatrixXd outputs(output_size, inputs.cols());
+        for (int i = 0; i < inputs.cols(); i++)
+        {
+            input = inputs.col(i);
+            output.setZero(output_size);
+            net->forward(input, output);
+            outputs.col(i) = output;
+        }
+        if (references.size() == 0)
+            references = outputs;
+
+        input = inputs.col(0);
+        unsigned long allocations = allocation_count;
+        for (int it = 0; it < iterations; it++)
+        {
+            double start = now_sec();
+            net->forward(input, output);
+            times[it] = now_sec() - start;
+        }
+        allocations = allocation_count - allocations;
+        std::sort(times.begin(), times.end());
+
+        char allocations_text[32];
+        if (COUNTS_ALLOCATIONS)
+            snprintf(allocations_text, sizeof(allocations_text), "%.2f", (double)allocations/iterations);
+        else
+            snprintf(allocations_text, sizeof(allocations_text), "n/a");
+        printf("%16s %10.2f %10.2f %14s %16.3e\n", names[b].c_str(), 1e6*times[iterations/2],
+               1e6*times[std::min(iterations - 1, (int)(0.99*iterations))], allocations_text,
+               (outputs - references).cwiseAbs().maxCoeff());
+    }
+    return 0;
+}
@@ -0,0 +1,111 @@
+/*
+Microbenchmark for the end-effector point Jacobian kernel. Times the original
+per-point loop against the compute_point_jacobians pass used by the
+EncoderSensor, for an increasing number of tracked points.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <time.h>
+#include <Eigen/Dense>
+
+#include "gps_agent_pkg/pointjacobians.h"
+
+using namespace gps_control;
+
+namespace
+{
+
+typedef void (*PointJacobianKernel)(const Eigen::MatrixXd&, const Eigen::MatrixXd&, Eigen::MatrixXd&, Eigen::MatrixXd&);
+
+double now_sec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+// Time of one call to each kernel, in seconds. The kernels are interleaved and
+// the fastest round of each is kept, so that frequency changes and other load
+// affect them alike. The kernels are called through a volatile pointer, so
+// none of them can be inlined into (or hoisted out of) the timing loop.
+void time_kernels(const PointJacobianKernel *kernels, int n_kernels, const Eigen::MatrixXd &jacobian,
+                  const Eigen::MatrixXd &points, Eigen::MatrixXd &jac, Eigen::MatrixXd &jac_rot,
+                  int iterations, double *times)
+{
+    const int rounds = 20;
+    std::fill(times, times + n_kernels, 1e9);
+    for (int round = 0; round < rounds; round++)
+    {
+        for (int k = 0; k < n_kernels; k++)
+        {
+            double start = now_sec();
+            for (int it = 0; it < iterations; it++)
+            {
+                PointJacobianKernel volatile kernel = kernels[k];
+                kernel(jacobian, points, jac, jac_rot);
+                asm volatile("" ::: "memory");
+            }
+            times[k] = std::min(times[k], (now_sec() - start)/iterations);
+        }
+    }
+}
+
+// Point-major loop (the original per-point implementation), kept as the
+// reference. It must not be inlined, like the kernel in pointjacobians.cpp.
+__attribute__((noinline, noclone))
+void compute_point_jacobians_reference(const Eigen::MatrixXd &jacobian, const Eigen::MatrixXd &rotated_points,
+                                       Eigen::MatrixXd &point_jacobians, Eigen::MatrixXd &point_jacobians_rot)
+{
+    unsigned n_actuator = jacobian.cols();
+    for (int i = 0; i < rotated_points.cols(); i++)
+    {
+        unsigned site_start = i*3;
+        for (unsigned j = 0; j < 3; j++)
+        {
+            for (unsigned k = 0; k < n_actuator; k++)
+            {
+                point_jacobians(site_start+j, k) = jacobian(j,k);
+                point_jacobians_rot(site_start+j, k) = jacobian(j+3,k);
+            }
+        }
+        const double *ovec = rotated_points.col(i).data();
+        for (unsigned k = 0; k < n_actuator; k++)
+        {
+            point_jacobians(site_start  , k) += point_jacobians_rot(site_start+1, k)*ovec[2] - point_jacobians_rot(site_start+2, k)*ovec[1];
+            point_jacobians(site_start+1, k) += point_jacobians_rot(site_start+2, k)*ovec[0] - point_jacobians_rot(site_start  , k)*ovec[2];
+            point_jacobians(site_start+2, k) += point_jacobians_rot(site_start  , k)*ovec[1] - point_jacobians_rot(site_start+1, k)*ovec[0];
+        }
+    }
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    const int n_joints = 7;
+    const int iterations = argc > 1 ? atoi(argv[1]) : 10000;
+    const int point_counts[] = {1, 2, 3, 4, 8, 16, 64};
+    const PointJacobianKernel kernels[] = {compute_point_jacobians_reference, compute_point_jacobians};
+
+    printf("%8s %16s %15s %10s %12s\n", "points", "reference [ns]", "batched [ns]", "speedup", "max error");
+    for (unsigned c = 0; c < sizeof(point_counts)/sizeof(point_counts[0]); c++)
+    {
+        const int n_points = point_counts[c];
+        Eigen::MatrixXd jacobian = Eigen::MatrixXd::Random(6, n_joints);
+        Eigen::MatrixXd points = Eigen::MatrixXd::Random(3, n_points);
+        Eigen::MatrixXd reference_jac(3*n_points, n_joints), reference_jac_rot(3*n_points, n_joints);
+        Eigen::MatrixXd batched_jac(3*n_points, n_joints), batched_jac_rot(3*n_points, n_joints);
+
+        compute_point_jacobians_reference(jacobian, points, reference_jac, reference_jac_rot);
+        compute_point_jacobians(jacobian, points, batched_jac, batched_jac_rot);
+        double error = std::max((reference_jac - batched_jac).cwiseAbs().maxCoeff(),
+                                (reference_jac_rot - batched_jac_rot).cwiseAbs().maxCoeff());
+
+        double times[2];
+        time_kernels(kernels, 2, jacobian, points, batched_jac, batched_jac_rot, iterations, times);
+        printf("%8d %16.1f %15.1f %9.2fx %12.3e\n", n_points, 1e9*times[0], 1e9*times[1],
+               times[0]/times[1], error);
+    }
+    return 0;
+}
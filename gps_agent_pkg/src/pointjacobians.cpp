@@ -0,0 +1,36 @@
+#include "gps_agent_pkg/pointjacobians.h"
+
+namespace gps_control
+{
+
+// Compute the Jacobians of all end-effector points in one joint-major pass.
+void compute_point_jacobians(const Eigen::MatrixXd &jacobian, const Eigen::MatrixXd &rotated_points,
+                             Eigen::MatrixXd &point_jacobians, Eigen::MatrixXd &point_jacobians_rot)
+{
+    const int n_points = rotated_points.cols();
+    const double *offsets = rotated_points.data();
+
+    // The velocity of point i due to joint k is v_k + w_k x o_i. Each column of
+    // the output stacks all points contiguously (x,y,z per point), so loop over
+    // joints and apply the skew-symmetric product of w_k to every offset in a
+    // single streaming pass that the compiler can vectorize.
+    for (int k = 0; k < jacobian.cols(); k++)
+    {
+        const double vx = jacobian(0,k), vy = jacobian(1,k), vz = jacobian(2,k);
+        const double wx = jacobian(3,k), wy = jacobian(4,k), wz = jacobian(5,k);
+        double *out = point_jacobians.col(k).data();
+        double *out_rot = point_jacobians_rot.col(k).data();
+        for (int i = 0; i < 3*n_points; i += 3)
+        {
+            const double ox = offsets[i], oy = offsets[i+1], oz = offsets[i+2];
+            out[i  ] = vx + wy*oz - wz*oy;
+            out[i+1] = vy + wz*ox - wx*oz;
+            out[i+2] = vz + wx*oy - wy*ox;
+            out_rot[i  ] = wx;
+            out_rot[i+1] = wy;
+            out_rot[i+2] = wz;
+        }
+    }
+}
+
+}
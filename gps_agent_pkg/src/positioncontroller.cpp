@@ -1,6 +1,7 @@
 #include "gps_agent_pkg/positioncontroller.h"
 #include "gps_agent_pkg/robotplugin.h"
 #include "gps_agent_pkg/util.h"
+#include <limits>
 
 using namespace gps_control;
 
@@ -15,8 +16,14 @@ PositionController::PositionController(ros::NodeHandle& n, gps::ActuatorType arm
     pd_gains_d_.resize(size);
     pd_gains_i_.resize(size);
 
-    // Initialize velocity bounds.
-    max_velocities_.resize(size);
+    // Initialize velocity and acceleration bounds for trajectory resets.
+    std::vector<double> limits;
+    max_velocities_.setConstant(size, 1.0);
+    if (n.getParam("reset_max_velocities", limits) && limits.size() == size)
+        max_velocities_ = Eigen::Map<Eigen::VectorXd>(&limits[0], size);
+    max_accelerations_.setConstant(size, 2.0);
+    if (n.getParam("reset_max_accelerations", limits) && limits.size() == size)
+        max_accelerations_ = Eigen::Map<Eigen::VectorXd>(&limits[0], size);
 
     // Initialize integral terms to zero.
     pd_integral_.resize(size);
@@ -34,8 +41,26 @@ PositionController::PositionController(ros::NodeHandle& n, gps::ActuatorType arm
     // Initialize joints temporary storage.
     temp_angles_.resize(size);
 
+    // Initialize reference storage.
+    reference_angles_.setZero(size);
+    reference_velocities_.setZero(size);
+    reference_accelerations_.setZero(size);
+    feedforward_torques_.setZero(size);
+    trajectory_pending_ = false;
+    trajectory_elapsed_ = 0.0;
+
     // Initialize Jacobian temporary storage.
     temp_jacobian_.resize(6,size);
+    temp_joint_array_.resize(size);
+    temp_kdl_jacobian_.resize(size);
+    temp_mass_matrix_.resize(size);
+    task_jacobian_.resize(6,size);
+    task_dims_ = 3;
+    task_error_norm_ = 0.0;
+    if (!n.getParam("task_space_damping", task_space_damping_))
+        task_space_damping_ = 0.05;
+    if (!n.getParam("task_space_max_step", task_space_max_step_))
+        task_space_max_step_ = 0.1;
 
     // Set initial mode.
     mode_ = gps::NO_CONTROL;
@@ -78,26 +103,26 @@ void PositionController::update(RobotPlugin *plugin, ros::Time current_time, boo
     // Update last update time.
     last_update_time_ = current_time;
 
-    // If doing task space control, compute joint positions target.
-    if (mode_ == gps::TASK_SPACE)
+    // Compute the reference to track.
+    if (mode_ == gps::JOINT_SPACE_TRAJECTORY)
     {
-        ROS_ERROR("Not implemented!");
-
-        // TODO: implement.
-        // Get current end effector position.
-
-        // Get current Jacobian.
-
-        // TODO: should also try Jacobian pseudoinverse, it may work a little better.
-        // Compute desired joint angle offset using Jacobian transpose method.
-        target_angles_ = current_angles_ + temp_jacobian_.transpose() * (target_pose_ - current_pose_);
+        update_trajectory_reference(plugin, current_time);
+    }
+    else
+    {
+        // If doing task space control, compute joint positions target.
+        if (mode_ == gps::TASK_SPACE)
+            update_task_space_target(plugin);
+        reference_angles_ = target_angles_;
+        reference_velocities_.setZero();
+        feedforward_torques_.setZero();
     }
 
     // If we're doing any kind of control at all, compute torques now.
     if (mode_ != gps::NO_CONTROL)
     {
         // Compute error.
-        temp_angles_ = current_angles_ - target_angles_;
+        temp_angles_ = current_angles_ - reference_angles_;
 
         // Add to integral term.
         pd_integral_ += temp_angles_ * update_time;
@@ -113,9 +138,10 @@ void PositionController::update(RobotPlugin *plugin, ros::Time current_time, boo
         }
 
         // Compute torques.
-        torques = -((pd_gains_p_.array() * temp_angles_.array()) +
-                    (pd_gains_d_.array() * current_angle_velocities_.array()) +
-                    (pd_gains_i_.array() * pd_integral_.array())).matrix();
+        torques = feedforward_torques_ -
+                  ((pd_gains_p_.array() * temp_angles_.array()) +
+                   (pd_gains_d_.array() * (current_angle_velocities_ - reference_velocities_).array()) +
+                   (pd_gains_i_.array() * pd_integral_.array())).matrix();
     }
     else
     {
@@ -124,18 +150,91 @@ void PositionController::update(RobotPlugin *plugin, ros::Time current_time, boo
 
 }
 
+// Compute the trajectory reference and feedforward torques.
+void PositionController::update_trajectory_reference(RobotPlugin *plugin, ros::Time current_time)
+{
+    // Plan from wherever the arm is when the reset starts.
+    if (trajectory_pending_)
+    {
+        trajectory_.plan(current_angles_, target_angles_, max_velocities_, max_accelerations_);
+        start_time_ = current_time;
+        pd_integral_.fill(0.0);
+        trajectory_pending_ = false;
+        ROS_INFO("Planned reset trajectory of %.2f seconds", trajectory_.get_duration());
+    }
+    trajectory_elapsed_ = (current_time - start_time_).toSec();
+    trajectory_.evaluate(trajectory_elapsed_, reference_angles_, reference_velocities_, reference_accelerations_);
+
+    // Feedforward the inertial torques of the reference acceleration, if the plugin provides dynamics.
+    if (!dyn_solver_)
+        dyn_solver_ = plugin->get_dyn_solver(arm_);
+    if (dyn_solver_)
+    {
+        temp_joint_array_.data = reference_angles_;
+        dyn_solver_->JntToMass(temp_joint_array_, temp_mass_matrix_);
+        feedforward_torques_.noalias() = temp_mass_matrix_.data * reference_accelerations_;
+    }
+    else
+    {
+        feedforward_torques_.setZero();
+    }
+}
+
+// Compute the joint target for the next update by damped least squares:
+// dq = J^T (J J^T + lambda^2 I)^-1 e, limited to task_space_max_step_.
+void PositionController::update_task_space_target(RobotPlugin *plugin)
+{
+    if (!fk_solver_)
+        plugin->get_fk_solver(fk_solver_, jac_solver_, arm_);
+
+    // Get current end effector pose and Jacobian.
+    temp_joint_array_.data = current_angles_;
+    fk_solver_->JntToCart(temp_joint_array_, temp_frame_);
+    jac_solver_->JntToJac(temp_joint_array_, temp_kdl_jacobian_);
+
+    // Pose error as a twist in the base frame (translation first).
+    KDL::Twist error = KDL::diff(temp_frame_, target_frame_);
+    for (int i = 0; i < 6; i++)
+        task_error_(i) = error(i);
+    task_jacobian_ = temp_kdl_jacobian_.data;
+    if (task_dims_ < 6)
+    {
+        // Leave the orientation free.
+        task_error_.tail(6-task_dims_).setZero();
+        task_jacobian_.bottomRows(6-task_dims_).setZero();
+    }
+    task_error_norm_ = task_error_.norm();
+
+    task_gram_.noalias() = task_jacobian_ * task_jacobian_.transpose();
+    task_gram_.diagonal().array() += task_space_damping_*task_space_damping_;
+    task_solver_.compute(task_gram_);
+    task_error_ = task_solver_.solve(task_error_);
+    temp_angles_.noalias() = task_jacobian_.transpose() * task_error_;
+
+    double step = temp_angles_.norm();
+    if (step > task_space_max_step_)
+        temp_angles_ *= task_space_max_step_/step;
+    target_angles_ = current_angles_ + temp_angles_;
+}
+
 // Configure the controller.
-void PositionController::configure_controller(OptionsMap &options)
+void PositionController::configure(const PositionControllerConfig &config)
 {
     // This sets the target position.
     // This sets the mode
     ROS_INFO_STREAM("Received controller configuration");
     // needs to report when finished
     report_waiting = true;
-    mode_ = (gps::PositionControlMode) boost::get<int>(options["mode"]);
+    mode_ = config.mode;
     if (mode_ != gps::NO_CONTROL){
-        Eigen::VectorXd data = boost::get<Eigen::VectorXd>(options["data"]);
-        Eigen::MatrixXd pd_gains = boost::get<Eigen::MatrixXd>(options["pd_gains"]);
+        const Eigen::VectorXd &data = config.data;
+        const Eigen::MatrixXd &pd_gains = config.pd_gains;
+        if (pd_gains.rows() > pd_gains_p_.size() || pd_gains.cols() != 4) {
+            ROS_ERROR("Position command has %dx%d PD gains, expected at most %dx4",
+                      (int)pd_gains.rows(), (int)pd_gains.cols(), (int)pd_gains_p_.size());
+            mode_ = gps::NO_CONTROL;
+            return;
+        }
         for(int i=0; i<pd_gains.rows(); i++){
             pd_gains_p_(i) = pd_gains(i, 0);
             pd_gains_i_(i) = pd_gains(i, 1);
@@ -144,6 +243,22 @@ void PositionController::configure_controller(OptionsMap &options)
         }
         if(mode_ == gps::JOINT_SPACE){
             target_angles_ = data;
+        }else if(mode_ == gps::JOINT_SPACE_TRAJECTORY){
+            target_angles_ = data;
+            trajectory_pending_ = true;
+            trajectory_elapsed_ = 0.0;
+        }else if(mode_ == gps::TASK_SPACE){
+            // Target position, optionally followed by roll, pitch and yaw.
+            if (data.size() != 3 && data.size() != 6) {
+                ROS_ERROR("Task space target must have 3 or 6 entries, got %d", (int)data.size());
+                mode_ = gps::NO_CONTROL;
+                return;
+            }
+            task_dims_ = data.size();
+            KDL::Rotation rotation = task_dims_ == 6 ? KDL::Rotation::RPY(data(3), data(4), data(5)) : KDL::Rotation::Identity();
+            target_frame_ = KDL::Frame(rotation, KDL::Vector(data(0), data(1), data(2)));
+            target_angles_ = current_angles_;
+            task_error_norm_ = std::numeric_limits<double>::infinity();
         }else{
             ROS_ERROR("Unimplemented position control mode!");
         }
@@ -154,16 +269,26 @@ void PositionController::configure_controller(OptionsMap &options)
 bool PositionController::is_finished() const
 {
     // Check whether we are close enough to the current target.
+    double epspos = 0.185;
+    double epsvel = 0.01;
     if (mode_ == gps::JOINT_SPACE){
-        double epspos = 0.185;
-        double epsvel = 0.01;
         double error = (current_angles_ - target_angles_).norm();
         double vel = current_angle_velocities_.norm();
         return (error < epspos && vel < epsvel);
     }
-    else if (mode_ == gps::NO_CONTROL){
-        return true;
+    else if (mode_ == gps::JOINT_SPACE_TRAJECTORY){
+        // The trajectory comes to rest at the target, so this settles quickly once it ends.
+        if (trajectory_pending_ || trajectory_elapsed_ < trajectory_.get_duration())
+            return false;
+        double error = (current_angles_ - target_angles_).norm();
+        double vel = current_angle_velocities_.norm();
+        return (error < epspos && vel < epsvel);
+    }
+    else if (mode_ == gps::TASK_SPACE){
+        double epstask = 0.01;
+        return (task_error_norm_ < epstask && current_angle_velocities_.norm() < epsvel);
     }
+    return true;
 }
 
 // Reset the controller -- this is typically called when the controller is turned on.
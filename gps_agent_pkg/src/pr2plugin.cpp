@@ -71,6 +71,10 @@ bool GPSPR2Plugin::init(pr2_mechanism_model::RobotState* robot, ros::NodeHandle&
     passive_arm_jac_solver_.reset(new KDL::ChainJntToJacSolver(passive_arm_fk_chain_));
     active_arm_jac_solver_.reset(new KDL::ChainJntToJacSolver(active_arm_fk_chain_));
 
+    // Inertia solvers, for feedforward on reset trajectories (gravity is left to the gains).
+    passive_arm_dyn_solver_.reset(new KDL::ChainDynParam(passive_arm_fk_chain_, KDL::Vector::Zero()));
+    active_arm_dyn_solver_.reset(new KDL::ChainDynParam(active_arm_fk_chain_, KDL::Vector::Zero()));
+
     // Pull out joint states.
     int joint_index;
 
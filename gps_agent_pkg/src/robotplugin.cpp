@@ -2,20 +2,16 @@
 #include "gps_agent_pkg/sensor.h"
 #include "gps_agent_pkg/controller.h"
 #include "gps_agent_pkg/positioncontroller.h"
-#include "gps_agent_pkg/lingausscontroller.h"
 #include "gps_agent_pkg/trialcontroller.h"
-#include "gps_agent_pkg/LinGaussParams.h"
+#include "gps_agent_pkg/trialcontrollerregistry.h"
 #include "gps_agent_pkg/tfcontroller.h"
-#include "gps_agent_pkg/TfParams.h"
 #include "gps_agent_pkg/ControllerParams.h"
 #include "gps_agent_pkg/util.h"
 #include "gps/proto/gps.pb.h"
 #include <vector>
 
-#ifdef USE_CAFFE
-#include "gps_agent_pkg/caffenncontroller.h"
-#include "gps_agent_pkg/CaffeParams.h"
-#endif
+// How long configure_sensors waits for the realtime loop to drain the sensors.
+#define SENSOR_FLUSH_TIMEOUT 1.0
 
 using namespace gps_control;
 
@@ -37,8 +33,9 @@ void RobotPlugin::initialize(ros::NodeHandle& n)
     ROS_INFO_STREAM("Initializing RobotPlugin");
     trial_data_request_waiting_ = false;
     aux_data_request_waiting_ = false;
-    sensors_initialized_ = false;
+    sensor_ownership_ = SensorsReleased;
     controller_initialized_ = false;
+    shadow_evaluator_retired_ = false;
 
     // Initialize all ROS communication infrastructure.
     initialize_ros(n);
@@ -73,6 +70,25 @@ void RobotPlugin::initialize_ros(ros::NodeHandle& n)
     //for async tf controller.
     action_subscriber_tf_ = n.subscribe("/gps_controller_sent_robot_action_tf", 1, &RobotPlugin::tf_robot_action_command_callback, this);
     tf_publisher_.reset(new realtime_tools::RealtimePublisher<gps_agent_pkg::TfObsData>(n, "/gps_obs_tf", 1));
+
+    // Local policy processes can exchange observations and actions through shared memory instead.
+    std::string shm_name;
+    if (n.getParam("shm_transport", shm_name) && !shm_name.empty())
+    {
+        int obs_capacity, action_capacity;
+        if (!n.getParam("shm_obs_capacity", obs_capacity))
+            obs_capacity = 4096;
+        if (!n.getParam("shm_action_capacity", action_capacity))
+            action_capacity = 1024;
+        shm_transport_.reset(new ShmTransport(shm_name, obs_capacity, action_capacity));
+        if (!shm_transport_->is_open())
+            shm_transport_.reset();
+        // The arm's torques are sized before initialize, so the chunk buffer can
+        // be allocated once here, with room for the longest chunk that fits.
+        int dU = active_arm_torques_.size();
+        if (dU > 0)
+            shm_action_commands_.setZero(dU, action_capacity/dU);
+    }
 }
 
 // Initialize all sensors.
@@ -81,16 +97,27 @@ void RobotPlugin::initialize_sensors(ros::NodeHandle& n)
     // Clear out the old sensors.
     sensors_.clear();
 
+    // Image features come either from a topic or from the native extractor in the camera sensor.
+    bool native_image_features;
+    if (!n.getParam("native_image_features", native_image_features))
+        native_image_features = false;
+
     // Create all sensors.
     for (int i = 0; i < 2; i++)
     // TODO: ZDM: read this when more sensors work
     //for (int i = 0; i < TotalSensorTypes; i++)
     {
-        ROS_INFO_STREAM("creating sensor: " + to_string(i));
-        boost::shared_ptr<Sensor> sensor(Sensor::create_sensor((SensorType)i,n,this, gps::TRIAL_ARM));
+        SensorType type = (SensorType)i;
+        if (type == ROSTopicSensorType && native_image_features)
+            type = CameraSensorType;
+        ROS_INFO_STREAM("creating sensor: " + to_string(type));
+        boost::shared_ptr<Sensor> sensor(Sensor::create_sensor(type,n,this, gps::TRIAL_ARM));
         sensors_.push_back(sensor);
     }
 
+    sensor_stale_.setZero(sensors_.size());
+    sensor_delay_.setZero(sensors_.size());
+
     // Create current state sample and populate it using the sensors.
     current_time_step_sample_.reset(new Sample(MAX_TRIAL_LENGTH));
     initialize_sample(current_time_step_sample_, gps::TRIAL_ARM);
@@ -104,36 +131,102 @@ void RobotPlugin::initialize_sensors(ros::NodeHandle& n)
         aux_sensors_.push_back(sensor);
     }
 
+    aux_sensor_stale_.setZero(aux_sensors_.size());
+    aux_sensor_delay_.setZero(aux_sensors_.size());
+
     // Create current state sample and populate it using the sensors.
     aux_current_time_step_sample_.reset(new Sample(1));
     initialize_sample(aux_current_time_step_sample_, gps::AUXILIARY_ARM);
 
-    sensors_initialized_ = true;
+    log_sensor_schedule(sensors_);
+    log_sensor_schedule(aux_sensors_);
+
+    initialize_sensor_jobs(n);
+
+    sensor_ownership_ = SensorsActive;
 }
 
+// Create the jobs and worker pool for the sensors that run asynchronously.
+void RobotPlugin::initialize_sensor_jobs(ros::NodeHandle& n)
+{
+    sensor_worker_pool_.reset();
+    int num_jobs = 0;
+    sensor_jobs_.assign(sensors_.size(), boost::shared_ptr<SensorJob>());
+    for (int i = 0; i < sensors_.size(); i++)
+    {
+        if (sensors_[i]->get_execution_mode() == SensorExecutionAsync)
+        {
+            sensor_jobs_[i].reset(new SensorJob(sensors_[i].get()));
+            sensors_[i]->set_stale(true); // No result until the first job is merged.
+            num_jobs++;
+        }
+    }
+    aux_sensor_jobs_.assign(aux_sensors_.size(), boost::shared_ptr<SensorJob>());
+    for (int i = 0; i < aux_sensors_.size(); i++)
+    {
+        if (aux_sensors_[i]->get_execution_mode() == SensorExecutionAsync)
+        {
+            aux_sensor_jobs_[i].reset(new SensorJob(aux_sensors_[i].get()));
+            aux_sensors_[i]->set_stale(true);
+            num_jobs++;
+        }
+    }
+    if (num_jobs == 0) return;
+
+    int num_workers;
+    if (!n.getParam("sensor_worker_threads", num_workers))
+        num_workers = 1;
+    ROS_INFO("starting %d sensor worker(s) for %d asynchronous sensor(s)", num_workers, num_jobs);
+    sensor_worker_pool_.reset(new SensorWorkerPool(num_workers, num_jobs));
+}
 
-// Helper method to configure all sensors
-void RobotPlugin::configure_sensors(OptionsMap &opts)
+
+// Helper method to configure all sensors. Returns false, leaving the sensors
+// untouched, if the realtime loop does not hand them over in time.
+bool RobotPlugin::configure_sensors(const SensorConfig &config)
 {
     ROS_INFO("configure sensors");
-    sensors_initialized_ = false;
+    // Workers must not be processing a snapshot while the sensors are resized,
+    // and the jobs belong to the realtime thread, so ask it to drain them and
+    // stop using the sensors.
+    int expected = SensorsActive;
+    if (sensor_ownership_.compare_exchange_strong(expected, SensorsReleaseRequested))
+    {
+        boost::chrono::steady_clock::time_point deadline = boost::chrono::steady_clock::now() +
+            boost::chrono::duration_cast<boost::chrono::steady_clock::duration>(
+                boost::chrono::duration<double>(SENSOR_FLUSH_TIMEOUT));
+        while (sensor_ownership_.load() != SensorsReleased && boost::chrono::steady_clock::now() < deadline)
+            boost::this_thread::sleep_for(boost::chrono::microseconds(100));
+        // On timeout, hand the sensors back. This fails only if the realtime
+        // loop released them in the meantime.
+        expected = SensorsReleaseRequested;
+        if (sensor_ownership_.compare_exchange_strong(expected, SensorsActive))
+        {
+            ROS_ERROR("Realtime loop did not release the sensors within %.1f s, is the controller running? Sensors not reconfigured.",
+                      SENSOR_FLUSH_TIMEOUT);
+            return false;
+        }
+    }
     for (int i = 0; i < sensors_.size(); i++)
     {
-        sensors_[i]->configure_sensor(opts);
+        sensors_[i]->configure_sensor(config);
         sensors_[i]->set_sample_data_format(current_time_step_sample_);
     }
     // Set sample data format on the actions, which are not handled by any sensor.
     OptionsMap sample_metadata;
     current_time_step_sample_->set_meta_data(
         gps::ACTION,active_arm_torques_.size(),SampleDataFormatEigenVector,sample_metadata);
+    set_sensor_status_format(sensors_.size(), current_time_step_sample_);
 
     // configure auxiliary sensors
     for (int i = 0; i < aux_sensors_.size(); i++)
     {
-        aux_sensors_[i]->configure_sensor(opts);
+        aux_sensors_[i]->configure_sensor(config);
         aux_sensors_[i]->set_sample_data_format(aux_current_time_step_sample_);
     }
-    sensors_initialized_ = true;
+    set_sensor_status_format(aux_sensors_.size(), aux_current_time_step_sample_);
+    sensor_ownership_.store(SensorsActive);
+    return true;
 }
 
 // Initialize position controllers.
@@ -160,6 +253,9 @@ void RobotPlugin::initialize_sample(boost::scoped_ptr<Sample>& sample, gps::Actu
         // Set sample data format on the actions, which are not handled by any sensor.
         OptionsMap sample_metadata;
         sample->set_meta_data(gps::ACTION,active_arm_torques_.size(),SampleDataFormatEigenVector,sample_metadata);
+        set_sensor_status_format(sensors_.size(), sample);
+        // Shadow actions are only reported by trials that set them up again.
+        sample->clear_meta_data(gps::SHADOW_ACTIONS);
     }
     else if (actuator_type == gps::AUXILIARY_ARM)
     {
@@ -167,34 +263,201 @@ void RobotPlugin::initialize_sample(boost::scoped_ptr<Sample>& sample, gps::Actu
         {
             aux_sensors_[i]->set_sample_data_format(sample);
         }
+        set_sensor_status_format(aux_sensors_.size(), sample);
     }
     ROS_INFO("set sample data format");
 }
 
+// Set the format of the per-sensor stale mask and input delay on a sample.
+void RobotPlugin::set_sensor_status_format(int num_sensors, boost::scoped_ptr<Sample>& sample)
+{
+    OptionsMap stale_metadata;
+    sample->set_meta_data(gps::SENSOR_STALE,num_sensors,SampleDataFormatEigenVector,stale_metadata);
+    OptionsMap delay_metadata;
+    sample->set_meta_data(gps::SENSOR_DELAY,num_sensors,SampleDataFormatEigenVector,delay_metadata);
+}
+
+// Write the stale mask and input delay of the sensors into a sample.
+void RobotPlugin::set_sensor_status_data(const std::vector<boost::shared_ptr<Sensor> > &sensors, Eigen::VectorXd &stale, Eigen::VectorXd &delay,
+                                         boost::scoped_ptr<Sample>& sample, int t, ros::Time current_time)
+{
+    for (int i = 0; i < sensors.size(); i++)
+    {
+        stale(i) = sensors[i]->is_stale() ? 1.0 : 0.0;
+        delay(i) = (current_time - sensors[i]->get_data_time(current_time)).toSec();
+    }
+    sample->set_data_vector(t,gps::SENSOR_STALE,stale.data(),stale.size(),SampleDataFormatEigenVector);
+    sample->set_data_vector(t,gps::SENSOR_DELAY,delay.data(),delay.size(),SampleDataFormatEigenVector);
+}
+
+// Check whether a sensor is due for an update on this tick.
+bool RobotPlugin::is_sensor_due(const boost::shared_ptr<Sensor> &sensor, bool is_controller_step) const
+{
+    switch (sensor->get_update_rate())
+    {
+    case SensorUpdateEveryTick:
+        return true;
+    case SensorUpdateControllerStep:
+        return is_controller_step;
+    case SensorUpdateNewData:
+        return sensor->has_new_data();
+    default:
+        ROS_ERROR("Unknown sensor update rate: %d", sensor->get_update_rate());
+        return true;
+    }
+}
+
+// Log the rate and expected cost of each sensor.
+void RobotPlugin::log_sensor_schedule(const std::vector<boost::shared_ptr<Sensor> > &sensors) const
+{
+    double tick_cost = 0.0;
+    for (int i = 0; i < sensors.size(); i++)
+    {
+        ROS_INFO("sensor %d: update rate %d, expected cost %.1f us", i,
+                 sensors[i]->get_update_rate(), 1e6*sensors[i]->get_update_cost());
+        if (sensors[i]->get_update_rate() == SensorUpdateEveryTick)
+            tick_cost += sensors[i]->get_update_cost();
+    }
+    ROS_INFO("expected per-tick sensor cost: %.1f us", 1e6*tick_cost);
+}
+
+// Merge the result of an asynchronous sensor job and submit its next snapshot.
+// This runs on controller steps: a job submitted at the previous controller
+// step is merged if it is done, otherwise its sensor is flagged stale and the
+// late result is dropped once it arrives.
+void RobotPlugin::merge_sensor_job(SensorJob &job, ros::Time current_time)
+{
+    if (job.in_flight)
+    {
+        if (!job.done.load(boost::memory_order_acquire))
+        {
+            if (!job.missed_deadline)
+            {
+                job.missed_deadline = true;
+                job.missed_deadlines++;
+                job.sensor->set_stale(true);
+            }
+            return; // Still running; try again at the next controller step.
+        }
+        job.in_flight = false;
+        if (!job.missed_deadline)
+        {
+            job.sensor->commit_snapshot();
+            job.sensor->set_stale(false);
+        }
+    }
+
+    // Capture and submit the next snapshot.
+    job.sensor->capture_snapshot(this, current_time);
+    job.missed_deadline = false;
+    if (sensor_worker_pool_->submit(&job))
+    {
+        job.in_flight = true;
+    }
+    else
+    {
+        job.missed_deadlines++;
+        job.sensor->set_stale(true);
+    }
+}
+
+// Drop the results of finished asynchronous sensor jobs.
+bool RobotPlugin::flush_sensor_jobs()
+{
+    bool idle = true;
+    std::vector<boost::shared_ptr<SensorJob> > *job_lists[2] = {&sensor_jobs_, &aux_sensor_jobs_};
+    for (int l = 0; l < 2; l++)
+    {
+        std::vector<boost::shared_ptr<SensorJob> > &jobs = *job_lists[l];
+        for (int i = 0; i < jobs.size(); i++)
+        {
+            if (jobs[i] == NULL || !jobs[i]->in_flight) continue;
+            if (!jobs[i]->done.load(boost::memory_order_acquire))
+            {
+                idle = false;
+                continue;
+            }
+            // The result belongs to the old configuration, so drop it.
+            jobs[i]->in_flight = false;
+            jobs[i]->missed_deadline = false;
+            jobs[i]->sensor->set_stale(true);
+        }
+    }
+    return idle;
+}
+
+// Log and clear the deadlines missed by asynchronous sensors.
+void RobotPlugin::report_missed_deadlines()
+{
+    for (int i = 0; i < sensor_jobs_.size(); i++)
+    {
+        if (sensor_jobs_[i] != NULL && sensor_jobs_[i]->missed_deadlines > 0)
+        {
+            ROS_WARN("asynchronous sensor %d missed %d controller step deadlines", i, sensor_jobs_[i]->missed_deadlines);
+            sensor_jobs_[i]->missed_deadlines = 0;
+        }
+    }
+    for (int i = 0; i < aux_sensor_jobs_.size(); i++)
+    {
+        if (aux_sensor_jobs_[i] != NULL && aux_sensor_jobs_[i]->missed_deadlines > 0)
+        {
+            ROS_WARN("asynchronous auxiliary sensor %d missed %d controller step deadlines", i, aux_sensor_jobs_[i]->missed_deadlines);
+            aux_sensor_jobs_[i]->missed_deadlines = 0;
+        }
+    }
+}
+
 // Update the sensors at each time step.
 void RobotPlugin::update_sensors(ros::Time current_time, bool is_controller_step)
 {
-    if (!sensors_initialized_) return; // Don't try to use sensors until initialization finishes.
+    int ownership = sensor_ownership_.load();
+    if (ownership == SensorsReleased) return; // Don't try to use sensors until initialization finishes.
 
-    // Update all of the sensors and fill in the sample.
-    for (int sensor = 0; sensor < sensors_.size(); sensor++)
+    // configure_sensors is waiting for the asynchronous jobs to drain. Hand the
+    // sensors over once none is in flight, unless it has given up waiting.
+    if (ownership == SensorsReleaseRequested)
     {
-        sensors_[sensor]->update(this, current_time, is_controller_step);
-        if (trial_controller_ != NULL){
-            sensors_[sensor]->set_sample_data(current_time_step_sample_,
-                trial_controller_->get_step_counter());
-        }
-        else {
-            sensors_[sensor]->set_sample_data(current_time_step_sample_, 0);
+        if (flush_sensor_jobs())
+        {
+            int expected = SensorsReleaseRequested;
+            sensor_ownership_.compare_exchange_strong(expected, SensorsReleased);
         }
+        return;
     }
 
-    // Update all of the auxiliary sensors and fill in the sample.
+    // The sample only changes on controller steps, so only write it then (or
+    // when a data request needs the current state). Between controller steps
+    // the sensors only do the work their update rate asks for.
+    bool write_sample = is_controller_step || trial_data_request_waiting_ ||
+        (trial_controller_ != NULL && trial_controller_->updates_every_tick());
+    int step = trial_controller_ != NULL ? trial_controller_->get_step_counter() : 0;
+
+    // Update all of the due sensors and fill in the sample.
+    for (int sensor = 0; sensor < sensors_.size(); sensor++)
+    {
+        if (is_sensor_due(sensors_[sensor], is_controller_step))
+            sensors_[sensor]->update(this, current_time, is_controller_step);
+        if (is_controller_step && sensor_jobs_[sensor] != NULL)
+            merge_sensor_job(*sensor_jobs_[sensor], current_time);
+        if (write_sample)
+            sensors_[sensor]->set_sample_data(current_time_step_sample_, step);
+    }
+    if (write_sample)
+        set_sensor_status_data(sensors_, sensor_stale_, sensor_delay_, current_time_step_sample_, step, current_time);
+
+    // Update all of the due auxiliary sensors and fill in the sample.
+    bool write_aux_sample = is_controller_step || aux_data_request_waiting_;
     for (int sensor = 0; sensor < aux_sensors_.size(); sensor++)
     {
-        aux_sensors_[sensor]->update(this, current_time, is_controller_step);
-        aux_sensors_[sensor]->set_sample_data(aux_current_time_step_sample_, 0);
+        if (is_sensor_due(aux_sensors_[sensor], is_controller_step))
+            aux_sensors_[sensor]->update(this, current_time, is_controller_step);
+        if (is_controller_step && aux_sensor_jobs_[sensor] != NULL)
+            merge_sensor_job(*aux_sensor_jobs_[sensor], current_time);
+        if (write_aux_sample)
+            aux_sensors_[sensor]->set_sample_data(aux_current_time_step_sample_, 0);
     }
+    if (write_aux_sample)
+        set_sensor_status_data(aux_sensors_, aux_sensor_stale_, aux_sensor_delay_, aux_current_time_step_sample_, 0, current_time);
 
     // If a data request is waiting, publish the sample.
     if (trial_data_request_waiting_) {
@@ -217,26 +480,58 @@ void RobotPlugin::update_controllers(ros::Time current_time, bool is_controller_
 
     bool trial_init = trial_controller_ != NULL && trial_controller_->is_configured() && controller_initialized_;
     if(!is_controller_step && trial_init){
+        // Controllers that act on every tick use the state the sensors just wrote.
+        if (trial_controller_->updates_every_tick())
+            trial_controller_->update_tick(this, current_time, current_time_step_sample_, active_arm_torques_);
         return;
     }
 
+    // Pick up actions sent through shared memory before acting.
+    if (trial_init && shm_transport_) tf_poll_shm_actions();
+
     // If we have a trial controller, update that, otherwise update position controller.
     if (trial_init) trial_controller_->update(this, current_time, current_time_step_sample_, active_arm_torques_);
     else active_arm_controller_->update(this, current_time, current_time_step_sample_, active_arm_torques_);
 
+    // Evaluate the shadow controllers on the step that was just taken.
+    if (trial_init && shadow_evaluator_)
+        shadow_evaluator_->evaluate(trial_controller_->get_step_counter()-1, current_time_step_sample_);
+
     // Check if the trial controller finished and delete it.
     if (trial_init && trial_controller_->is_finished()) {
 
+        // Collect the last shadow actions.
+        if (shadow_evaluator_)
+        {
+            shadow_evaluator_->finish(current_time_step_sample_);
+            if (shadow_evaluator_->get_missed_steps() > 0)
+                ROS_WARN("shadow controllers skipped %d steps", shadow_evaluator_->get_missed_steps());
+        }
+
         // Publish sample after trial completion
         publish_sample_report(current_time_step_sample_, trial_controller_->get_trial_length());
+        report_missed_deadlines();
+        trial_controller_->report_statistics();
         //Clear the trial controller.
         trial_controller_->reset(current_time);
         trial_controller_.reset(NULL);
+        // The evaluator may still have a job in flight, and destroying it
+        // joins its worker, so leave that to the ROS thread.
+        if (shadow_evaluator_ && !shadow_evaluator_retired_.load())
+        {
+            retired_shadow_evaluator_.swap(shadow_evaluator_);
+            shadow_evaluator_retired_.store(true);
+        }
+        else if (shadow_evaluator_)
+        {
+            ROS_WARN("previous shadow evaluator was never destroyed, destroying this one on the realtime thread");
+            shadow_evaluator_.reset();
+        }
 
         // Set the active arm controller to NO_CONTROL.
-        OptionsMap options;
-        options["mode"] = gps::NO_CONTROL;
-        active_arm_controller_->configure_controller(options);
+        PositionControllerConfig config;
+        config.mode = gps::NO_CONTROL;
+        active_arm_controller_->configure(config);
 
         // Switch the sensors to run at full frequency.
         for (int sensor = 0; sensor < TotalSensorTypes; sensor++)
@@ -295,37 +590,43 @@ void RobotPlugin::publish_sample_report(boost::scoped_ptr<Sample>& sample, int T
 void RobotPlugin::position_subscriber_callback(const gps_agent_pkg::PositionCommand::ConstPtr& msg){
 
     ROS_INFO_STREAM("received position command");
-    OptionsMap params;
+    PositionControllerConfig config;
     int8_t arm = msg->arm;
-    params["mode"] = msg->mode;
-    Eigen::VectorXd data;
-    data.resize(msg->data.size());
-    for(int i=0; i<data.size(); i++){
-        data[i] = msg->data[i];
+    config.mode = (gps::PositionControlMode) msg->mode;
+    config.data.resize(msg->data.size());
+    for(int i=0; i<config.data.size(); i++){
+        config.data[i] = msg->data[i];
     }
-    params["data"] = data;
 
-    Eigen::MatrixXd pd_gains;
-    pd_gains.resize(msg->pd_gains.size() / 4, 4);
-    for(int i=0; i<pd_gains.rows(); i++){
+    if (msg->pd_gains.size() % 4 != 0){
+        ROS_ERROR("Got %d pd_gains (must be multiple of 4)", (int)msg->pd_gains.size());
+    }
+    config.pd_gains.resize(msg->pd_gains.size() / 4, 4);
+    for(int i=0; i<config.pd_gains.rows(); i++){
         for(int j=0; j<4; j++){
-            pd_gains(i, j) = msg->pd_gains[i * 4 + j];
+            config.pd_gains(i, j) = msg->pd_gains[i * 4 + j];
         }
     }
-    params["pd_gains"] = pd_gains;
 
     if(arm == gps::TRIAL_ARM){
-        active_arm_controller_->configure_controller(params);
+        active_arm_controller_->configure(config);
     }else if (arm == gps::AUXILIARY_ARM){
-        passive_arm_controller_->configure_controller(params);
+        passive_arm_controller_->configure(config);
     }else{
         ROS_ERROR("Unknown position controller arm type");
     }
 }
 
+// Create and configure a trial controller from its parameters. trial holds the
+// settings shared by all controllers of the trial (such as the datatypes).
+TrialController *RobotPlugin::create_trial_controller(const gps_agent_pkg::ControllerParams &params, const TrialControllerConfig &trial, double frequency)
+{
+    // Each controller registers its own factory (see trialcontrollerregistry.h).
+    return TrialControllerRegistry::create(params, trial, frequency);
+}
+
 void RobotPlugin::trial_subscriber_callback(const gps_agent_pkg::TrialCommand::ConstPtr& msg){
 
-    OptionsMap controller_params;
     ROS_INFO_STREAM("received trial command");
 
     controller_initialized_ = false;
@@ -347,139 +648,79 @@ void RobotPlugin::trial_subscriber_callback(const gps_agent_pkg::TrialCommand::C
         sensors_[sensor]->set_update(1.0/frequency);
     }
 
-    std::vector<int> state_datatypes, obs_datatypes;
-    state_datatypes.resize(msg->state_datatypes.size());
-    for(int i=0; i<state_datatypes.size(); i++){
-        state_datatypes[i] = msg->state_datatypes[i];
-    }
-    controller_params["state_datatypes"] = state_datatypes;
-    obs_datatypes.resize(msg->obs_datatypes.size());
-    for(int i=0; i<obs_datatypes.size(); i++){
-        obs_datatypes[i] = msg->obs_datatypes[i];
-    }
-    controller_params["obs_datatypes"] = obs_datatypes;
-
-    if(msg->controller.controller_to_execute == gps::LIN_GAUSS_CONTROLLER){
-        //
-        gps_agent_pkg::LinGaussParams lingauss = msg->controller.lingauss;
-        trial_controller_.reset(new LinearGaussianController());
-        int dX = (int) lingauss.dX;
-        int dU = (int) lingauss.dU;
-        //Prepare options map
-        controller_params["T"] = (int)msg->T;
-        controller_params["dX"] = dX;
-        controller_params["dU"] = dU;
-        for(int t=0; t<(int)msg->T; t++){
-            Eigen::MatrixXd K;
-            K.resize(dU, dX);
-            for(int u=0; u<dU; u++){
-                for(int x=0; x<dX; x++){
-                    K(u,x) = lingauss.K_t[x+u*dX+t*dU*dX];
-                }
-            }
-            Eigen::VectorXd k;
-            k.resize(dU);
-            for(int u=0; u<dU; u++){
-                k(u) = lingauss.k_t[u+t*dU];
-            }
-            controller_params["K_"+to_string(t)] = K;
-            controller_params["k_"+to_string(t)] = k;
-        }
-        trial_controller_->configure_controller(controller_params);
+    TrialControllerConfig trial;
+    trial.T = (int)msg->T;
+    trial.state_datatypes.resize(msg->state_datatypes.size());
+    for(int i=0; i<trial.state_datatypes.size(); i++){
+        trial.state_datatypes[i] = (gps::SampleType) msg->state_datatypes[i];
+    }
+    trial.obs_datatypes.resize(msg->obs_datatypes.size());
+    for(int i=0; i<trial.obs_datatypes.size(); i++){
+        trial.obs_datatypes[i] = (gps::SampleType) msg->obs_datatypes[i];
     }
-#ifdef USE_CAFFE
-    else if (msg->controller.controller_to_execute == gps::CAFFE_CONTROLLER) {
-        gps_agent_pkg::CaffeParams params = msg->controller.caffe;
-        trial_controller_.reset(new CaffeNNController());
-
-        // TODO(chelsea/zoe): put this somewhere else.
-        int dim_bias = params.dim_bias;
-        Eigen::MatrixXd scale;
-        scale.resize(dim_bias, dim_bias);
-        Eigen::VectorXd bias;
-        bias.resize(dim_bias);
 
-        int dU = (int) params.dU;
+    trial_controller_.reset(create_trial_controller(msg->controller, trial, frequency));
 
-        int idx = 0;
-        // Unpack the scale matrix
-        for (int j = 0; j < dim_bias; ++j)
-        {
-            for (int i = 0; i < dim_bias; ++i)
-            {
-                scale(i,j) = params.scale[idx];
-                idx++;
-            }
-        }
-
-        idx = 0;
-        // Unpack the bias vector
-        for (int i = 0; i < dim_bias; ++i)
+    // Shadow controllers are evaluated on the visited states without acting.
+    // Also destroy the evaluator the realtime thread retired after the last trial.
+    shadow_evaluator_.reset();
+    if (shadow_evaluator_retired_.load())
+    {
+        retired_shadow_evaluator_.reset();
+        shadow_evaluator_retired_.store(false);
+    }
+    if (!msg->shadow_controllers.empty())
+    {
+        std::vector<boost::shared_ptr<TrialController> > shadows;
+        int dU = active_arm_torques_.size();
+        for (int i = 0; i < msg->shadow_controllers.size(); i++)
         {
-            bias(i) = params.bias[idx];
-            idx++;
-        }
-
-        for(int t=0; t<(int)msg->T; t++){
-            Eigen::VectorXd noise;
-            noise.resize(dU);
-            for(int u=0; u<dU; u++){
-                noise(u) = params.noise[u+t*dU];
+            boost::shared_ptr<TrialController> shadow(create_trial_controller(msg->shadow_controllers[i], trial, frequency));
+            // The backend may be picked by name, so check the created type.
+            if (dynamic_cast<TfController*>(shadow.get())) {
+                ROS_ERROR("tf controllers cannot be used as shadow controllers, skipping shadow %d", i);
+                continue;
             }
-            controller_params["noise_"+to_string(t)] = noise;
+            if (shadow) shadows.push_back(shadow);
         }
- 
-        controller_params["net_param"] = params.net_param;
-        controller_params["scale"] = scale;
-        controller_params["bias"] = bias;
-        controller_params["T"] = (int)msg->T;
-        trial_controller_->configure_controller(controller_params);
-    }
-#endif
-    else if (msg->controller.controller_to_execute == gps::TF_CONTROLLER) {
-        trial_controller_.reset(new TfController());
-        controller_params["T"] = (int)msg->T;
-        gps_agent_pkg::TfParams tfparams = msg->controller.tf;
-        int dU = (int) tfparams.dU;
-        controller_params["dU"] = dU;
-        trial_controller_-> configure_controller(controller_params);
-    }
-    else{
-        ROS_ERROR("Unknown trial controller arm type and/or USE_CAFFE=0");
+        shadow_evaluator_.reset(new ShadowEvaluator(shadows, trial.state_datatypes, trial.obs_datatypes, dU, msg->async_shadow_controllers));
+        shadow_evaluator_->set_sample_data_format(current_time_step_sample_);
     }
 
     // Configure sensor for trial
-    OptionsMap sensor_params;
+    SensorConfig sensor_config;
 
     // Feed EE points/sites to sensors
-    Eigen::MatrixXd ee_points;
     if( msg->ee_points.size() % 3 != 0){
         ROS_ERROR("Got %d ee_points (must be multiple of 3)", (int)msg->ee_points.size());
     }
     int n_points = msg->ee_points.size()/3;
-    ee_points.resize(n_points, 3);
+    sensor_config.ee_sites.resize(n_points, 3);
     for(int i=0; i<n_points; i++){
         for(int j=0; j<3; j++){
-            ee_points(i, j) = msg->ee_points[j+3*i];
+            sensor_config.ee_sites(i, j) = msg->ee_points[j+3*i];
         }
     }
-    sensor_params["ee_sites"] = ee_points;
 
     // update end effector points target
-    Eigen::MatrixXd ee_points_tgt;
-    if( msg->ee_points_tgt.size() != ee_points.size()){
+    sensor_config.ee_points_tgt.setZero(n_points, 3);
+    if( msg->ee_points_tgt.size() != msg->ee_points.size()){
         ROS_ERROR("Got %d ee_points_tgt (must match ee_points size: %d)",
                 (int)msg->ee_points_tgt.size(), (int)msg->ee_points.size());
     }
-    ee_points_tgt.resize(n_points, 3);
-    for(int i=0; i<n_points; i++){
-        for(int j=0; j<3; j++){
-            ee_points_tgt(i, j) = msg->ee_points_tgt[j+3*i];
+    else{
+        for(int i=0; i<n_points; i++){
+            for(int j=0; j<3; j++){
+                sensor_config.ee_points_tgt(i, j) = msg->ee_points_tgt[j+3*i];
+            }
         }
     }
-    sensor_params["ee_points_tgt"] = ee_points_tgt;
 
-    configure_sensors(sensor_params);
+    if (!configure_sensors(sensor_config))
+    {
+        ROS_ERROR("Could not configure sensors, trial not started.");
+        return;
+    }
 
     controller_initialized_ = true;
 }
@@ -491,14 +732,14 @@ void RobotPlugin::test_callback(const std_msgs::Empty::ConstPtr& msg){
 void RobotPlugin::relax_subscriber_callback(const gps_agent_pkg::RelaxCommand::ConstPtr& msg){
 
     ROS_INFO_STREAM("received relax command");
-    OptionsMap params;
+    PositionControllerConfig config;
     int8_t arm = msg->arm;
-    params["mode"] = gps::NO_CONTROL;
+    config.mode = gps::NO_CONTROL;
 
     if(arm == gps::TRIAL_ARM){
-        active_arm_controller_->configure_controller(params);
+        active_arm_controller_->configure(config);
     }else if (arm == gps::AUXILIARY_ARM){
-        passive_arm_controller_->configure_controller(params);
+        passive_arm_controller_->configure(config);
     }else{
         ROS_ERROR("Unknown position controller arm type");
     }
@@ -542,6 +783,12 @@ Sensor *RobotPlugin::get_sensor(SensorType sensor, gps::ActuatorType actuator_ty
     }
 }
 
+// The trial controller reads the trial arm state on every tick if it updates every tick.
+bool RobotPlugin::needs_tick_state(gps::ActuatorType arm) const
+{
+    return arm == gps::TRIAL_ARM && trial_controller_ != NULL && trial_controller_->updates_every_tick();
+}
+
 // Get forward kinematics solver.
 void RobotPlugin::get_fk_solver(boost::shared_ptr<KDL::ChainFkSolverPos> &fk_solver, boost::shared_ptr<KDL::ChainJntToJacSolver> &jac_solver, gps::ActuatorType arm)
 {
@@ -561,32 +808,54 @@ void RobotPlugin::get_fk_solver(boost::shared_ptr<KDL::ChainFkSolverPos> &fk_sol
     }
 }
 
+// Get dynamics solver.
+boost::shared_ptr<KDL::ChainDynParam> RobotPlugin::get_dyn_solver(gps::ActuatorType arm)
+{
+    if (arm == gps::AUXILIARY_ARM)
+        return passive_arm_dyn_solver_;
+    return active_arm_dyn_solver_;
+}
+
 void RobotPlugin::tf_robot_action_command_callback(const gps_agent_pkg::TfActionCommand::ConstPtr& msg){
 
     bool trial_init = trial_controller_ != NULL && trial_controller_->is_configured();
     if(trial_init){
-        // Unpack the action vector
-        int idx = 0;
+        // Unpack the action chunk (one action per step, dU entries each).
         int dU = (int)msg->dU;
-        Eigen::VectorXd latest_action_command;
-        latest_action_command.resize(dU);
-        for (int i = 0; i < dU; ++i)
+        int horizon = std::max((int)msg->horizon, 1);
+        if (dU <= 0 || msg->action.size() < dU*horizon) {
+            ROS_ERROR("tf action command %d has %d entries, expected %d", msg->id, (int)msg->action.size(), dU*horizon);
+            return;
+        }
+        Eigen::MatrixXd action_commands(dU, horizon);
+        for (int t = 0; t < horizon; ++t)
         {
-            latest_action_command[i] = msg->action[i];
-            idx++;
+            for (int i = 0; i < dU; ++i)
+                action_commands(i,t) = msg->action[i+t*dU];
         }
-        int last_command_id_received = msg ->id;
-        trial_controller_->update_action_command(last_command_id_received, latest_action_command);
+        trial_controller_->update_action_command(msg->id, msg->obs_step, msg->start_step, action_commands);
 
     }
 
 }
 
-void RobotPlugin::tf_publish_obs(Eigen::VectorXd obs){
+void RobotPlugin::tf_publish_obs(int t, Eigen::VectorXd obs){
+    if (shm_transport_) {
+        shm_transport_->write_obs(t, obs);
+        return;
+    }
     while(!tf_publisher_->trylock());
+    tf_publisher_->msg_.step = t;
     tf_publisher_->msg_.data.resize(obs.size());
     for(int i=0; i<obs.size(); i++) {
         tf_publisher_->msg_.data[i] = obs[i];
     }
     tf_publisher_->unlockAndPublish();
 }
+
+// Poll the shared-memory transport for a new action chunk.
+void RobotPlugin::tf_poll_shm_actions(){
+    int id, obs_step, start_step, horizon;
+    if (shm_transport_->read_actions(id, obs_step, start_step, horizon, shm_action_commands_))
+        trial_controller_->update_action_command(id, obs_step, start_step, shm_action_commands_.leftCols(horizon));
+}
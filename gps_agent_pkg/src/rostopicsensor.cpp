@@ -13,6 +13,7 @@ ROSTopicSensor::ROSTopicSensor(ros::NodeHandle& n, RobotPlugin *plugin): Sensor(
     data_size_ = 64;
     latest_data_.resize(data_size_);
     latest_data_eigen_.resize(data_size_);
+    new_data_ = false;
     subscriber_ = n.subscribe(topic_name_, 1, &ROSTopicSensor::update_data_vector, this);
 }
 // Destructor.
@@ -39,17 +40,28 @@ void ROSTopicSensor::update_data_vector(const std_msgs::Float64MultiArray::Const
 	    latest_data_[i] = msg->data[i];
 	    latest_data_eigen_[i] = msg->data[i];
 	}
+    new_data_ = true;
 }
 // Update the sensor (called every tick).
 void ROSTopicSensor::update(RobotPlugin *plugin, ros::Time current_time, bool is_controller_step)
 {
-    // Not needed for this sensor, since callback function is used.
+    // The data itself is copied in the callback; just mark it as consumed.
+    new_data_ = false;
+}
+// Only update when the subscriber received a new message.
+SensorUpdateRate ROSTopicSensor::get_update_rate() const
+{
+    return SensorUpdateNewData;
+}
+// Check whether a new message arrived since the last update.
+bool ROSTopicSensor::has_new_data() const
+{
+    return new_data_;
 }
 // The settings include the configuration for the Kalman filter.
-void ROSTopicSensor::configure_sensor(OptionsMap &options)
+void ROSTopicSensor::configure_sensor(const SensorConfig &config)
 {
     ROS_INFO("configuring rostopicsensor");
-    //data_size_ = boost::get<int>(options["data_size"]); // Maybe just set this my size of first sample?
 }
 // Set data format and meta data on the provided sample.
 void ROSTopicSensor::set_sample_data_format(boost::scoped_ptr<Sample>& sample) 
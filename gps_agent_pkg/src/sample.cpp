@@ -95,6 +95,15 @@ void Sample::set_meta_data(gps::SampleType type, int data_size_rows, int data_si
     return;
 }
 
+void Sample::clear_meta_data(gps::SampleType type)
+{
+    int type_key = (int) type;
+    internal_data_size_[type_key] = -1;
+    meta_data_[type_key] = OptionsMap();
+    for (int t = 0; t < T_; t++)
+        internal_data_[type][t] = SampleVariant();
+}
+
 void Sample::get_available_dtypes(std::vector<gps::SampleType> &types){
     for(int i=0; i<gps::TOTAL_DATA_TYPES; i++){
         if(internal_data_size_[i] != -1){
@@ -1,6 +1,7 @@
 #include "gps_agent_pkg/sensor.h"
 #include "gps_agent_pkg/encodersensor.h"
 #include "gps_agent_pkg/rostopicsensor.h"
+#include "gps_agent_pkg/camerasensor.h"
 
 using namespace gps_control;
 
@@ -11,10 +12,8 @@ Sensor* Sensor::create_sensor(SensorType type, ros::NodeHandle& n, RobotPlugin *
     {
     case EncoderSensorType:
         return (Sensor *) (new EncoderSensor(n,plugin,actuator_type));
-    /*
     case CameraSensorType:
-        return CameraSensor(n,plugin);
-    */
+        return (Sensor *) (new CameraSensor(n,plugin));
     case ROSTopicSensorType:
 	return (Sensor *) (new ROSTopicSensor(n,plugin));
 
@@ -27,7 +26,9 @@ Sensor* Sensor::create_sensor(SensorType type, ros::NodeHandle& n, RobotPlugin *
 // Constructor.
 Sensor::Sensor(ros::NodeHandle& n, RobotPlugin *plugin)
 {
-    // Nothing to do.
+    // Not known until set_update is called for a trial.
+    sensor_step_length_ = 0.0;
+    is_stale_ = false;
 }
 
 // Destructor.
@@ -54,8 +55,112 @@ void Sensor::set_update(double new_sensor_step_length)
     sensor_step_length_ = new_sensor_step_length;
 }
 
+// Get the rate at which this sensor needs to be updated.
+SensorUpdateRate Sensor::get_update_rate() const
+{
+    return SensorUpdateEveryTick;
+}
+
+// Get the expected cost of one update, in seconds.
+double Sensor::get_update_cost() const
+{
+    return 0.0;
+}
+
+// Check whether new data has arrived since the last update.
+bool Sensor::has_new_data() const
+{
+    return true;
+}
+
+// Get the execution mode of this sensor.
+SensorExecutionMode Sensor::get_execution_mode() const
+{
+    return SensorExecutionInline;
+}
+
+// Capture the raw inputs for asynchronous processing.
+void Sensor::capture_snapshot(RobotPlugin *plugin, ros::Time current_time)
+{
+    // Nothing to do.
+}
+
+// Compute the derived outputs from the captured inputs.
+void Sensor::process_snapshot()
+{
+    // Nothing to do.
+}
+
+// Make the processed outputs visible to set_sample_data.
+void Sensor::commit_snapshot()
+{
+    // Nothing to do.
+}
+
+// Flag the sensor data as stale (or fresh).
+void Sensor::set_stale(bool is_stale)
+{
+    is_stale_ = is_stale;
+}
+
+// Check whether the sensor data is stale.
+bool Sensor::is_stale() const
+{
+    return is_stale_;
+}
+
+// Get the time at which the inputs behind the sensor data were captured.
+ros::Time Sensor::get_data_time(ros::Time current_time) const
+{
+    return current_time;
+}
+
+// Attach a decimation stage to a data type.
+void Sensor::attach_decimator(gps::SampleType type, SensorDecimator *decimator)
+{
+    // The factory returns NULL for invalid rates; leave the data type undecimated.
+    if (decimator == NULL) {
+        ROS_ERROR("No decimator to attach to data type %d", type);
+        return;
+    }
+    decimators_[type].reset(decimator);
+}
+
+// Feed a raw reading of a data type into its decimation stage.
+void Sensor::push_decimated(gps::SampleType type, const double *data)
+{
+    std::map<gps::SampleType, boost::shared_ptr<SensorDecimator> >::iterator it = decimators_.find(type);
+    if (it == decimators_.end()) {
+        ROS_ERROR("No decimator attached to data type %d", type);
+        return;
+    }
+    it->second->push(data);
+}
+
+// Set data format and meta data for all decimated data types.
+void Sensor::set_decimated_sample_data_format(boost::scoped_ptr<Sample>& sample)
+{
+    std::map<gps::SampleType, boost::shared_ptr<SensorDecimator> >::iterator it;
+    for (it = decimators_.begin(); it != decimators_.end(); ++it)
+    {
+        OptionsMap metadata;
+        sample->set_meta_data(it->first,it->second->get_num_channels(),SampleDataFormatEigenVector,metadata);
+    }
+}
+
+// Write the filtered value of all decimated data types into the sample.
+void Sensor::set_decimated_sample_data(boost::scoped_ptr<Sample>& sample, int t)
+{
+    std::map<gps::SampleType, boost::shared_ptr<SensorDecimator> >::iterator it;
+    for (it = decimators_.begin(); it != decimators_.end(); ++it)
+    {
+        const Eigen::VectorXd &output = it->second->get_output();
+        sample->set_data_vector(t,it->first,const_cast<double*>(output.data()),output.size(),SampleDataFormatEigenVector);
+    }
+}
+
 // Configure the sensor (for sensor-specific trial settings).
-void Sensor::configure_sensor(OptionsMap &options)
+void Sensor::configure_sensor(const SensorConfig &config)
 {
     // Nothing to do.
 }
@@ -0,0 +1,181 @@
+#include "gps_agent_pkg/sensordecimator.h"
+#include <ros/ros.h>
+#include <math.h>
+
+using namespace gps_control;
+
+// Factory function.
+SensorDecimator* SensorDecimator::create_decimator(SensorDecimatorType type, int num_channels, double input_rate, double output_rate)
+{
+    // The low-pass designs below only make sense when the rate actually drops.
+    if (!(input_rate > 0.0 && output_rate > 0.0 && output_rate < input_rate))
+    {
+        ROS_ERROR("Cannot decimate from %f Hz to %f Hz!", input_rate, output_rate);
+        return NULL;
+    }
+    // Cut off at the Nyquist frequency of the output, as a fraction of the input rate.
+    double cutoff = 0.5*output_rate/input_rate;
+    switch (type)
+    {
+    case FIRDecimatorType:
+    {
+        // Four taps per decimated sample keeps the transition band narrow.
+        int num_taps = 4*(int)ceil(input_rate/output_rate) + 1;
+        return new FIRDecimator(num_channels, FIRDecimator::design_lowpass(num_taps, cutoff));
+    }
+    case IIRDecimatorType:
+        return new IIRDecimator(num_channels, IIRDecimator::design_lowpass(4, cutoff));
+    default:
+        ROS_ERROR("Unknown decimator type %i requested from decimator constructor!", type);
+        return NULL;
+    }
+}
+
+// Constructor.
+SensorDecimator::SensorDecimator(int num_channels)
+{
+    num_channels_ = num_channels;
+    output_.setZero(num_channels);
+}
+
+// Destructor.
+SensorDecimator::~SensorDecimator()
+{
+    // Nothing to do.
+}
+
+// Get the number of channels.
+int SensorDecimator::get_num_channels() const
+{
+    return num_channels_;
+}
+
+// Constructor.
+FIRDecimator::FIRDecimator(int num_channels, const Eigen::VectorXd &taps)
+: SensorDecimator(num_channels)
+{
+    reversed_taps_ = taps.reverse();
+    history_.setZero(num_channels, 2*taps.size());
+    head_ = 0;
+}
+
+// Destructor.
+FIRDecimator::~FIRDecimator()
+{
+    // Nothing to do.
+}
+
+// Reset the filter to a steady state at the given value.
+void FIRDecimator::reset(const Eigen::VectorXd &value)
+{
+    history_.colwise() = value;
+    head_ = 0;
+}
+
+// Add one raw reading.
+void FIRDecimator::push(const double *data)
+{
+    const int num_taps = reversed_taps_.size();
+    Eigen::Map<const Eigen::VectorXd> reading(data, num_channels_);
+    history_.col(head_) = reading;
+    history_.col(head_ + num_taps) = reading;
+    head_ = (head_ + 1) % num_taps;
+}
+
+// Get the filtered value at the current time.
+const Eigen::VectorXd &FIRDecimator::get_output()
+{
+    output_.noalias() = history_.middleCols(head_, reversed_taps_.size())*reversed_taps_;
+    return output_;
+}
+
+// Design a windowed-sinc low-pass with unit DC gain.
+Eigen::VectorXd FIRDecimator::design_lowpass(int num_taps, double cutoff)
+{
+    Eigen::VectorXd taps(num_taps);
+    double center = 0.5*(num_taps - 1);
+    for (int i = 0; i < num_taps; i++)
+    {
+        double x = i - center;
+        double sinc = x == 0.0 ? 2.0*cutoff : sin(2.0*M_PI*cutoff*x)/(M_PI*x);
+        double window = num_taps > 1 ? 0.54 - 0.46*cos(2.0*M_PI*i/(num_taps - 1)) : 1.0;
+        taps(i) = sinc*window;
+    }
+    return taps/taps.sum();
+}
+
+// Constructor.
+IIRDecimator::IIRDecimator(int num_channels, const Eigen::MatrixXd &sections)
+: SensorDecimator(num_channels)
+{
+    if (sections.cols() != 5)
+        ROS_ERROR("IIR decimator sections must have 5 coefficients, got %d", (int)sections.cols());
+    sections_ = sections;
+    state_.setZero(num_channels, 2*sections.rows());
+    section_input_.setZero(num_channels);
+}
+
+// Destructor.
+IIRDecimator::~IIRDecimator()
+{
+    // Nothing to do.
+}
+
+// Reset the filter to a steady state at the given value.
+void IIRDecimator::reset(const Eigen::VectorXd &value)
+{
+    // For a constant input x and output y, z1 = y - b0 x and z2 = b2 x - a2 y.
+    section_input_ = value.array();
+    for (int s = 0; s < sections_.rows(); s++)
+    {
+        const double b0 = sections_(s,0), b1 = sections_(s,1), b2 = sections_(s,2);
+        const double a1 = sections_(s,3), a2 = sections_(s,4);
+        double dc_gain = (b0 + b1 + b2)/(1.0 + a1 + a2);
+        state_.col(2*s) = section_input_*(dc_gain - b0);
+        state_.col(2*s+1) = section_input_*(b2 - a2*dc_gain);
+        section_input_ *= dc_gain;
+    }
+    output_ = section_input_.matrix();
+}
+
+// Add one raw reading.
+void IIRDecimator::push(const double *data)
+{
+    section_input_ = Eigen::Map<const Eigen::ArrayXd>(data, num_channels_);
+    for (int s = 0; s < sections_.rows(); s++)
+    {
+        const double b0 = sections_(s,0), b1 = sections_(s,1), b2 = sections_(s,2);
+        const double a1 = sections_(s,3), a2 = sections_(s,4);
+        output_.array() = b0*section_input_ + state_.col(2*s);
+        state_.col(2*s) = b1*section_input_ - a1*output_.array() + state_.col(2*s+1);
+        state_.col(2*s+1) = b2*section_input_ - a2*output_.array();
+        section_input_ = output_.array();
+    }
+}
+
+// Get the filtered value at the current time.
+const Eigen::VectorXd &IIRDecimator::get_output()
+{
+    return output_;
+}
+
+// Design an even-order Butterworth low-pass as biquad sections.
+Eigen::MatrixXd IIRDecimator::design_lowpass(int order, double cutoff)
+{
+    int num_sections = order/2;
+    Eigen::MatrixXd sections(num_sections, 5);
+    // Bilinear transform of each conjugate pole pair (RBJ low-pass biquads).
+    double w0 = 2.0*M_PI*cutoff;
+    for (int s = 0; s < num_sections; s++)
+    {
+        double q = 1.0/(2.0*cos(M_PI*(2.0*s + 1.0)/(2.0*order)));
+        double alpha = sin(w0)/(2.0*q);
+        double a0 = 1.0 + alpha;
+        sections(s,0) = 0.5*(1.0 - cos(w0))/a0;
+        sections(s,1) = (1.0 - cos(w0))/a0;
+        sections(s,2) = sections(s,0);
+        sections(s,3) = -2.0*cos(w0)/a0;
+        sections(s,4) = (1.0 - alpha)/a0;
+    }
+    return sections;
+}
@@ -0,0 +1,68 @@
+#include "gps_agent_pkg/sensorworkerpool.h"
+#include "gps_agent_pkg/sensor.h"
+
+using namespace gps_control;
+
+// Constructor.
+SensorJob::SensorJob(Sensor *job_sensor)
+: sensor(job_sensor), done(false), in_flight(false), missed_deadline(false), missed_deadlines(0)
+{
+}
+
+// Destructor.
+SensorJob::~SensorJob()
+{
+}
+
+// Process the snapshot.
+void SensorJob::process()
+{
+    sensor->process_snapshot();
+}
+
+// Constructor.
+SensorWorkerPool::SensorWorkerPool(int num_workers, int capacity)
+: jobs_(capacity), running_(true), num_workers_(num_workers)
+{
+    sem_init(&jobs_available_, 0, 0);
+    for (int i = 0; i < num_workers_; i++)
+        workers_.create_thread(boost::bind(&SensorWorkerPool::worker_loop, this));
+}
+
+// Destructor.
+SensorWorkerPool::~SensorWorkerPool()
+{
+    running_.store(false);
+    for (int i = 0; i < num_workers_; i++)
+        sem_post(&jobs_available_);
+    workers_.join_all();
+    sem_destroy(&jobs_available_);
+}
+
+// Submit a job.
+bool SensorWorkerPool::submit(SensorJob *job)
+{
+    job->done.store(false, boost::memory_order_relaxed);
+    if (!jobs_.bounded_push(job))
+        return false;
+    sem_post(&jobs_available_);
+    return true;
+}
+
+// Worker thread main loop.
+void SensorWorkerPool::worker_loop()
+{
+    while (true)
+    {
+        if (sem_wait(&jobs_available_) != 0)
+            continue; // Interrupted by a signal.
+        if (!running_.load())
+            return;
+        SensorJob *job;
+        if (jobs_.pop(job))
+        {
+            job->process();
+            job->done.store(true, boost::memory_order_release);
+        }
+    }
+}
@@ -0,0 +1,117 @@
+#include "gps_agent_pkg/shadowevaluator.h"
+#include "gps_agent_pkg/sample.h"
+#include <limits>
+
+using namespace gps_control;
+
+// Constructor.
+ShadowJob::ShadowJob(ShadowEvaluator *job_evaluator)
+: SensorJob(NULL), evaluator(job_evaluator)
+{
+}
+
+// Evaluate the shadow controllers.
+void ShadowJob::process()
+{
+    evaluator->compute();
+}
+
+// Constructor.
+ShadowEvaluator::ShadowEvaluator(const std::vector<boost::shared_ptr<TrialController> > &controllers,
+                                 const std::vector<gps::SampleType> &state_datatypes,
+                                 const std::vector<gps::SampleType> &obs_datatypes, int dU, bool async)
+: controllers_(controllers), state_datatypes_(state_datatypes), obs_datatypes_(obs_datatypes),
+  dU_(dU), step_(0), job_(this), missed_steps_(0)
+{
+    actions_.setZero(dU_*controllers_.size());
+    controller_action_.setZero(dU_);
+    missed_actions_.setConstant(actions_.size(), std::numeric_limits<double>::quiet_NaN());
+    if (async)
+        worker_.reset(new SensorWorkerPool(1, 1));
+}
+
+// Destructor (on the ROS thread, see RobotPlugin::update_controllers).
+ShadowEvaluator::~ShadowEvaluator()
+{
+    while (job_.in_flight && !job_.done.load(boost::memory_order_acquire))
+        boost::this_thread::sleep_for(boost::chrono::microseconds(100));
+}
+
+// Set the SHADOW_ACTIONS data format on the sample.
+void ShadowEvaluator::set_sample_data_format(boost::scoped_ptr<Sample>& sample)
+{
+    OptionsMap shadow_metadata;
+    sample->set_meta_data(gps::SHADOW_ACTIONS,actions_.size(),SampleDataFormatEigenVector,shadow_metadata);
+}
+
+// Evaluate all shadow controllers on the snapshot.
+void ShadowEvaluator::compute()
+{
+    for (int i = 0; i < controllers_.size(); i++)
+    {
+        controllers_[i]->get_action(step_, X_, obs_, controller_action_);
+        actions_.segment(i*dU_, dU_) = controller_action_;
+    }
+}
+
+// Write the actions of the evaluated step into the sample.
+void ShadowEvaluator::write_actions(boost::scoped_ptr<Sample>& sample)
+{
+    sample->set_data_vector(step_,gps::SHADOW_ACTIONS,actions_.data(),actions_.size(),SampleDataFormatEigenVector);
+}
+
+// Mark step t as not evaluated in the sample.
+void ShadowEvaluator::write_missed_step(int t, boost::scoped_ptr<Sample>& sample)
+{
+    missed_steps_++;
+    sample->set_data_vector(t,gps::SHADOW_ACTIONS,missed_actions_.data(),missed_actions_.size(),SampleDataFormatEigenVector);
+}
+
+// Evaluate the shadow controllers on step t.
+void ShadowEvaluator::evaluate(int t, boost::scoped_ptr<Sample>& sample)
+{
+    if (worker_ && job_.in_flight)
+    {
+        if (!job_.done.load(boost::memory_order_acquire))
+        {
+            // Still busy with an earlier step: skip this one.
+            write_missed_step(t, sample);
+            return;
+        }
+        job_.in_flight = false;
+        write_actions(sample);
+    }
+
+    step_ = t;
+    sample->get_data(t, X_, state_datatypes_);
+    sample->get_data(t, obs_, obs_datatypes_);
+    if (!worker_)
+    {
+        compute();
+        write_actions(sample);
+    }
+    else if (worker_->submit(&job_))
+    {
+        job_.in_flight = true;
+    }
+}
+
+// Write the actions of the last evaluation, or give up on its step if the
+// worker is still busy. The job stays in flight until the destructor.
+void ShadowEvaluator::finish(boost::scoped_ptr<Sample>& sample)
+{
+    if (!job_.in_flight) return;
+    if (!job_.done.load(boost::memory_order_acquire))
+    {
+        write_missed_step(step_, sample);
+        return;
+    }
+    job_.in_flight = false;
+    write_actions(sample);
+}
+
+// Number of steps skipped because the worker was still busy.
+int ShadowEvaluator::get_missed_steps() const
+{
+    return missed_steps_;
+}
@@ -0,0 +1,129 @@
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <ros/ros.h>
+
+#include "gps_agent_pkg/shmtransport.h"
+
+using namespace gps_control;
+
+// Sequence counters are accessed with the GCC atomic builtins, since the
+// python side maps the same memory as plain integers.
+static inline uint32_t load_seq(const uint32_t *seq)
+{
+    return __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+}
+
+static inline void store_seq(uint32_t *seq, uint32_t value)
+{
+    __atomic_store_n(seq, value, __ATOMIC_RELEASE);
+}
+
+// Constructor.
+ShmTransport::ShmTransport(const std::string &name, int obs_capacity, int action_capacity)
+: name_("/" + name), header_(NULL), obs_data_(NULL), action_data_(NULL), segment_size_(0), last_action_seq_(0)
+{
+    segment_size_ = sizeof(ShmTransportHeader) + sizeof(double)*(obs_capacity + action_capacity);
+    int fd = shm_open(name_.c_str(), O_CREAT | O_RDWR, 0600);
+    if (fd < 0 || ftruncate(fd, segment_size_) != 0)
+    {
+        ROS_ERROR("Failed to create shared memory segment %s", name_.c_str());
+        if (fd >= 0) close(fd);
+        return;
+    }
+    void *segment = mmap(NULL, segment_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED)
+    {
+        ROS_ERROR("Failed to map shared memory segment %s", name_.c_str());
+        return;
+    }
+    // Keep the segment resident so that the realtime thread never page faults.
+    mlock(segment, segment_size_);
+
+    header_ = (ShmTransportHeader *) segment;
+    obs_data_ = (double *) (header_ + 1);
+    action_data_ = obs_data_ + obs_capacity;
+    memset(segment, 0, segment_size_);
+    header_->version = SHM_TRANSPORT_VERSION;
+    header_->obs_capacity = obs_capacity;
+    header_->action_capacity = action_capacity;
+    // Publish the magic last, so the policy process only attaches to an initialized segment.
+    store_seq(&header_->magic, SHM_TRANSPORT_MAGIC);
+    ROS_INFO("Created shared memory transport %s (%d obs, %d action entries)", name_.c_str(), obs_capacity, action_capacity);
+}
+
+// Destructor.
+ShmTransport::~ShmTransport()
+{
+    if (header_ != NULL)
+    {
+        munmap(header_, segment_size_);
+        shm_unlink(name_.c_str());
+    }
+}
+
+// Check whether the segment was created successfully.
+bool ShmTransport::is_open() const
+{
+    return header_ != NULL;
+}
+
+// Get the maximum number of action entries.
+int ShmTransport::get_action_capacity() const
+{
+    return header_ != NULL ? header_->action_capacity : 0;
+}
+
+// Write an observation and wake the policy process.
+void ShmTransport::write_obs(int step, const Eigen::VectorXd &obs)
+{
+    if (header_ == NULL) return;
+    if (obs.size() > header_->obs_capacity)
+    {
+        ROS_ERROR("Observation of size %d does not fit the shared memory transport (%u)", (int)obs.size(), header_->obs_capacity);
+        return;
+    }
+    uint32_t seq = header_->obs_seq;
+    store_seq(&header_->obs_seq, seq + 1);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    header_->obs_step = step;
+    header_->obs_size = obs.size();
+    Eigen::Map<Eigen::VectorXd>(obs_data_, obs.size()) = obs;
+    store_seq(&header_->obs_seq, seq + 2);
+    syscall(SYS_futex, &header_->obs_seq, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+// Read a new action chunk.
+bool ShmTransport::read_actions(int &id, int &obs_step, int &start_step, int &horizon, Eigen::MatrixXd &commands)
+{
+    if (header_ == NULL) return false;
+    uint32_t seq = load_seq(&header_->action_seq);
+    if (seq == last_action_seq_ || (seq & 1)) return false;
+
+    // Copy the header into locals and the payload into the fixed buffer. None
+    // of it is used until the counter shows that the copy was not torn.
+    int chunk_id = header_->action_id;
+    int chunk_obs_step = header_->action_obs_step;
+    int chunk_start_step = header_->action_start_step;
+    int dU = header_->action_dU;
+    int chunk_horizon = std::max(header_->action_horizon, 1);
+    bool fits = dU > 0 && dU == commands.rows() && chunk_horizon <= commands.cols();
+    if (fits)
+        memcpy(commands.data(), action_data_, sizeof(double)*dU*chunk_horizon);
+
+    // Retry on the next step if the writer changed the chunk while it was copied.
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (load_seq(&header_->action_seq) != seq) return false;
+    last_action_seq_ = seq;
+    if (!fits) return false;
+
+    id = chunk_id;
+    obs_step = chunk_obs_step;
+    start_step = chunk_start_step;
+    horizon = chunk_horizon;
+    return true;
+}
@@ -1,10 +1,16 @@
-
 #include "gps_agent_pkg/robotplugin.h"
 #include "gps_agent_pkg/util.h"
 #include "gps_agent_pkg/tfcontroller.h"
+#include "gps_agent_pkg/trialcontrollerregistry.h"
+#include "gps_agent_pkg/TfParams.h"
 
 using namespace gps_control;
 
+// Default number of future steps the action ring can hold.
+#define DEFAULT_ACTION_CAPACITY 32
+// Default number of consecutive stale steps before an error is logged.
+#define DEFAULT_MAX_STALE_STEPS 10
+
 // Constructor.
 TfController::TfController()
 : TrialController()
@@ -12,54 +18,146 @@ TfController::TfController()
     is_configured_ = false;
 
     last_command_id_received = 0;
-    last_command_id_acted_upon = 0;
-    failed_attempts = 0;
+    max_stale_steps_ = DEFAULT_MAX_STALE_STEPS;
+    reset_actions();
 }
 
 // Destructor.
 TfController::~TfController() {
 }
 
-void TfController::update_action_command(int id, const Eigen::VectorXd &command) {
+// Reset ring and statistics.
+void TfController::reset_actions() {
+    std::fill(ring_steps_.begin(), ring_steps_.end(), -1);
+    std::fill(ring_obs_steps_.begin(), ring_obs_steps_.end(), -1);
+    stale_streak_ = 0;
+    fresh_steps_ = 0;
+    stale_steps_ = 0;
+    max_stale_streak_ = 0;
+    late_actions_ = 0;
+    contended_steps_ = 0;
+    total_action_age_ = 0;
+    max_action_age_ = 0;
+}
+
+// Write an action chunk into the ring (called from the subscriber thread).
+void TfController::update_action_command(int id, int obs_step, int start_step, const Eigen::Ref<const Eigen::MatrixXd> &commands) {
+    boost::mutex::scoped_lock lock(ring_mutex_);
     last_command_id_received = id;
-    last_action_command_received = command;
+    int capacity = action_ring_.cols();
+    if (capacity == 0 || commands.rows() != action_ring_.rows()) return;
+
+    int current_step = get_step_counter();
+    for (int i = 0; i < commands.cols(); ++i)
+    {
+        int step = start_step + i;
+        if (step < current_step) {
+            // This action missed its deadline.
+            late_actions_++;
+            continue;
+        }
+        if (step >= current_step + capacity) break;
+        int slot = step % capacity;
+        // Newer observations override older predictions for the same step.
+        if (ring_steps_[slot] == step && ring_obs_steps_[slot] > obs_step) continue;
+        action_ring_.col(slot) = commands.col(i);
+        ring_steps_[slot] = step;
+        ring_obs_steps_[slot] = obs_step;
+    }
 }
 
+// Pick the action scheduled for this step, or hold the last one.
 void TfController::get_action(int t, const Eigen::VectorXd &X, const Eigen::VectorXd &obs, Eigen::VectorXd &U){
-    if (is_configured_) {
-        if(last_command_id_acted_upon < last_command_id_received){
-            last_command_id_acted_upon = last_command_id_received;
-            failed_attempts = 0;
-            U = last_action_command_received;
-        }
-        else if(failed_attempts < 2){ //this would allow acting on stale actions...maybe a bad idea?
-            U = last_action_command_received;
-            failed_attempts++;
-        }
-        else{
-            ROS_FATAL("no new action command received. Can not act on stale actions.");
+    if (!is_configured_) return;
+
+    bool fresh = false;
+    boost::mutex::scoped_try_lock lock(ring_mutex_);
+    if (lock.owns_lock()) {
+        int slot = t % action_ring_.cols();
+        if (ring_steps_[slot] == t) {
+            last_action_command_received = action_ring_.col(slot);
+            int age = t - ring_obs_steps_[slot];
+            total_action_age_ += age;
+            max_action_age_ = std::max(max_action_age_, age);
+            fresh = true;
         }
     }
+    else {
+        contended_steps_++;
+    }
+
+    if (fresh) {
+        fresh_steps_++;
+        stale_streak_ = 0;
+    }
+    else {
+        // Hold the last action.
+        stale_steps_++;
+        stale_streak_++;
+        max_stale_streak_ = std::max(max_stale_streak_, stale_streak_);
+        if (stale_streak_ == max_stale_steps_)
+            ROS_ERROR("no new action for %d steps, holding the last action", stale_streak_);
+    }
+    U = last_action_command_received;
 }
 
 // Configure the controller.
-void TfController::configure_controller(OptionsMap &options)
+void TfController::configure(const TfControllerConfig &config)
 {
     last_command_id_received = 0;
-    last_command_id_acted_upon = 0;
-    failed_attempts = 0;
-    int dU = boost::get<int>(options["dU"]);
-    last_action_command_received.resize(dU);
-    for (int i = 0; i < dU; ++i)
+    int dU = config.dU;
+    last_action_command_received.setZero(dU);
+
+    int capacity = config.action_capacity > 0 ? config.action_capacity : DEFAULT_ACTION_CAPACITY;
+    max_stale_steps_ = config.max_stale_steps > 0 ? config.max_stale_steps : DEFAULT_MAX_STALE_STEPS;
+
     {
-        last_action_command_received(i) = 0;
+        boost::mutex::scoped_lock lock(ring_mutex_);
+        action_ring_.setZero(dU, capacity);
+        ring_steps_.resize(capacity);
+        ring_obs_steps_.resize(capacity);
+        reset_actions();
     }
+
     //Call superclass
-    TrialController::configure_controller(options);
+    TrialController::configure(config);
     ROS_INFO_STREAM("Set Tensorflow network parameters");
     is_configured_ = true;
 }
 
-void TfController::publish_obs(Eigen::VectorXd obs, RobotPlugin *plugin){
-    plugin ->tf_publish_obs(obs);
+void TfController::publish_obs(int t, Eigen::VectorXd obs, RobotPlugin *plugin){
+    plugin ->tf_publish_obs(t, obs);
+}
+
+// Log the deadline and staleness counters.
+void TfController::report_statistics()
+{
+    boost::mutex::scoped_lock lock(ring_mutex_);
+    double mean_age = fresh_steps_ > 0 ? (double)total_action_age_/fresh_steps_ : 0.0;
+    ROS_INFO("tf controller: %d fresh steps, %d stale steps (longest run %d), %d late actions, %d contended steps, action age mean %.2f max %d steps",
+             fresh_steps_, stale_steps_, max_stale_streak_, late_actions_, contended_steps_, mean_age, max_action_age_);
+    if (stale_steps_ > 0 || late_actions_ > 0)
+        ROS_WARN("tf controller missed %d step deadlines", stale_steps_);
 }
+
+namespace
+{
+
+// Configure a tf controller from the parameters message.
+TrialController *create_tf_controller(const gps_agent_pkg::ControllerParams &params, const TrialControllerConfig &trial, double frequency)
+{
+    const gps_agent_pkg::TfParams &tfparams = params.tf;
+    TfControllerConfig config;
+    static_cast<TrialControllerConfig&>(config) = trial;
+    config.dU = (int) tfparams.dU;
+    config.action_capacity = (int) tfparams.action_capacity;
+    config.max_stale_steps = (int) tfparams.max_stale_steps;
+
+    TfController *controller = new TfController();
+    controller->configure(config);
+    return controller;
+}
+
+}
+
+REGISTER_TRIAL_CONTROLLER(gps::TF_CONTROLLER, "tf", create_tf_controller);
@@ -28,7 +28,7 @@ void TrialController::update(RobotPlugin *plugin, ros::Time current_time, boost:
 
     //publish the observation for consumption. Can be implemented in subclass if you want
     //the observations published to a ros node. Used for async controllers like the tf_controller.
-    publish_obs(obs, plugin);
+    publish_obs(step_counter_, obs, plugin);
     // Ask subclass to fill in torques
     get_action(step_counter_, X, obs, torques);
 
@@ -41,31 +41,40 @@ void TrialController::update(RobotPlugin *plugin, ros::Time current_time, boost:
     ROS_INFO("Step counter: %d", step_counter_);
 }
 
-void TrialController::configure_controller(OptionsMap &options)
+// Update the torques between controller steps. The sensors write the current
+// state into the slot of the next step, so it is read from there; the sample
+// itself and the step counter are left alone.
+void TrialController::update_tick(RobotPlugin *plugin, ros::Time current_time, boost::scoped_ptr<Sample>& sample, Eigen::VectorXd &torques)
 {
-    ROS_INFO_STREAM(">TrialController::configure_controller");
+    if (step_counter_ == 0 || is_finished()) return;
+    sample->get_data(step_counter_, tick_state_, state_datatypes_);
+    get_tick_action(step_counter_-1, (current_time - last_update_time_).toSec(), tick_state_, torques);
+}
+
+// By default, hold the torques between controller steps.
+void TrialController::get_tick_action(int t, double elapsed, const Eigen::VectorXd &X, Eigen::VectorXd &U)
+{
+}
+
+// By default, only act on controller steps.
+bool TrialController::updates_every_tick() const
+{
+    return false;
+}
+
+// Configure the settings shared by all trial controllers.
+void TrialController::configure(const TrialControllerConfig &config)
+{
+    ROS_INFO_STREAM(">TrialController::configure");
     if(!is_finished()){
         // TODO(chelsea/sergey/zoe) This error happens every time...
         ROS_ERROR("Cannot configure controller while a trial is in progress");
     }
-    std::vector<int> datatypes;
 
-    int T = boost::get<int>(options["T"]);
     step_counter_ = 0;
-    trial_end_step_ = T;
-
-    datatypes = boost::get<std::vector<int> >(options["state_datatypes"]);
-    state_datatypes_.resize(datatypes.size());
-    for(int i=0; i<datatypes.size(); i++){
-        state_datatypes_[i] = (gps::SampleType) datatypes[i];
-    }
-
-    datatypes = boost::get<std::vector<int> >(options["obs_datatypes"]);
-    obs_datatypes_.resize(datatypes.size());
-    for(int i=0; i<datatypes.size(); i++){
-        obs_datatypes_[i] = (gps::SampleType) datatypes[i];
-    }
-
+    trial_end_step_ = config.T;
+    state_datatypes_ = config.state_datatypes;
+    obs_datatypes_ = config.obs_datatypes;
 }
 
 // Check if controller is finished with its current task.
@@ -90,10 +99,13 @@ void TrialController::reset(ros::Time time)
     trial_end_step_ = 1;
 }
 
-void TrialController::update_action_command(int id, const Eigen::VectorXd &command){
+void TrialController::update_action_command(int id, int obs_step, int start_step, const Eigen::Ref<const Eigen::MatrixXd> &commands){
 }
 
-void TrialController::publish_obs(Eigen::VectorXd obs, RobotPlugin *plugin){
+void TrialController::publish_obs(int t, Eigen::VectorXd obs, RobotPlugin *plugin){
+
+}
 
+void TrialController::report_statistics(){
 }
 
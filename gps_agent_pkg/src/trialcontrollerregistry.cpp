@@ -0,0 +1,63 @@
+#include "gps_agent_pkg/trialcontrollerregistry.h"
+
+using namespace gps_control;
+
+namespace
+{
+
+struct TrialControllerEntry
+{
+    int type;
+    std::string name;
+    TrialControllerFactory factory;
+};
+
+// Construct on first use, since controllers register during static initialization.
+std::vector<TrialControllerEntry> &get_entries()
+{
+    static std::vector<TrialControllerEntry> entries;
+    return entries;
+}
+
+}
+
+// Register a factory under a controller type and name.
+bool TrialControllerRegistry::register_controller(int type, const std::string &name, TrialControllerFactory factory)
+{
+    std::vector<TrialControllerEntry> &entries = get_entries();
+    for (int i = 0; i < entries.size(); i++)
+    {
+        if (entries[i].type == type || entries[i].name == name)
+            return false;
+    }
+    TrialControllerEntry entry;
+    entry.type = type;
+    entry.name = name;
+    entry.factory = factory;
+    entries.push_back(entry);
+    return true;
+}
+
+// Create a controller by backend name or controller type.
+TrialController *TrialControllerRegistry::create(const gps_agent_pkg::ControllerParams &params, const TrialControllerConfig &trial, double frequency)
+{
+    const std::vector<TrialControllerEntry> &entries = get_entries();
+    for (int i = 0; i < entries.size(); i++)
+    {
+        if (params.backend.empty() ? entries[i].type == params.controller_to_execute : entries[i].name == params.backend)
+            return entries[i].factory(params, trial, frequency);
+    }
+    if (params.backend.empty())
+        ROS_ERROR("No trial controller registered for controller type %d", (int)params.controller_to_execute);
+    else
+        ROS_ERROR("No trial controller backend named %s", params.backend.c_str());
+    return NULL;
+}
+
+// Names of all registered controllers.
+void TrialControllerRegistry::get_registered(std::vector<std::string> &names)
+{
+    names.clear();
+    for (int i = 0; i < get_entries().size(); i++)
+        names.push_back(get_entries()[i].name);
+}
@@ -0,0 +1,95 @@
+/*
+Unit tests for the linear-Gaussian controller between controller steps: with
+interpolated gains, the torques follow the state the sensors write on every
+tick, rather than the state of the last controller step.
+*/
+#include "gps_agent_pkg/lingausscontroller.h"
+#include "gps_agent_pkg/sample.h"
+#include <gtest/gtest.h>
+#include <boost/scoped_ptr.hpp>
+
+using namespace gps_control;
+
+namespace
+{
+
+const int kT = 3;
+const int kDX = 2;
+const int kDU = 1;
+const double kStepPeriod = 0.05;
+
+class LinearGaussianControllerTest : public ::testing::TestWithParam<LinGaussInterpolation>
+{
+protected:
+    virtual void SetUp()
+    {
+        LinearGaussianControllerConfig config;
+        config.T = kT;
+        config.state_datatypes.push_back(gps::JOINT_ANGLES);
+        config.interpolation = GetParam();
+        config.step_period = kStepPeriod;
+        // Same gains at every step, so that the action is K*X+k whatever the
+        // interpolation weights.
+        K_.resize(kDU, kDX);
+        K_ << 2.0, -3.0;
+        k_.setConstant(kDU, 0.5);
+        for (int t = 0; t < kT; t++)
+        {
+            config.K.push_back(K_);
+            config.k.push_back(k_);
+        }
+        controller_.configure(config);
+
+        sample_.reset(new Sample(kT));
+        OptionsMap metadata;
+        sample_->set_meta_data(gps::JOINT_ANGLES, kDX, SampleDataFormatEigenVector, metadata);
+        sample_->set_meta_data(gps::ACTION, kDU, SampleDataFormatEigenVector, metadata);
+    }
+
+    // Write the joint angles into slot t, as the encoder sensor does.
+    void set_state(int t, const Eigen::VectorXd &X)
+    {
+        Eigen::VectorXd state = X;
+        sample_->set_data_vector(t, gps::JOINT_ANGLES, state.data(), kDX, SampleDataFormatEigenVector);
+    }
+
+    LinearGaussianController controller_;
+    boost::scoped_ptr<Sample> sample_;
+    Eigen::MatrixXd K_;
+    Eigen::VectorXd k_;
+};
+
+TEST_P(LinearGaussianControllerTest, TickActionFollowsState)
+{
+    ASSERT_TRUE(controller_.updates_every_tick());
+
+    Eigen::VectorXd X(kDX), torques(kDU);
+    X << 0.1, 0.2;
+    set_state(0, X);
+    controller_.update(NULL, ros::Time(1.0), sample_, torques);
+    EXPECT_NEAR((K_*X + k_)(0), torques(0), 1e-12);
+
+    // Between steps 0 and 1 the sensors keep writing the state into slot 1.
+    Eigen::VectorXd previous_torques = torques;
+    for (int tick = 1; tick < 5; tick++)
+    {
+        X(0) += 0.01;
+        X(1) -= 0.02;
+        set_state(1, X);
+        controller_.update_tick(NULL, ros::Time(1.0 + 0.01*tick), sample_, torques);
+        EXPECT_NEAR((K_*X + k_)(0), torques(0), 1e-12);
+        EXPECT_GT(fabs(torques(0) - previous_torques(0)), 1e-3);
+        previous_torques = torques;
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(Interpolation, LinearGaussianControllerTest,
+                        ::testing::Values(LinGaussInterpolationLinear, LinGaussInterpolationCubic));
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
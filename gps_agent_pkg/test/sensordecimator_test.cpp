@@ -0,0 +1,104 @@
+/*
+Unit tests for the sensor decimation stages: the filters designed by the
+factory pass DC unchanged and attenuate everything above the output Nyquist
+frequency, and invalid rates are rejected.
+*/
+#include "gps_agent_pkg/sensordecimator.h"
+#include <gtest/gtest.h>
+#include <boost/scoped_ptr.hpp>
+#include <math.h>
+
+using namespace gps_control;
+
+namespace
+{
+
+const int kNumChannels = 6;
+const double kInputRate = 1000.0;
+const double kOutputRate = 20.0;
+
+// Largest output magnitude on channel 0 for a unit sine at the given
+// frequency, measured after the filter has settled.
+double tone_gain(SensorDecimator *decimator, double frequency)
+{
+    double reading[kNumChannels];
+    double peak = 0.0;
+    for (int i = 0; i < 3000; i++)
+    {
+        for (int c = 0; c < kNumChannels; c++)
+            reading[c] = sin(2.0*M_PI*frequency*i/kInputRate);
+        decimator->push(reading);
+        if (i >= 1000)
+            peak = std::max(peak, fabs(decimator->get_output()(0)));
+    }
+    return peak;
+}
+
+class SensorDecimatorTest : public ::testing::TestWithParam<SensorDecimatorType>
+{
+};
+
+TEST_P(SensorDecimatorTest, UnitDCGain)
+{
+    boost::scoped_ptr<SensorDecimator> decimator(
+        SensorDecimator::create_decimator(GetParam(), kNumChannels, kInputRate, kOutputRate));
+    ASSERT_TRUE(decimator.get() != NULL);
+    decimator->reset(Eigen::VectorXd::Zero(kNumChannels));
+    double reading[kNumChannels];
+    for (int c = 0; c < kNumChannels; c++)
+        reading[c] = c - 2.5;
+    for (int i = 0; i < 1000; i++)
+        decimator->push(reading);
+    for (int c = 0; c < kNumChannels; c++)
+        EXPECT_NEAR(reading[c], decimator->get_output()(c), 1e-6);
+}
+
+TEST_P(SensorDecimatorTest, ResetIsSteadyState)
+{
+    boost::scoped_ptr<SensorDecimator> decimator(
+        SensorDecimator::create_decimator(GetParam(), kNumChannels, kInputRate, kOutputRate));
+    ASSERT_TRUE(decimator.get() != NULL);
+    Eigen::VectorXd value = Eigen::VectorXd::LinSpaced(kNumChannels, -1.0, 2.0);
+    decimator->reset(value);
+    decimator->push(value.data());
+    EXPECT_TRUE(decimator->get_output().isApprox(value, 1e-9));
+}
+
+TEST_P(SensorDecimatorTest, StopbandAttenuation)
+{
+    boost::scoped_ptr<SensorDecimator> decimator(
+        SensorDecimator::create_decimator(GetParam(), kNumChannels, kInputRate, kOutputRate));
+    ASSERT_TRUE(decimator.get() != NULL);
+    // At least 60 dB down from ten times the cutoff, where tones alias to DC
+    // at the output rate, up to the input Nyquist frequency.
+    EXPECT_LT(tone_gain(decimator.get(), 100.0), 1e-3);
+    EXPECT_LT(tone_gain(decimator.get(), 250.0), 1e-3);
+    EXPECT_LT(tone_gain(decimator.get(), 480.0), 1e-3);
+}
+
+TEST_P(SensorDecimatorTest, PassbandGain)
+{
+    boost::scoped_ptr<SensorDecimator> decimator(
+        SensorDecimator::create_decimator(GetParam(), kNumChannels, kInputRate, kOutputRate));
+    ASSERT_TRUE(decimator.get() != NULL);
+    EXPECT_NEAR(1.0, tone_gain(decimator.get(), 1.0), 0.01);
+}
+
+TEST_P(SensorDecimatorTest, RejectsInvalidRates)
+{
+    EXPECT_TRUE(SensorDecimator::create_decimator(GetParam(), kNumChannels, kInputRate, kInputRate) == NULL);
+    EXPECT_TRUE(SensorDecimator::create_decimator(GetParam(), kNumChannels, kOutputRate, kInputRate) == NULL);
+    EXPECT_TRUE(SensorDecimator::create_decimator(GetParam(), kNumChannels, kInputRate, 0.0) == NULL);
+    EXPECT_TRUE(SensorDecimator::create_decimator(GetParam(), kNumChannels, -kInputRate, kOutputRate) == NULL);
+}
+
+INSTANTIATE_TEST_CASE_P(Kernels, SensorDecimatorTest,
+                        ::testing::Values(FIRDecimatorType, IIRDecimatorType));
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
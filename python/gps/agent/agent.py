@@ -71,6 +71,17 @@ class Agent(object):
         """
         raise NotImplementedError("Must be implemented in subclass.")
 
+    def sample_batch(self, policy, condition, N, verbose_trials=0, save=True,
+                     noisy=True):
+        """
+        Draw N samples under the specified condition, plotting the first
+        verbose_trials. Agents that can collect samples in parallel
+        override this.
+        """
+        return [self.sample(policy, condition, verbose=(i < verbose_trials),
+                            save=save, noisy=noisy)
+                for i in range(N)]
+
     def reset(self, condition):
         """ Reset environment to the specified condition. """
         pass  # May be overridden in subclass.
@@ -42,6 +42,15 @@ try:
         'reset_conditions': [],  # Defines reset modes + positions for
                                  # trial and auxiliary arms.
         'frequency': 20,
+        # Steps between publishing an observation and the earliest step the
+        # tf controller applies the actions computed from it.
+        'tf_action_delay': 1,
+        # Name of the plugin's shared-memory transport (its shm_transport
+        # param) to exchange tf observations and actions locally (x86 only),
+        # or None to use the ROS topics.
+        'shm_transport': None,
+        # Evaluate shadow policies on a worker thread on the robot side.
+        'async_shadow_controllers': False,
         'end_effector_points': np.array([]),
         #TODO: Actually pass in low gains and high gains and use both
         #      for the position controller.
@@ -66,6 +75,7 @@ except rospkg.common.ResourceNotFound as e:
 # AgentMuJoCo
 AGENT_MUJOCO = {
     'substeps': 1,
+    'sample_threads': 0,  # Threads for batched rollouts, 0 for one per core.
     'camera_pos': np.array([2., 3., 2., 0., 0., 0.]),
     'image_width': 640,
     'image_height': 480,
@@ -8,6 +8,8 @@ import mjcpy
 from gps.agent.agent import Agent
 from gps.agent.agent_utils import generate_noise, setup
 from gps.agent.config import AGENT_MUJOCO, AGENT_MUJOCO_ADV
+from gps.algorithm.policy.lin_gauss_policy import LinearGaussianPolicy, \
+        LinearGaussianPolicyRobust
 from gps.proto.gps_pb2 import JOINT_ANGLES, JOINT_VELOCITIES, \
         END_EFFECTOR_POINTS, END_EFFECTOR_POINT_VELOCITIES, \
         END_EFFECTOR_POINT_JACOBIANS, ACTION, ACTION_V, RGB_IMAGE, RGB_IMAGE_SIZE, \
@@ -17,6 +19,11 @@ from gps.proto.gps_pb2 import JOINT_ANGLES, JOINT_VELOCITIES, \
 from gps.sample.sample import Sample
 
 
+def _as_mjtnum(a):
+    """ Return a as a C-contiguous float64 array, as mjcpy expects. """
+    return np.ascontiguousarray(a, dtype=np.float64)
+
+
 class AgentMuJoCo(Agent):
     """
     All communication between the algorithms and MuJoCo is done through
@@ -59,6 +66,12 @@ class AgentMuJoCo(Agent):
             for i in range(self._hyperparams['conditions']):
                 self._world.append(mjcpy.MJCWorld(self._hyperparams['filename'][i]))
                 self._model.append(self._world[i].get_model())
+        # Live views of the data of each world, read without copying mjData.
+        # They are unsynchronized, so only read them from the sampling thread.
+        self._world_data = [world.get_data_view() for world in self._world]
+        # Each step call runs all substeps of a time step.
+        for world in self._world:
+            world.set_num_steps(self._hyperparams['substeps'])
 
         for i in range(self._hyperparams['conditions']):
             for j in range(len(self._hyperparams['pos_body_idx'][i])):
@@ -75,13 +88,13 @@ class AgentMuJoCo(Agent):
             if END_EFFECTOR_POINTS in self.x_data_types:
                 # TODO: this assumes END_EFFECTOR_VELOCITIES is also in datapoints right?
                 self._init(i)
-                eepts = self._world[i].get_data()['site_xpos'].flatten()
+                eepts = self._world_data[i].site_xpos.flatten()
                 self.x0.append(
                     np.concatenate([self._hyperparams['x0'][i], eepts, np.zeros_like(eepts)])
                 )
             elif END_EFFECTOR_POINTS_NO_TARGET in self.x_data_types:
                 self._init(i)
-                eepts = self._world[i].get_data()['site_xpos'].flatten()
+                eepts = self._world_data[i].site_xpos.flatten()
                 eepts_notgt = np.delete(eepts, self._hyperparams['target_idx'])
                 self.x0.append(
                     np.concatenate([self._hyperparams['x0'][i], eepts_notgt, np.zeros_like(eepts_notgt)])
@@ -115,7 +128,9 @@ class AgentMuJoCo(Agent):
             feature_fn = policy.get_features
         new_sample = self._init_sample(condition, feature_fn=feature_fn)
         # new_sample_adv = copy.deepcopy(new_sample)
-        mj_X = self._hyperparams['x0'][condition]
+        # The state is stepped in place (see step_into).
+        mj_X = np.array(self._hyperparams['x0'][condition], dtype=np.float64)
+        mj_site = np.empty((self._model[condition]['nsite'], 3))
         U = np.zeros([self.T, self.dU])
         V = np.zeros([self.T, self.dV])
         if noisy:
@@ -134,21 +149,22 @@ class AgentMuJoCo(Agent):
                 self._model[condition]['body_pos'][idx, :] += \
                         var * np.random.randn(1, 3)
         # Take the sample.
-        for t in range(self.T):
-            X_t = new_sample.get_X(t=t) #see sample.py
-            obs_t = new_sample.get_obs(t=t)
-            mj_U = policy.act_u(X_t, obs_t, t, noise[t, :])
-            mj_V = policy.act_v(X_t, obs_t, t, noise[t, :])
-            U[t, :] = mj_U
-            V[t, :] = mj_V
-            if verbose:
-                self._world[condition].plot(mj_X)
-            if (t + 1) < self.T:
-                for _ in range(self._hyperparams['substeps']):
-                    mj_X, _ = self._world[condition].step(mj_X, mj_U)  # run the passive dynamics
-                    # mj_X, _ = self._world[condition].step(mj_X, mj_V)  # run the passive dynamics
-                self._data = self._world[condition].get_data()
-                self._set_sample(new_sample, mj_X, t, condition, feature_fn=feature_fn)
+        if not verbose and self._can_rollout_lingauss(policy, condition):
+            U, V = self._rollout_lingauss(new_sample, policy, mj_X, noise, condition)
+        else:
+            for t in range(self.T):
+                X_t = new_sample.get_X(t=t) #see sample.py
+                obs_t = new_sample.get_obs(t=t)
+                mj_U = policy.act_u(X_t, obs_t, t, noise[t, :])
+                mj_V = policy.act_v(X_t, obs_t, t, noise[t, :])
+                U[t, :] = mj_U
+                V[t, :] = mj_V
+                if verbose:
+                    self._world[condition].plot(mj_X)
+                if (t + 1) < self.T:
+                    self._world[condition].step_into(mj_X, mj_U, mj_X, mj_site, True)  # run the passive dynamics
+                    # self._world[condition].step_into(mj_X, mj_V, mj_X, mj_site, True)  # run the passive dynamics
+                    self._set_sample(new_sample, mj_X, t, condition, feature_fn=feature_fn)
         new_sample.set(ACTION, U)
         new_sample.set(NOISE, noise)
         new_sample.set(ACTION_V, V)
@@ -173,7 +189,9 @@ class AgentMuJoCo(Agent):
             feature_fn = policy.get_features
         new_sample = self._init_sample(condition, feature_fn=feature_fn)
         # new_sample_adv = copy.deepcopy(new_sample)
-        mj_X = self._hyperparams['x0'][condition]
+        # The state is stepped in place (see step_into).
+        mj_X = np.array(self._hyperparams['x0'][condition], dtype=np.float64)
+        mj_site = np.empty((self._model[condition]['nsite'], 3))
         U = np.zeros([self.T, self.dU])
         V = np.zeros([self.T, self.dV])
         if noisy:
@@ -191,23 +209,26 @@ class AgentMuJoCo(Agent):
                 var = self._hyperparams['noisy_body_var'][condition][i]
                 self._model[condition]['body_pos'][idx, :] += \
                         var * np.random.randn(1, 3)
-        # Take the sample.
-        for t in range(self.T):
-            X_t = new_sample.get_X(t=t) #see sample.py
-            obs_t = new_sample.get_obs(t=t)
-            mj_U = policy.act_u(X_t, obs_t, t, noise[t, :])
-            mj_V = policy.act_v(X_t, obs_t, t, noise[t, :])
-            U[t, :] = mj_U
-            V[t, :] = mj_V
-            if verbose:
-                self._world[condition].plot(mj_X)
-            if (t + 1) < self.T:
-                for _ in range(self._hyperparams['substeps']):
-                    mj_X, _ = self._world[condition].step(mj_X, mj_U)  # run the passive dynamics
-                    # update passive dynamics with adversary
-                    mj_X, _ = self._world[condition].step(mj_X, mj_V)  # run the passive dynamics
-                self._data = self._world[condition].get_data()
-                self._set_sample(new_sample, mj_X, t, condition, feature_fn=feature_fn)
+        # Take the sample, alternating single substeps of U and V.
+        self._world[condition].set_num_steps(1)
+        try:
+            for t in range(self.T):
+                X_t = new_sample.get_X(t=t) #see sample.py
+                obs_t = new_sample.get_obs(t=t)
+                mj_U = policy.act_u(X_t, obs_t, t, noise[t, :])
+                mj_V = policy.act_v(X_t, obs_t, t, noise[t, :])
+                U[t, :] = mj_U
+                V[t, :] = mj_V
+                if verbose:
+                    self._world[condition].plot(mj_X)
+                if (t + 1) < self.T:
+                    for _ in range(self._hyperparams['substeps']):
+                        self._world[condition].step_into(mj_X, mj_U, mj_X, mj_site, True)  # run the passive dynamics
+                        # update passive dynamics with adversary
+                        self._world[condition].step_into(mj_X, mj_V, mj_X, mj_site, True)  # run the passive dynamics
+                    self._set_sample(new_sample, mj_X, t, condition, feature_fn=feature_fn)
+        finally:
+            self._world[condition].set_num_steps(self._hyperparams['substeps'])
         new_sample.set(ACTION, U)
         new_sample.set(ACTION_V, V)
         new_sample.set(NOISE, noise)
@@ -215,6 +236,142 @@ class AgentMuJoCo(Agent):
             self._samples[condition].append(new_sample)
         return new_sample
 
+    def _can_rollout_lingauss(self, policy, condition):
+        """
+        Whether a trial of the policy can be rolled out in one call to
+        rollout_lingauss, i.e. the policy is linear-Gaussian in a state made
+        of joint angles, joint velocities and (optionally) end-effector points
+        and velocities, and no images need to be rendered along the way.
+        """
+        if not isinstance(policy, (LinearGaussianPolicy, LinearGaussianPolicyRobust)):
+            return False
+        if not hasattr(self._world[condition], 'rollout_lingauss'):
+            return False
+        if RGB_IMAGE in self.obs_data_types:
+            return False
+        model = self._model[condition]
+        nsite3 = 3 * model['nsite']
+        layouts = [
+            [(JOINT_ANGLES, model['nq']), (JOINT_VELOCITIES, model['nv'])],
+            [(JOINT_ANGLES, model['nq']), (JOINT_VELOCITIES, model['nv']),
+             (END_EFFECTOR_POINTS, nsite3), (END_EFFECTOR_POINT_VELOCITIES, nsite3)],
+        ]
+        sensor_dims = self._hyperparams['sensor_dims']
+        state = [(data_type, sensor_dims[data_type]) for data_type in self.x_data_types]
+        return state in layouts
+
+    def _rollout_lingauss(self, sample, policy, mj_X, noise, condition):
+        """
+        Roll out a linear-Gaussian policy in C++ and fill in the sample for
+        every time step after the first (equivalent to calling act and
+        _set_sample at every step).
+        Args:
+            sample: Sample object initialized by _init_sample.
+            policy: LinearGaussianPolicy or LinearGaussianPolicyRobust.
+            mj_X: Initial MuJoCo state.
+            noise: A T x dU noise array.
+            condition: Which condition to run.
+        Returns:
+            U: A T x dU array of actions.
+            V: A T x dV array of adversarial actions (zero for
+                non-robust policies).
+        """
+        K, k, chol = [_as_mjtnum(a) for a in self._lingauss_params(policy)]
+        X, U, site_xpos, jac_site = self._world[condition].rollout_lingauss(
+            _as_mjtnum(mj_X), K, k, chol, _as_mjtnum(noise),
+            self._hyperparams['substeps'], self._hyperparams['dt'])
+        return self._set_lingauss_sample(sample, policy, noise, X, U,
+                                         site_xpos, jac_site, condition)
+
+    def _lingauss_params(self, policy):
+        """ Return the K, k and chol_pol_covar that rollout_lingauss applies. """
+        if isinstance(policy, LinearGaussianPolicyRobust):
+            return policy.Gu, policy.gu, policy.chol_pol_covar_u
+        return policy.K, policy.k, policy.chol_pol_covar
+
+    def _set_lingauss_sample(self, sample, policy, noise, X, U, site_xpos,
+                             jac_site, condition):
+        """
+        Set the data for all time steps of a sample from the output of
+        rollout_lingauss, and return the actions U and V.
+        """
+        nq, nv = self._model[condition]['nq'], self._model[condition]['nv']
+        eepts = site_xpos.reshape(self.T, -1)
+        eept_vels = np.zeros_like(eepts)
+        eept_vels[1:] = (eepts[1:] - eepts[:-1]) / self._hyperparams['dt']
+        sample.set(JOINT_ANGLES, X[:, :nq])
+        sample.set(JOINT_VELOCITIES, X[:, nq:nq+nv])
+        sample.set(END_EFFECTOR_POINTS, eepts)
+        sample.set(END_EFFECTOR_POINT_VELOCITIES, eept_vels)
+        if (END_EFFECTOR_POINTS_NO_TARGET in self._hyperparams['obs_include']):
+            target_idx = self._hyperparams['target_idx']
+            sample.set(END_EFFECTOR_POINTS_NO_TARGET, np.delete(eepts, target_idx, axis=1))
+            sample.set(END_EFFECTOR_POINT_VELOCITIES_NO_TARGET, np.delete(eept_vels, target_idx, axis=1))
+        sample.set(END_EFFECTOR_POINT_JACOBIANS, jac_site)
+
+        V = np.zeros([self.T, self.dV])
+        if isinstance(policy, LinearGaussianPolicyRobust):
+            x = sample.get_X()
+            V = np.einsum('tij,tj->ti', policy.Gv, x) + policy.gv + \
+                    np.einsum('tji,tj->ti', policy.chol_pol_covar_v, noise)
+        return U, V
+
+    def sample_batch(self, policy, condition, N, verbose_trials=0, save=True,
+                     noisy=True):
+        """
+        Take N samples under one condition. Linear-Gaussian policies are
+        rolled out in parallel with rollout_lingauss_batch, on
+        hyperparams['sample_threads'] threads (0 for one per core); other
+        policies, plotted trials and conditions with noisy bodies fall back
+        to sample.
+        Args:
+            policy: Policy to be used in the trials.
+            condition: Which condition setup to run.
+            N: Number of samples.
+            verbose_trials: Number of initial trials to plot.
+            save: Whether or not to store the trials into the samples.
+            noisy: Whether or not to use noise during sampling.
+        """
+        samples = [self.sample(policy, condition, verbose=True, save=save,
+                               noisy=noisy)
+                   for _ in range(min(N, verbose_trials))]
+        N -= len(samples)
+        world = self._world[condition]
+        if N <= 0:
+            return samples
+        if not hasattr(world, 'rollout_lingauss_batch') or \
+                not self._can_rollout_lingauss(policy, condition) or \
+                self._hyperparams['noisy_body_idx'][condition].size > 0:
+            return samples + [self.sample(policy, condition, verbose=False,
+                                          save=save, noisy=noisy)
+                              for _ in range(N)]
+
+        new_samples = [self._init_sample(condition) for _ in range(N)]
+        x0 = np.tile(self._hyperparams['x0'][condition], (N, 1))
+        if np.any(self._hyperparams['x0var'][condition] > 0):
+            x0 += self._hyperparams['x0var'][condition] * \
+                    np.random.randn(*x0.shape)
+        if noisy:
+            noise = np.array([generate_noise(self.T, self.dU, self._hyperparams)
+                              for _ in range(N)])
+        else:
+            noise = np.zeros((N, self.T, self.dU))
+        K, k, chol = [_as_mjtnum(a) for a in self._lingauss_params(policy)]
+        X, U, site_xpos, jac_site = world.rollout_lingauss_batch(
+            _as_mjtnum(x0), K, k, chol, _as_mjtnum(noise),
+            self._hyperparams['substeps'], self._hyperparams['dt'],
+            self._hyperparams['sample_threads'])
+        for n, new_sample in enumerate(new_samples):
+            U_n, V_n = self._set_lingauss_sample(
+                new_sample, policy, noise[n], X[n], U[n], site_xpos[n],
+                jac_site[n], condition)
+            new_sample.set(ACTION, U_n)
+            new_sample.set(NOISE, noise[n])
+            new_sample.set(ACTION_V, V_n)
+            if save:
+                self._samples[condition].append(new_sample)
+        return samples + new_samples
+
     def _init(self, condition):
         """
         Set the world to a given model, and run kinematics.
@@ -242,11 +399,11 @@ class AgentMuJoCo(Agent):
         # Initialize world/run kinematics
         self._init(condition)
 
-        # Initialize sample with stuff from _data
-        data = self._world[condition].get_data()
-        sample.set(JOINT_ANGLES, data['qpos'].flatten(), t=0)
-        sample.set(JOINT_VELOCITIES, data['qvel'].flatten(), t=0)
-        eepts = data['site_xpos'].flatten()
+        # Initialize sample with stuff from the world data
+        data = self._world_data[condition]
+        sample.set(JOINT_ANGLES, data.qpos.flatten(), t=0)
+        sample.set(JOINT_VELOCITIES, data.qvel.flatten(), t=0)
+        eepts = data.site_xpos.flatten()
         sample.set(END_EFFECTOR_POINTS, eepts, t=0)
         sample.set(END_EFFECTOR_POINT_VELOCITIES, np.zeros_like(eepts), t=0)
 
@@ -254,10 +411,7 @@ class AgentMuJoCo(Agent):
             sample.set(END_EFFECTOR_POINTS_NO_TARGET, np.delete(eepts, self._hyperparams['target_idx']), t=0)
             sample.set(END_EFFECTOR_POINT_VELOCITIES_NO_TARGET, np.delete(np.zeros_like(eepts), self._hyperparams['target_idx']), t=0)
 
-        jac = np.zeros([eepts.shape[0], self._model[condition]['nq']])
-        for site in range(eepts.shape[0] // 3):
-            idx = site * 3
-            jac[idx:(idx+3), :] = self._world[condition].get_jac_site(site)
+        jac = self._world[condition].get_jac_sites(list(range(eepts.shape[0] // 3)))
         sample.set(END_EFFECTOR_POINT_JACOBIANS, jac, t=0)
 
         # save initial image to meta data
@@ -304,7 +458,7 @@ class AgentMuJoCo(Agent):
         """
         sample.set(JOINT_ANGLES, np.array(mj_X[self._joint_idx]), t=t+1)
         sample.set(JOINT_VELOCITIES, np.array(mj_X[self._vel_idx]), t=t+1)
-        cur_eepts = self._data['site_xpos'].flatten()
+        cur_eepts = self._world_data[condition].site_xpos.flatten()
         sample.set(END_EFFECTOR_POINTS, cur_eepts, t=t+1)
         prev_eepts = sample.get(END_EFFECTOR_POINTS, t=t)
         eept_vels = (cur_eepts - prev_eepts) / self._hyperparams['dt']
@@ -314,10 +468,7 @@ class AgentMuJoCo(Agent):
             sample.set(END_EFFECTOR_POINTS_NO_TARGET, np.delete(cur_eepts, self._hyperparams['target_idx']), t=t+1)
             sample.set(END_EFFECTOR_POINT_VELOCITIES_NO_TARGET, np.delete(eept_vels, self._hyperparams['target_idx']), t=t+1)
 
-        jac = np.zeros([cur_eepts.shape[0], self._model[condition]['nq']])
-        for site in range(cur_eepts.shape[0] // 3):
-            idx = site * 3
-            jac[idx:(idx+3), :] = self._world[condition].get_jac_site(site)
+        jac = self._world[condition].get_jac_sites(list(range(cur_eepts.shape[0] // 3)))
         sample.set(END_EFFECTOR_POINT_JACOBIANS, jac, t=t+1)
         if RGB_IMAGE in self.obs_data_types:
             img = self._world[condition].get_image_scaled(self._hyperparams['image_width'],
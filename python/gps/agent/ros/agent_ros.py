@@ -10,7 +10,9 @@ from gps.agent.agent_utils import generate_noise, setup
 from gps.agent.config import AGENT_ROS
 from gps.agent.ros.ros_utils import ServiceEmulator, msg_to_sample, \
         policy_to_msg, tf_policy_to_action_msg, tf_obs_msg_to_numpy
-from gps.proto.gps_pb2 import TRIAL_ARM, AUXILIARY_ARM
+from gps.agent.ros import shm_transport
+from gps.agent.ros.shm_transport import ShmTransport
+from gps.proto.gps_pb2 import TRIAL_ARM, AUXILIARY_ARM, SENSOR_STALE
 from gps_agent_pkg.msg import TrialCommand, SampleResult, PositionCommand, \
         RelaxCommand, DataRequest, TfActionCommand, TfObsData
 try:
@@ -53,6 +55,12 @@ class AgentROS(Agent):
 
         self.use_tf = False
         self.observations_stale = True
+        self._shm_transport = None
+
+        # Policies evaluated on the states of every trial without acting;
+        # their noiseless actions are stored under SHADOW_ACTIONS, one
+        # policy after the other.
+        self.shadow_policies = []
 
     def _init_pubs_and_subs(self):
         self._trial_service = ServiceEmulator(
@@ -164,6 +172,12 @@ class AgentROS(Agent):
         trial_command = TrialCommand()
         trial_command.id = self._get_next_seq_id()
         trial_command.controller = policy_to_msg(policy, noise)
+        trial_command.shadow_controllers = [
+            policy_to_msg(shadow, np.zeros((self.T, self.dU)))
+            for shadow in self.shadow_policies
+        ]
+        trial_command.async_shadow_controllers = \
+                self._hyperparams['async_shadow_controllers']
         trial_command.T = self.T
         trial_command.id = self._get_next_seq_id()
         trial_command.frequency = self._hyperparams['frequency']
@@ -179,6 +193,7 @@ class AgentROS(Agent):
                 trial_command, timeout=self._hyperparams['trial_timeout']
             )
             sample = msg_to_sample(sample_msg, self)
+            self._warn_stale_sensors(sample)
             if save:
                 self._samples[condition].append(sample)
             return sample
@@ -186,13 +201,33 @@ class AgentROS(Agent):
             self._trial_service.publish(trial_command)
             sample_msg = self.run_trial_tf(policy, time_to_run=self._hyperparams['trial_timeout'])
             sample = msg_to_sample(sample_msg, self)
+            self._warn_stale_sensors(sample)
             if save:
                 self._samples[condition].append(sample)
             return sample
 
+    def stale_sensor_steps(self, sample):
+        """
+        Return a T x num_sensors boolean mask of the steps at which a
+        sensor's data was stale, i.e. an asynchronous sensor missed the step
+        it was due at and its previous data was written again. How old each
+        sensor's inputs were is stored under SENSOR_DELAY, in seconds.
+        """
+        return sample.get(SENSOR_STALE) > 0
+
+    def _warn_stale_sensors(self, sample):
+        """ Warn if any sensor data of a trial was stale. """
+        stale = self.stale_sensor_steps(sample)
+        if np.any(stale):
+            rospy.logwarn('Stale sensor data at %d of %d steps (sensors %s)',
+                          np.sum(np.any(stale, axis=1)), stale.shape[0],
+                          np.flatnonzero(np.any(stale, axis=0)).tolist())
+
     def run_trial_tf(self, policy, time_to_run=5):
         """ Run an async controller from a policy. The async controller receives observations from ROS subscribers
          and then uses them to publish actions."""
+        if self._shm_transport is not None:
+            return self.run_trial_tf_shm(policy, time_to_run)
         should_stop = False
         consecutive_failures = 0
         start_time = time.time()
@@ -200,9 +235,14 @@ class AgentROS(Agent):
             if self.observations_stale is False:
                 consecutive_failures = 0
                 last_obs = tf_obs_msg_to_numpy(self._tf_subscriber_msg)
+                obs_step = self._tf_subscriber_msg.step
+                # Actions computed from this observation can be applied
+                # tf_action_delay steps later at the earliest.
                 action_msg = tf_policy_to_action_msg(self.dU,
                                                      self._get_new_action(policy, last_obs),
-                                                     self.current_action_id)
+                                                     self.current_action_id,
+                                                     obs_step=obs_step,
+                                                     start_step=obs_step + self._hyperparams['tf_action_delay'])
                 self._tf_publish(action_msg)
                 self.observations_stale = True
                 self.current_action_id += 1
@@ -216,7 +256,35 @@ class AgentROS(Agent):
         result = self._trial_service._subscriber_msg
         return result  # the trial has completed. Here is its message.
 
+    def run_trial_tf_shm(self, policy, time_to_run=5):
+        """ Same as run_trial_tf, but exchanging observations and actions with the
+         plugin through shared memory instead of ROS topics."""
+        consecutive_failures = 0
+        start_time = time.time()
+        while True:
+            result = self._shm_transport.read_obs(timeout=0.01)
+            if result is not None:
+                consecutive_failures = 0
+                obs_step, last_obs = result
+                self._shm_transport.write_actions(
+                    self.current_action_id,
+                    np.reshape(self._get_new_action(policy, last_obs), (-1, self.dU)),
+                    obs_step, obs_step + self._hyperparams['tf_action_delay'])
+                self.current_action_id += 1
+            else:
+                consecutive_failures += 1
+                if time.time() - start_time > time_to_run and consecutive_failures > 5:
+                    break
+        rospy.sleep(0.25)  # wait for finished trial to come in.
+        return self._trial_service._subscriber_msg
+
     def _get_new_action(self, policy, obs):
+        """
+        Return the actions for the next steps, one row per step. Policies
+        that predict several steps ahead implement act_chunk.
+        """
+        if hasattr(policy, 'act_chunk'):
+            return policy.act_chunk(None, obs, None, None)
         return policy.act(None, obs, None, None)
 
     def _tf_callback(self, message):
@@ -233,9 +301,17 @@ class AgentROS(Agent):
         self.current_action_id = 1
         self.dU = dU
         if self.use_tf is False:  # init pub and sub if this init has not been called before.
-            self._pub = rospy.Publisher('/gps_controller_sent_robot_action_tf', TfActionCommand)
-            self._sub = rospy.Subscriber('/gps_obs_tf', TfObsData, self._tf_callback)
-            r = rospy.Rate(0.5)  # wait for publisher/subscriber to kick on.
-            r.sleep()
+            use_shm = self._hyperparams['shm_transport'] is not None
+            if use_shm and not shm_transport.is_supported():
+                rospy.logwarn('Shared memory transport is only supported on x86, using ROS topics')
+                use_shm = False
+            if use_shm:
+                # Local plugin: use the shared-memory transport it created.
+                self._shm_transport = ShmTransport(self._hyperparams['shm_transport'])
+            else:
+                self._pub = rospy.Publisher('/gps_controller_sent_robot_action_tf', TfActionCommand)
+                self._sub = rospy.Subscriber('/gps_obs_tf', TfObsData, self._tf_callback)
+                r = rospy.Rate(0.5)  # wait for publisher/subscriber to kick on.
+                r.sleep()
         self.use_tf = True
         self.observations_stale = True
@@ -1,12 +1,16 @@
 """ This file defines utilities for the ROS agents. """
+import struct
+
 import numpy as np
 
 import rospy
 
 from gps.algorithm.policy.lin_gauss_policy import LinearGaussianPolicy
-from gps_agent_pkg.msg import ControllerParams, LinGaussParams, TfParams, CaffeParams, TfActionCommand
+from gps_agent_pkg.msg import ControllerParams, LinGaussParams, TfParams, CaffeParams, TfActionCommand, \
+        NativeNNParams
 from gps.sample.sample import Sample
-from gps.proto.gps_pb2 import LIN_GAUSS_CONTROLLER, CAFFE_CONTROLLER, TF_CONTROLLER
+from gps.proto.gps_pb2 import LIN_GAUSS_CONTROLLER, CAFFE_CONTROLLER, TF_CONTROLLER, \
+        NATIVE_NN_CONTROLLER
 import logging
 LOGGER = logging.getLogger(__name__)
 try:
@@ -20,6 +24,11 @@ try:
 except ImportError:
     TfPolicy = None
 
+# Header and activation names of the blob read by NeuralNetworkNative.
+NATIVE_NN_MAGIC = 0x4e535047
+NATIVE_NN_VERSION = 1
+NATIVE_NN_ACTIVATIONS = ['linear', 'relu', 'tanh', 'sigmoid']
+
 
 def msg_to_sample(ros_msg, agent):
     """
@@ -48,6 +57,7 @@ def policy_to_msg(policy, noise):
                 policy.K.reshape(policy.T * policy.dX * policy.dU).tolist()
         msg.lingauss.k_t = \
                 policy.fold_k(noise).reshape(policy.T * policy.dU).tolist()
+        msg.lingauss.interpolation = getattr(policy, 'gain_interpolation', 0)
     elif NO_CAFFE is False and isinstance(policy, CaffePolicy):
         msg.controller_to_execute = CAFFE_CONTROLLER
         msg.caffe = CaffeParams()
@@ -61,23 +71,67 @@ def policy_to_msg(policy, noise):
         for i in range(noise.shape[0]):
             scaled_noise[i] = policy.chol_pol_covar.T.dot(noise[i])
         msg.caffe.noise = scaled_noise.reshape(-1).tolist()
+    elif hasattr(policy, 'get_dense_layers'):
+        msg.controller_to_execute = NATIVE_NN_CONTROLLER
+        msg.native = NativeNNParams()
+        msg.native.weights = dense_layers_to_blob(policy.get_dense_layers())
+        msg.native.bias = policy.bias.tolist()
+        msg.native.dU = policy.dU
+        scale_shape = policy.scale.shape
+        msg.native.scale = policy.scale.reshape(scale_shape[0] * scale_shape[1]).tolist()
+        msg.native.dim_bias = scale_shape[0]
+        msg.native.precision = getattr(policy, 'native_precision', 0)
+        msg.native.network_backend = getattr(policy, 'native_backend', '')
+        scaled_noise = np.zeros_like(noise)
+        for i in range(noise.shape[0]):
+            scaled_noise[i] = policy.chol_pol_covar.T.dot(noise[i])
+        msg.native.noise = scaled_noise.reshape(-1).tolist()
     elif isinstance(policy, TfPolicy):
         msg.controller_to_execute = TF_CONTROLLER
         msg.tf = TfParams()
         msg.tf.dU = policy.dU
     else:
         raise NotImplementedError("Caffe not imported or Unknown policy object: %s" % policy)
+    # Registered controller backend, overrides controller_to_execute if set.
+    msg.backend = getattr(policy, 'controller_backend', '')
     return msg
 
 
-def tf_policy_to_action_msg(deg_action, action, action_id):
+def dense_layers_to_blob(layers):
+    """
+    Pack dense layers into the flat binary blob read by NeuralNetworkNative.
+    Args:
+        layers: List of (weights, bias, activation) tuples, where weights is
+            an output x input array and activation is one of
+            NATIVE_NN_ACTIVATIONS.
+    """
+    blob = struct.pack('<III', NATIVE_NN_MAGIC, NATIVE_NN_VERSION, len(layers))
+    for weights, bias, activation in layers:
+        weights = np.asarray(weights, dtype='<f8')
+        blob += struct.pack('<III', weights.shape[0], weights.shape[1],
+                            NATIVE_NN_ACTIVATIONS.index(activation))
+        blob += weights.tobytes()  # Row-major.
+        blob += np.asarray(bias, dtype='<f8').tobytes()
+    return blob
+
+
+def tf_policy_to_action_msg(deg_action, action, action_id, obs_step=0,
+                            start_step=0):
         """
-        Convert an action to a TFActionCommand message.
+        Convert an action, or a chunk of actions (one row per step), to a
+        TFActionCommand message.
+        Args:
+            obs_step: Step of the observation the actions were computed from.
+            start_step: Step the first action is scheduled for.
         """
+        action = np.asarray(action).reshape(-1, deg_action)
         msg = TfActionCommand()
-        msg.action = action.tolist()
+        msg.action = action.reshape(action.size).tolist()
         msg.dU = deg_action
         msg.id = action_id
+        msg.horizon = action.shape[0]
+        msg.obs_step = obs_step
+        msg.start_step = start_step
         return msg
 
 
@@ -0,0 +1,155 @@
+""" Shared-memory observation/action transport to the robot plugin. """
+import ctypes
+import errno
+import mmap
+import os
+import platform
+import struct
+import time
+
+import numpy as np
+
+
+# Must match ShmTransportHeader in gps_agent_pkg/include/gps_agent_pkg/shmtransport.h.
+SHM_TRANSPORT_MAGIC = 0x4d535047
+SHM_TRANSPORT_VERSION = 1
+_HEADER_FORMAT = '<IIIIIiIIIiiiiiII'
+_HEADER_SIZE = struct.calcsize(_HEADER_FORMAT)
+_OBS_SEQ, _OBS_STEP, _OBS_SIZE = 16, 20, 24
+_ACTION_SEQ = 32
+_ACTION_FIELDS = 36  # id, obs_step, start_step, dU, horizon.
+
+_FUTEX_WAIT = 0
+_SYS_FUTEX = {'x86_64': 202, 'i686': 240}
+
+# The seqlocks below are only correct where the hardware keeps stores in
+# order with stores and loads in order with loads, since numpy offers no
+# fences. Weakly ordered architectures (aarch64, ARM, POWER) are not supported.
+SUPPORTED_ARCHITECTURES = ('x86_64', 'AMD64', 'i386', 'i686')
+
+
+def is_supported():
+    """ Whether the transport can be used safely on this machine. """
+    return platform.machine() in SUPPORTED_ARCHITECTURES
+
+
+class _Timespec(ctypes.Structure):
+    _fields_ = [('tv_sec', ctypes.c_long), ('tv_nsec', ctypes.c_long)]
+
+
+class ShmTransport(object):
+    """
+    Client side of the plugin's shared-memory transport. Observations are
+    read from, and actions written to, numpy views of the segment, so no
+    serialization happens on either side. Waiting for an observation uses a
+    futex on the observation sequence counter where the syscall number is
+    known, and falls back to polling otherwise.
+
+    Sequence counters are seqlocks: odd while the writer updates the
+    payload. Plain numpy loads and stores carry no fences, so this relies
+    on x86 ordering (stores are not reordered with stores, nor loads with
+    loads), and the transport refuses to attach on other architectures.
+    """
+    def __init__(self, name, timeout=5.0):
+        """
+        Attach to the segment created by the plugin (shm_transport param).
+        Args:
+            name: Segment name, without the leading slash.
+            timeout: Seconds to wait for the plugin to create the segment.
+        """
+        if not is_supported():
+            raise NotImplementedError('Shared memory transport is only supported on x86, not %s'
+                                      % platform.machine())
+        path = os.path.join('/dev/shm', name)
+        start = time.time()
+        while True:
+            if os.path.exists(path) and os.path.getsize(path) >= _HEADER_SIZE:
+                with open(path, 'r+b') as f:
+                    self._mm = mmap.mmap(f.fileno(), 0)
+                if struct.unpack_from('<I', self._mm, 0)[0] == SHM_TRANSPORT_MAGIC:
+                    break
+                self._mm.close()
+            if time.time() - start > timeout:
+                raise IOError('Shared memory transport %s not found' % path)
+            time.sleep(0.01)
+
+        (_, version, obs_capacity, action_capacity) = struct.unpack_from('<IIII', self._mm, 0)
+        if version != SHM_TRANSPORT_VERSION:
+            raise IOError('Unsupported shared memory transport version %d' % version)
+        self._header = np.frombuffer(self._mm, dtype='<u4', count=_HEADER_SIZE // 4)
+        self._obs = np.frombuffer(self._mm, dtype='<f8', count=obs_capacity,
+                                  offset=_HEADER_SIZE)
+        self._actions = np.frombuffer(self._mm, dtype='<f8', count=action_capacity,
+                                      offset=_HEADER_SIZE + 8 * obs_capacity)
+        self._last_obs_seq = int(self._header[_OBS_SEQ // 4])
+        self._action_seq = int(self._header[_ACTION_SEQ // 4])
+
+        self._futex = None
+        syscall_number = _SYS_FUTEX.get(platform.machine())
+        if syscall_number is not None:
+            libc = ctypes.CDLL(None, use_errno=True)
+            self._syscall = libc.syscall
+            self._syscall_number = syscall_number
+            self._futex = ctypes.c_uint32.from_buffer(self._mm, _OBS_SEQ)
+
+    def close(self):
+        """ Release the views and unmap the segment. """
+        self._futex = None
+        self._header = self._obs = self._actions = None
+        self._mm.close()
+
+    def _wait(self, seq, timeout):
+        """ Sleep until the observation counter differs from seq. """
+        if self._futex is None:
+            time.sleep(min(timeout, 1e-4))
+            return
+        ts = _Timespec(int(timeout), int((timeout % 1.0) * 1e9))
+        res = self._syscall(self._syscall_number, ctypes.byref(self._futex),
+                            _FUTEX_WAIT, ctypes.c_uint32(seq), ctypes.byref(ts),
+                            None, 0)
+        if res != 0 and ctypes.get_errno() not in (errno.EAGAIN, errno.ETIMEDOUT,
+                                                   errno.EINTR):
+            self._futex = None  # Futexes unavailable, poll from now on.
+
+    def read_obs(self, timeout=0.01):
+        """
+        Wait for a new observation.
+        Returns:
+            (step, obs) with obs a copy of the observation, or None on timeout.
+        """
+        deadline = time.time() + timeout
+        while True:
+            seq = int(self._header[_OBS_SEQ // 4])
+            if seq != self._last_obs_seq and not seq & 1:
+                step = int(self._header[_OBS_STEP // 4].view('<i4'))
+                size = int(self._header[_OBS_SIZE // 4])
+                obs = self._obs[:size].copy()
+                if int(self._header[_OBS_SEQ // 4]) == seq:
+                    self._last_obs_seq = seq
+                    return step, obs
+                continue
+            remaining = deadline - time.time()
+            if remaining <= 0:
+                return None
+            self._wait(seq, remaining)
+
+    def write_actions(self, action_id, actions, obs_step, start_step):
+        """
+        Write a chunk of actions (one row per step) for the plugin.
+        Args:
+            obs_step: Step of the observation the actions were computed from.
+            start_step: Step the first action is scheduled for.
+        """
+        actions = np.atleast_2d(actions)
+        horizon, dU = actions.shape
+        if actions.size > self._actions.size:
+            raise ValueError('Action chunk of size %d does not fit the transport (%d)'
+                             % (actions.size, self._actions.size))
+        self._action_seq += 1
+        self._header[_ACTION_SEQ // 4] = self._action_seq
+        fields = np.array([action_id, obs_step, start_step, dU, horizon], dtype='<i4')
+        self._header[_ACTION_FIELDS // 4:_ACTION_FIELDS // 4 + 5] = fields.view('<u4')
+        # The plugin reads the chunk column-major, one column per step.
+        self._actions[:actions.size] = actions.reshape(actions.size)
+        self._action_seq += 1
+        self._header[_ACTION_SEQ // 4] = self._action_seq
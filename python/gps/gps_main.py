@@ -70,9 +70,7 @@ class GPSMain(object):
 
             for itr in range(itr_start, self._hyperparams['iterations']):
                 for cond in self._train_idx:
-                    for i in range(self._hyperparams['num_samples']):
-                        self._take_sample(itr, cond, i)
-
+                    self._take_samples(itr, cond)
 
                 traj_sample_lists = [
                     self.agent.get_samples(cond, -self._hyperparams['num_samples'])
@@ -249,6 +247,31 @@ class GPSMain(object):
                     'Press \'go\' to begin.') % itr_load)
             return itr_load + 1
 
+    def _take_samples(self, itr, cond):
+        """
+        Collect all samples of a condition from the agent. Without a GUI to
+        serve requests between samples, they are taken in one batch so that
+        the agent can collect them in parallel.
+        Args:
+            itr: Iteration number.
+            cond: Condition number.
+        Returns: None
+        """
+        if self.gui or self.closeloop or self.robust:
+            for i in range(self._hyperparams['num_samples']):
+                self._take_sample(itr, cond, i)
+            return
+
+        if self.algorithm._hyperparams['sample_on_policy'] \
+                and self.algorithm.iteration_count > 0:
+            pol = self.algorithm.policy_opt.policy
+        else:
+            pol = self.algorithm.cur[cond].traj_distr
+        self.agent.sample_batch(
+            pol, cond, self._hyperparams['num_samples'],
+            verbose_trials=self._hyperparams['verbose_trials']
+        )
+
     def _take_sample(self, itr, cond, i):
         """
         Collect a sample from the agent.
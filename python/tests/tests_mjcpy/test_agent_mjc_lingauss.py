@@ -0,0 +1,97 @@
+""" This file defines tests for rolling out linear-Gaussian policies in mjcpy. """
+import os
+import os.path
+import sys
+import numpy as np
+
+# Add gps/python to path so that imports work.
+gps_path = os.path.abspath(os.path.join(os.path.dirname(__file__), '../..', ''))
+sys.path.append(gps_path)
+
+import mjcpy
+
+from gps.agent.mjc.agent_mjc import AgentMuJoCo
+from gps.algorithm.policy.lin_gauss_policy import LinearGaussianPolicyRobust
+from gps.proto.gps_pb2 import JOINT_ANGLES, JOINT_VELOCITIES, \
+        END_EFFECTOR_POINTS, END_EFFECTOR_POINT_VELOCITIES, \
+        END_EFFECTOR_POINT_JACOBIANS, ACTION, ACTION_V, NOISE
+
+MODEL_FILE = os.path.join(gps_path, '..', 'mjc_models', 'pr2_arm3d.xml')
+
+T = 20
+X0 = np.concatenate([np.array([0.1, 0.1, -1.54, -1.7, 1.54, -0.2, 0]), np.zeros(7)])
+PLAIN_STATE = [JOINT_ANGLES, JOINT_VELOCITIES]
+EE_STATE = [JOINT_ANGLES, JOINT_VELOCITIES, END_EFFECTOR_POINTS,
+            END_EFFECTOR_POINT_VELOCITIES]
+COMPARED = [JOINT_ANGLES, JOINT_VELOCITIES, END_EFFECTOR_POINTS,
+            END_EFFECTOR_POINT_VELOCITIES, END_EFFECTOR_POINT_JACOBIANS,
+            ACTION, ACTION_V, NOISE]
+
+
+def make_agent(state_include):
+    model = mjcpy.MJCWorld(MODEL_FILE).get_model()
+    nsite3 = 3 * model['nsite']
+    sensor_dims = {
+        JOINT_ANGLES: model['nq'],
+        JOINT_VELOCITIES: model['nv'],
+        END_EFFECTOR_POINTS: nsite3,
+        END_EFFECTOR_POINT_VELOCITIES: nsite3,
+        ACTION: model['nu'],
+    }
+    return AgentMuJoCo({
+        'filename': MODEL_FILE,
+        'x0': X0,
+        'dt': 0.05,
+        'substeps': 5,
+        'conditions': 1,
+        'T': T,
+        'sensor_dims': sensor_dims,
+        'state_include': state_include,
+        'obs_include': state_include,
+        'camera_pos': np.array([0., 0., 2., 0., 0.2, 0.5]),
+    })
+
+
+def make_policy(agent):
+    """ Random robust linear-Gaussian policy; sample only steps these in Python. """
+    def gains(dU):
+        G = 0.05 * np.random.randn(T, dU, agent.dX)
+        g = 0.5 * np.random.randn(T, dU)
+        chol = np.tile(0.2 * np.eye(dU), (T, 1, 1))
+        covar = np.einsum('tji,tjk->tik', chol, chol)
+        return [G, g, covar, chol, np.linalg.inv(covar)]
+    return LinearGaussianPolicyRobust(*(gains(agent.dU) + gains(agent.dV)))
+
+
+def check_rollout_lingauss(state_include):
+    # The C++ rollout gives the same sample as stepping the policy in Python,
+    # for the same noise.
+    agent = make_agent(state_include)
+    policy = make_policy(agent)
+    assert agent._can_rollout_lingauss(policy, 0)
+    np.random.seed(0)
+    expected = agent.sample(policy, 0, verbose=True, save=False)
+    np.random.seed(0)
+    actual = agent.sample(policy, 0, verbose=False, save=False)
+    for data_type in COMPARED:
+        assert np.allclose(actual.get(data_type), expected.get(data_type), atol=1e-8), data_type
+    assert np.allclose(actual.get_X(), expected.get_X(), atol=1e-8)
+
+
+def test_rollout_lingauss_plain_state():
+    check_rollout_lingauss(PLAIN_STATE)
+
+
+def test_rollout_lingauss_ee_state():
+    check_rollout_lingauss(EE_STATE)
+
+
+def main():
+    print('running linear-Gaussian rollout tests')
+    test_rollout_lingauss_plain_state()
+    test_rollout_lingauss_ee_state()
+    print('linear-Gaussian rollout tests passed')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,108 @@
+""" This file defines tests for the batched rollouts of mjcpy. """
+import os
+import os.path
+import sys
+import numpy as np
+
+# Add gps/python to path so that imports work.
+gps_path = os.path.abspath(os.path.join(os.path.dirname(__file__), '../..', ''))
+sys.path.append(gps_path)
+
+import mjcpy
+
+MODEL_FILE = os.path.join(gps_path, '..', 'mjc_models', 'pr2_arm3d.xml')
+
+N = 6
+T = 30
+SUBSTEPS = 2
+DT = 0.05
+
+
+def make_world():
+    world = mjcpy.MJCWorld(MODEL_FILE)
+    model = world.get_model()
+    x0 = np.zeros(model['nq'] + model['nv'])
+    return world, model, x0
+
+
+def make_gains(model, dX, shape=()):
+    """ Random linear-Gaussian gains, with leading dimensions shape. """
+    nu = model['nu']
+    K = 0.05 * np.random.randn(*(shape + (T, nu, dX)))
+    k = 0.5 * np.random.randn(*(shape + (T, nu)))
+    chol = 0.2 * np.random.rand(*(shape + (T, nu, nu)))
+    return K, k, chol
+
+
+def test_rollout_batch():
+    # Each rollout of the batch is the rollout of its initial state and
+    # controls, for any number of threads.
+    world, model, x0 = make_world()
+    X0 = x0 + 0.1 * np.random.randn(N, x0.size)
+    U = 0.5 * np.random.randn(N, T, model['nu'])
+    single = world.rollout_batch(X0, U, SUBSTEPS, nthreads=1)
+    multi = world.rollout_batch(X0, U, SUBSTEPS, nthreads=4)
+    for i in range(2):
+        assert np.array_equal(single[i], multi[i])
+    for n in range(N):
+        X, site_xpos = make_world()[0].rollout(X0[n], U[n], SUBSTEPS)
+        assert np.allclose(multi[0][n], X)
+        assert np.allclose(multi[1][n], site_xpos)
+
+
+def check_rollout_lingauss_batch(dX_extra):
+    world, model, x0 = make_world()
+    dX = x0.size + dX_extra
+    X0 = x0 + 0.1 * np.random.randn(N, x0.size)
+    noise = np.random.randn(N, T, model['nu'])
+
+    # Gains given per rollout: each rollout matches rollout_lingauss with its
+    # own gains, for any number of threads.
+    K, k, chol = make_gains(model, dX, (N,))
+    single = world.rollout_lingauss_batch(X0, K, k, chol, noise, SUBSTEPS, DT, nthreads=1)
+    multi = world.rollout_lingauss_batch(X0, K, k, chol, noise, SUBSTEPS, DT, nthreads=4)
+    for i in range(4):
+        assert np.array_equal(single[i], multi[i])
+    for n in range(N):
+        expected = make_world()[0].rollout_lingauss(X0[n], K[n], k[n], chol[n], noise[n],
+                                                    SUBSTEPS, DT)
+        for i in range(4):
+            assert np.allclose(multi[i][n], expected[i]), (n, i)
+
+    # Shared gains are broadcast to every rollout, alone or mixed with
+    # per-rollout ones.
+    K, k, chol = make_gains(model, dX)
+    shared = world.rollout_lingauss_batch(X0, K, k, chol, noise, SUBSTEPS, DT, nthreads=4)
+    tiled = world.rollout_lingauss_batch(X0, np.tile(K, (N, 1, 1, 1)), np.tile(k, (N, 1, 1)),
+                                         np.tile(chol, (N, 1, 1, 1)), noise, SUBSTEPS, DT,
+                                         nthreads=4)
+    mixed = world.rollout_lingauss_batch(X0, K, np.tile(k, (N, 1, 1)), chol, noise,
+                                         SUBSTEPS, DT, nthreads=4)
+    for i in range(4):
+        assert np.array_equal(shared[i], tiled[i])
+        assert np.array_equal(shared[i], mixed[i])
+    for n in range(N):
+        expected = make_world()[0].rollout_lingauss(X0[n], K, k, chol, noise[n], SUBSTEPS, DT)
+        for i in range(4):
+            assert np.allclose(shared[i][n], expected[i]), (n, i)
+
+
+def test_rollout_lingauss_batch_plain_state():
+    check_rollout_lingauss_batch(0)
+
+
+def test_rollout_lingauss_batch_ee_state():
+    model = make_world()[1]
+    check_rollout_lingauss_batch(6 * model['nsite'])
+
+
+def main():
+    print('running mjcpy batch tests')
+    test_rollout_batch()
+    test_rollout_lingauss_batch_plain_state()
+    test_rollout_lingauss_batch_ee_state()
+    print('mjcpy batch tests passed')
+
+
+if __name__ == '__main__':
+    main()
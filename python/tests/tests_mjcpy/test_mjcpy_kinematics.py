@@ -0,0 +1,84 @@
+""" This file defines tests for the batched kinematics queries of mjcpy. """
+import os
+import os.path
+import sys
+import numpy as np
+
+# Add gps/python to path so that imports work.
+gps_path = os.path.abspath(os.path.join(os.path.dirname(__file__), '../..', ''))
+sys.path.append(gps_path)
+
+import mjcpy
+
+MODEL_FILE = os.path.join(gps_path, '..', 'mjc_models', 'pr2_arm3d.xml')
+
+
+def make_world():
+    world = mjcpy.MJCWorld(MODEL_FILE)
+    model = world.get_model()
+    X = 0.5 * np.random.randn(50, model['nq'] + model['nv'])
+    return world, model, X
+
+
+def kinematics_of(world, x, sites):
+    """ Kinematic quantities of one state, computed through the world data. """
+    world.set_data({'qpos': x[:world.get_model()['nq']].copy()})
+    world.kinematics()
+    data = world.get_data()
+    return data['site_xpos'], data['xpos'], world.get_jac_sites(sites)
+
+
+def test_get_COM_multi_rows():
+    # Every row of the output is the COM of the corresponding state.
+    world, model, X = make_world()
+    com = world.get_COM_multi(X)
+    for n in range(X.shape[0]):
+        assert np.allclose(com[n], world.get_COM_multi(X[n:n+1])[0])
+    assert not np.allclose(com[0], com[1])
+
+
+def test_kinematics_batch():
+    world, model, X = make_world()
+    sites = list(range(model['nsite']))
+    out = world.kinematics_batch(X, xpos=True, jac_sites=sites, nthreads=4)
+    assert np.allclose(out['com'], world.get_COM_multi(X))
+    for n in range(X.shape[0]):
+        site_xpos, xpos, jac = kinematics_of(world, X[n], sites)
+        assert np.allclose(out['site_xpos'][n], site_xpos)
+        assert np.allclose(out['xpos'][n], xpos)
+        assert np.allclose(out['jac_site'][n], jac)
+
+
+def test_kinematics_batch_threads():
+    # The result does not depend on the number of threads.
+    world, model, X = make_world()
+    sites = list(range(model['nsite']))
+    single = world.kinematics_batch(X, xpos=True, jac_sites=sites, nthreads=1)
+    multi = world.kinematics_batch(X, xpos=True, jac_sites=sites, nthreads=4)
+    for key in single:
+        assert np.array_equal(single[key], multi[key])
+
+
+def test_get_jac_sites_traj():
+    # Matches the Jacobians of each state, and leaves the world data alone.
+    world, model, X = make_world()
+    sites = list(range(model['nsite']))
+    qpos = world.get_data()['qpos'].copy()
+    jac = world.get_jac_sites_traj(X, sites)
+    assert np.array_equal(world.get_data()['qpos'], qpos)
+    assert np.allclose(jac, world.kinematics_batch(X, com=False, site_xpos=False, jac_sites=sites)['jac_site'])
+    for t in range(X.shape[0]):
+        assert np.allclose(jac[t], kinematics_of(world, X[t], sites)[2])
+
+
+def main():
+    print('running mjcpy kinematics tests')
+    test_get_COM_multi_rows()
+    test_kinematics_batch()
+    test_kinematics_batch_threads()
+    test_get_jac_sites_traj()
+    print('mjcpy kinematics tests passed')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,81 @@
+""" This file defines tests for the finite-difference linearization of mjcpy. """
+import os
+import os.path
+import sys
+import numpy as np
+
+# Add gps/python to path so that imports work.
+gps_path = os.path.abspath(os.path.join(os.path.dirname(__file__), '../..', ''))
+sys.path.append(gps_path)
+
+import mjcpy
+
+MODEL_FILE = os.path.join(gps_path, '..', 'mjc_models', 'pr2_arm3d.xml')
+
+SUBSTEPS = 2
+EPS = 1e-6
+
+
+def make_world(T=10):
+    world = mjcpy.MJCWorld(MODEL_FILE)
+    world.set_num_steps(SUBSTEPS)
+    model = world.get_model()
+    x0 = np.zeros(model['nq'] + model['nv'])
+    U = 0.5 * np.random.randn(T, model['nu'])
+    X, _ = world.rollout(x0, U, SUBSTEPS)
+    return world, model, X, U
+
+
+def test_linearize_finite_differences():
+    # Every column of Fm is the centered difference of step, and the affine
+    # model reproduces the nominal next state.
+    world, model, X, U = make_world()
+    Fm, fv = world.linearize(X, U, EPS, SUBSTEPS, nthreads=1)
+    dS, nu = X.shape[1], U.shape[1]
+    assert Fm.shape == (X.shape[0], dS, dS + nu)
+    assert fv.shape == X.shape
+    for t in [0, X.shape[0] // 2, X.shape[0] - 1]:
+        z = np.concatenate([X[t], U[t]])
+        x_next = world.step(X[t], U[t])[0]
+        assert np.allclose(Fm[t].dot(z) + fv[t], x_next, atol=1e-6)
+        for j in range(dS + nu):
+            z_plus, z_minus = z.copy(), z.copy()
+            z_plus[j] += EPS
+            z_minus[j] -= EPS
+            column = (world.step(z_plus[:dS], z_plus[dS:])[0] -
+                      world.step(z_minus[:dS], z_minus[dS:])[0]) / (2 * EPS)
+            assert np.allclose(Fm[t, :, j], column, rtol=1e-4, atol=1e-4), (t, j)
+
+
+def test_linearize_threads():
+    # The result does not depend on the number of threads, or on what the
+    # worker data stepped before.
+    world, model, X, U = make_world()
+    single = world.linearize(X, U, EPS, SUBSTEPS, nthreads=1)
+    multi = world.linearize(X, U, EPS, SUBSTEPS, nthreads=4)
+    again = world.linearize(X, U, EPS, SUBSTEPS, nthreads=4)
+    for i in range(2):
+        assert np.array_equal(single[i], multi[i])
+        assert np.array_equal(multi[i], again[i])
+
+
+def test_linearize_leaves_world():
+    # The world's own data is not changed.
+    world, model, X, U = make_world()
+    before = world.get_data()
+    world.linearize(X, U, EPS, SUBSTEPS, nthreads=2)
+    after = world.get_data()
+    for key in before:
+        assert np.array_equal(before[key], after[key]), key
+
+
+def main():
+    print('running mjcpy linearization tests')
+    test_linearize_finite_differences()
+    test_linearize_threads()
+    test_linearize_leaves_world()
+    print('mjcpy linearization tests passed')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,57 @@
+""" This file defines tests for stepping mjcpy worlds into caller buffers. """
+import os
+import os.path
+import sys
+import numpy as np
+
+# Add gps/python to path so that imports work.
+gps_path = os.path.abspath(os.path.join(os.path.dirname(__file__), '../..', ''))
+sys.path.append(gps_path)
+
+import mjcpy
+
+MODEL_FILE = os.path.join(gps_path, '..', 'mjc_models', 'pr2_arm3d.xml')
+
+
+def make_world():
+    world = mjcpy.MJCWorld(MODEL_FILE)
+    model = world.get_model()
+    x0 = np.zeros(model['nq'] + model['nv'])
+    site = np.empty((model['nsite'], 3))
+    return world, model, x0, site
+
+
+def test_step_into_matches_step():
+    world, model, x0, site = make_world()
+    u = 0.1 * np.ones(model['nu'])
+    x = x0.copy()
+    for _ in range(10):
+        world.step_into(x, u, x, site, True)
+    expected = x0
+    for _ in range(10):
+        expected, _ = world.step(expected, u)
+    assert np.allclose(x, expected)
+
+
+def test_step_into_sees_edits():
+    # Editing the state between in-place steps is not ignored.
+    world, model, x0, site = make_world()
+    u = np.zeros(model['nu'])
+    x = x0.copy()
+    world.step_into(x, u, x, site, True)
+    x[0] += 0.5
+    edited = x.copy()
+    world.step_into(x, u, x, site, True)
+    expected, _ = world.step(edited, u)
+    assert np.allclose(x, expected)
+
+
+def main():
+    print('running mjcpy step_into tests')
+    test_step_into_matches_step()
+    test_step_into_sees_edits()
+    print('mjcpy step_into tests passed')
+
+
+if __name__ == '__main__':
+    main()
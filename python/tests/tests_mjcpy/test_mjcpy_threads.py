@@ -0,0 +1,146 @@
+""" This file defines tests for running mjcpy worlds from several threads. """
+import itertools
+import os
+import os.path
+import sys
+import threading
+import time
+import numpy as np
+
+# Add gps/python to path so that imports work.
+gps_path = os.path.abspath(os.path.join(os.path.dirname(__file__), '../..', ''))
+sys.path.append(gps_path)
+
+import mjcpy
+
+MODEL_FILE = os.path.join(gps_path, '..', 'mjc_models', 'pr2_arm3d.xml')
+
+
+class Counter(object):
+    """ Pure Python busy loop, which only makes progress while it holds the GIL. """
+    def __init__(self):
+        self.count = 0
+        self.running = True
+        self.thread = threading.Thread(target=self._run)
+        self.thread.daemon = True
+        self.thread.start()
+
+    def _run(self):
+        while self.running:
+            self.count += 1
+
+    def stop(self):
+        self.running = False
+        self.thread.join()
+
+
+def make_world():
+    world = mjcpy.MJCWorld(MODEL_FILE)
+    model = world.get_model()
+    x0 = np.zeros(model['nq'] + model['nv'])
+    return world, model, x0
+
+
+def progress_rate(fn):
+    """ How fast a Python thread counts while fn runs in this thread. """
+    counter = Counter()
+    time.sleep(0.05)
+    before = counter.count
+    start = time.time()
+    fn()
+    elapsed = time.time() - start
+    after = counter.count
+    counter.stop()
+    return (after - before) / elapsed
+
+
+def assert_releases_gil(fn):
+    """ fn lets the counter run much faster than a call that holds the GIL. """
+    # The counter can only run in the switch interval before the call takes
+    # the GIL, so keep that short against the duration of the calls.
+    # (Python 2 switches threads by bytecode count instead, with the same effect.)
+    has_interval = hasattr(sys, 'setswitchinterval')
+    if has_interval:
+        interval = sys.getswitchinterval()
+        sys.setswitchinterval(1e-4)
+    try:
+        # sum over repeat runs in C without ever giving up the GIL.
+        held = progress_rate(lambda: sum(itertools.repeat(1, 3 * 10**7)))
+        released = progress_rate(fn)
+    finally:
+        if has_interval:
+            sys.setswitchinterval(interval)
+    assert released > 10 * held, (released, held)
+
+
+def test_rollout_releases_gil():
+    world, model, x0 = make_world()
+    U = 0.1 * np.random.randn(50000, model['nu'])
+    assert_releases_gil(lambda: world.rollout(x0, U, 1))
+
+
+def test_get_COM_multi_releases_gil():
+    world, model, x0 = make_world()
+    X = np.tile(x0, (500000, 1))
+    assert_releases_gil(lambda: world.get_COM_multi(X))
+
+
+def test_concurrent_step():
+    # Stepping several worlds from several threads gives the same states as
+    # stepping them one after another.
+    num_threads = 4
+    T = 2000
+    worlds = [make_world() for _ in range(num_threads)]
+    U = [0.1 * np.random.randn(T, worlds[0][1]['nu']) for _ in range(num_threads)]
+
+    def run(i, out):
+        world, _, x = worlds[i]
+        for t in range(T):
+            x, _ = world.step(x, U[i][t])
+        out[i] = x
+
+    expected = [None] * num_threads
+    for i in range(num_threads):
+        run(i, expected)
+    actual = [None] * num_threads
+    threads = [threading.Thread(target=run, args=(i, actual)) for i in range(num_threads)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    for i in range(num_threads):
+        assert np.allclose(actual[i], expected[i])
+
+
+def test_concurrent_step_same_world():
+    # Calls on one world from several threads are serialized, not interleaved.
+    world, model, x0 = make_world()
+    u = np.zeros(model['nu'])
+    x_expected, _ = world.step(x0, u)
+    failures = []
+
+    def run():
+        for _ in range(1000):
+            x, _ = world.step(x0, u)
+            if not np.allclose(x, x_expected):
+                failures.append(x)
+
+    threads = [threading.Thread(target=run) for _ in range(4)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    assert not failures
+
+
+def main():
+    print('running mjcpy threading tests')
+    test_rollout_releases_gil()
+    test_get_COM_multi_releases_gil()
+    test_concurrent_step()
+    test_concurrent_step_same_world()
+    print('mjcpy threading tests passed')
+
+
+if __name__ == '__main__':
+    main()